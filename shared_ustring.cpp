@@ -0,0 +1,92 @@
+#include "shared_ustring.h"
+
+shared_ustring::shared_ustring(ustring &&str) : _rep(new rep{.value = std::move(str)}) {}
+
+shared_ustring::shared_ustring(ustring::view str) : _rep(new rep{.value = ustring(str)}) {}
+
+shared_ustring::shared_ustring(const shared_ustring &other) noexcept : _rep(other._rep)
+{
+  if (_rep) {
+    _rep->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+shared_ustring::~shared_ustring()
+{
+  release();
+}
+
+shared_ustring &shared_ustring::operator=(const shared_ustring &other) noexcept
+{
+  if (_rep != other._rep) {
+    if (other._rep) {
+      other._rep->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    release();
+    _rep = other._rep;
+  }
+  return *this;
+}
+
+shared_ustring &shared_ustring::operator=(shared_ustring &&other) noexcept
+{
+  if (this != &other) {
+    release();
+    _rep = std::exchange(other._rep, nullptr);
+  }
+  return *this;
+}
+
+shared_ustring::size_type shared_ustring::length() const noexcept
+{
+  // ustring caches the count itself, and fills the cache safely from const calls
+  return _rep ? _rep->value.length() : 0;
+}
+
+ustring shared_ustring::to_ustring() const &
+{
+  return _rep ? ustring(_rep->value.to_view()) : ustring();
+}
+
+ustring shared_ustring::to_ustring() &&
+{
+  if (!_rep) {
+    return {};
+  }
+  ustring result = _rep->refs.load(std::memory_order_acquire) == 1 ? std::move(_rep->value)
+                                                                   : ustring(_rep->value.to_view());
+  release();
+  return result;
+}
+
+void shared_ustring::detach()
+{
+  if (!_rep) {
+    _rep = new rep;
+  }
+  // acquire pairs with the release in other copies' release(), so their reads of the buffer
+  // are done before we write to it
+  else if (_rep->refs.load(std::memory_order_acquire) != 1) {
+    rep *copy = new rep{.value = ustring(_rep->value.to_view())};
+    release();
+    _rep = copy;
+  }
+}
+
+void shared_ustring::release() noexcept
+{
+  if (_rep && _rep->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete _rep;
+  }
+  _rep = nullptr;
+}
+
+shared_ustring ustring::shared() const &
+{
+  return shared_ustring(to_view());
+}
+
+shared_ustring ustring::shared() &&
+{
+  return shared_ustring(std::move(*this));
+}
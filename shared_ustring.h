@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <compare>
+#include <cstdint>
+#include <utility>
+
+#include "ustring.h"
+
+// An immutable, reference counted ustring. Copies share one buffer and only bump an atomic
+// counter, and views into it stay valid as long as any copy is alive. modify() detaches the
+// string first when the buffer is shared, so copy-on-write is the only way to change it.
+//
+// Threading: as with std::shared_ptr, const members of different shared_ustring objects may be
+// called concurrently even when they share a buffer, and copies may be made and destroyed on any
+// thread. A single object must not be assigned or modified while another thread uses it.
+class shared_ustring {
+ public:
+  using value_type = ustring::value_type;
+  using size_type = ustring::size_type;
+  using const_pointer = const value_type *;
+  using const_iterator = const value_type *;
+
+  static constexpr size_type npos = ustring::npos;
+
+  shared_ustring() noexcept = default;
+  explicit shared_ustring(ustring &&str);
+  explicit shared_ustring(ustring::view str);
+  shared_ustring(const shared_ustring &other) noexcept;
+  shared_ustring(shared_ustring &&other) noexcept : _rep(std::exchange(other._rep, nullptr)) {}
+  ~shared_ustring();
+
+  shared_ustring &operator=(const shared_ustring &other) noexcept;
+  shared_ustring &operator=(shared_ustring &&other) noexcept;
+
+  [[nodiscard]] const_pointer data() const noexcept
+  {
+    return _rep ? _rep->value.data() : nullptr;
+  }
+  [[nodiscard]] size_type size() const noexcept
+  {
+    return _rep ? _rep->value.size() : 0;
+  }
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return size() == 0;
+  }
+  // Code points, counted once per buffer
+  [[nodiscard]] size_type length() const noexcept;
+
+  [[nodiscard]] const_iterator begin() const noexcept
+  {
+    return data();
+  }
+  [[nodiscard]] const_iterator end() const noexcept
+  {
+    return data() + size();
+  }
+
+  [[nodiscard]] ustring::view to_view() const noexcept
+  {
+    return {data(), size()};
+  }
+  operator ustring::view() const noexcept
+  {
+    return to_view();
+  }
+  // A private copy of the contents. The rvalue overload gives up this reference, and moves the
+  // contents out instead of copying them when it was the only one.
+  [[nodiscard]] ustring to_ustring() const &;
+  [[nodiscard]] ustring to_ustring() &&;
+
+  // Number of shared_ustring objects sharing the buffer, 0 for an empty default constructed one
+  [[nodiscard]] uint32_t use_count() const noexcept
+  {
+    return _rep ? _rep->refs.load(std::memory_order_relaxed) : 0;
+  }
+
+  // Calls f(ustring &) on a buffer only this object refers to, copying it first if it is shared.
+  // Views into the old buffer stay valid while other copies keep it alive.
+  template<typename F> shared_ustring &modify(F &&f);
+
+  friend bool operator==(const shared_ustring &lhs, const shared_ustring &rhs) noexcept
+  {
+    return lhs._rep == rhs._rep || lhs.to_view() == rhs.to_view();
+  }
+  friend std::strong_ordering operator<=>(const shared_ustring &lhs,
+                                          const shared_ustring &rhs) noexcept
+  {
+    return lhs.to_view() <=> rhs.to_view();
+  }
+
+ private:
+  struct rep {
+    std::atomic<uint32_t> refs{1};
+    ustring value;
+  };
+
+  // Makes _rep a buffer of our own, creating an empty one if there is none
+  void detach();
+  void release() noexcept;
+
+  rep *_rep = nullptr;
+};
+
+template<typename F> shared_ustring &shared_ustring::modify(F &&f)
+{
+  detach();
+  std::forward<F>(f)(_rep->value);
+  return *this;
+}
@@ -0,0 +1,100 @@
+#include "shared_ustring.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+TEST(SharedUstringTest, CopiesShareTheBuffer)
+{
+  const ustring text(u8"a shared string, longer than the inline buffer 你好");
+  shared_ustring a = text.shared();
+  EXPECT_EQ(a.use_count(), 1);
+  EXPECT_EQ(a.size(), text.size());
+  EXPECT_EQ(a.length(), text.length());
+  EXPECT_EQ(a.to_ustring(), text);
+
+  shared_ustring b = a;
+  shared_ustring c;
+  c = b;
+  EXPECT_EQ(a.use_count(), 3);
+  EXPECT_EQ(b.data(), a.data());
+  EXPECT_EQ(c.data(), a.data());
+  EXPECT_EQ(a, c);
+
+  shared_ustring d = std::move(c);
+  EXPECT_EQ(a.use_count(), 3);
+  EXPECT_EQ(c.use_count(), 0);
+  EXPECT_TRUE(c.empty());
+  EXPECT_EQ(d.data(), a.data());
+
+  c = shared_ustring();
+  b = shared_ustring();
+  d = shared_ustring();
+  EXPECT_EQ(a.use_count(), 1);
+}
+
+TEST(SharedUstringTest, ModifyDetaches)
+{
+  shared_ustring a = ustring(u8"copy on write, long enough to live on the heap").shared();
+  shared_ustring b = a;
+  const ustring::view before = b;
+
+  a.modify([](ustring &str) { str.append(u8"!"); });
+  EXPECT_NE(a.data(), b.data());
+  EXPECT_EQ(a.use_count(), 1);
+  EXPECT_EQ(b.use_count(), 1);
+  EXPECT_EQ(a.size(), b.size() + 1);
+  EXPECT_EQ(a.length(), b.length() + 1);
+  // views into the buffer a gave up are still valid
+  EXPECT_EQ(before.data(), b.data());
+  EXPECT_EQ(ustring(before), b.to_ustring());
+
+  // a unique buffer is changed in place
+  const auto *data = a.data();
+  a.modify([](ustring &str) { str.pop_back(); });
+  EXPECT_EQ(a.data(), data);
+  EXPECT_EQ(a, b);
+
+  shared_ustring empty;
+  empty.modify([](ustring &str) { str = u8"abc"; });
+  EXPECT_EQ(empty.to_ustring(), ustring(u8"abc"));
+}
+
+TEST(SharedUstringTest, ToUstringMovesWhenUnique)
+{
+  shared_ustring a = ustring(u8"moved out when nobody else holds the buffer").shared();
+  const auto *data = a.data();
+  shared_ustring b = a;
+
+  ustring copy = std::move(a).to_ustring();
+  EXPECT_NE(copy.data(), data);
+  EXPECT_EQ(a.use_count(), 0);
+  EXPECT_EQ(b.use_count(), 1);
+
+  ustring moved = std::move(b).to_ustring();
+  EXPECT_EQ(moved.data(), data);
+  EXPECT_EQ(moved, copy);
+  EXPECT_EQ(b.use_count(), 0);
+}
+
+TEST(SharedUstringTest, ConcurrentCopies)
+{
+  const shared_ustring source = ustring(u8"read and copied from several threads at once").shared();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&source]() {
+      for (int i = 0; i < 10000; ++i) {
+        shared_ustring copy = source;
+        ASSERT_EQ(copy.length(), 44);
+        if (i % 100 == 0) {
+          copy.modify([](ustring &str) { str.push_back(u8'!'); });
+          ASSERT_EQ(copy.size(), 45);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(source.use_count(), 1);
+  EXPECT_EQ(source.size(), 44);
+}
@@ -26,6 +26,21 @@ namespace simd_traits {
     #define USTRING_ARM
 #endif
 
+// Instruction set macros, for guarding code that uses intrinsics directly.
+// MSVC only reports the /arch level, so the SSE3-4.2 family is implied by AVX.
+#if defined(__AVX2__)
+    #define USTRING_AVX2
+#endif
+#if defined(__SSE4_2__) || defined(__AVX__)
+    #define USTRING_SSE4_2
+#endif
+#if defined(__SSSE3__) || defined(__AVX__)
+    #define USTRING_SSSE3
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define USTRING_SSE2
+#endif
+
 // SIMD instruction set detection
 struct simd_support {
     // x86/x64 instruction sets
@@ -38,17 +53,7 @@ struct simd_support {
         #endif
 #elif defined(USTRING_GCC) || defined(USTRING_CLANG)
         #if defined(__SSE__)
-            true#include "simd_traits.h"
-            
-            void process_data(float* data, size_t size) {
-                if (simd_traits::simd_support::has_avx2 && 
-                    simd_traits::is_aligned_for_simd(data) &&
-                    simd_traits::is_size_simd_compatible<float>(size)) {
-                    // Use AVX2 implementation
-                } else {
-                    // Use scalar fallback
-                }
-            }
+            true
         #else
             false
         #endif
@@ -84,7 +89,7 @@ struct simd_support {
         ;
 
     static constexpr bool has_ssse3 = 
-#if defined(__SSSE3__)
+#if defined(USTRING_SSSE3)
         true
 #else
         false
@@ -92,7 +97,7 @@ struct simd_support {
         ;
 
     static constexpr bool has_sse4_1 = 
-#if defined(__SSE4_1__)
+#if defined(__SSE4_1__) || defined(__AVX__)
         true
 #else
         false
@@ -100,7 +105,7 @@ struct simd_support {
         ;
 
     static constexpr bool has_sse4_2 = 
-#if defined(__SSE4_2__)
+#if defined(USTRING_SSE4_2)
         true
 #else
         false
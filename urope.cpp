@@ -0,0 +1,674 @@
+#include "urope.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "ustring_simd.h"
+
+#include <unicode/utf8.h>
+
+namespace {
+
+// Leaves are split above leaf_max bytes and merged with a neighbour below leaf_min. Inner nodes
+// likewise keep between children_min and children_max children, except the root.
+constexpr ustring::size_type leaf_max = 2048;
+constexpr ustring::size_type leaf_min = leaf_max / 4;
+constexpr size_t children_max = 16;
+constexpr size_t children_min = children_max / 4;
+
+struct metrics {
+  size_t bytes = 0;
+  size_t code_points = 0;
+  size_t newlines = 0;
+
+  metrics &operator+=(const metrics &other) noexcept
+  {
+    bytes += other.bytes;
+    code_points += other.code_points;
+    newlines += other.newlines;
+    return *this;
+  }
+  metrics &operator-=(const metrics &other) noexcept
+  {
+    bytes -= other.bytes;
+    code_points -= other.code_points;
+    newlines -= other.newlines;
+    return *this;
+  }
+};
+
+metrics measure(const char8_t *data, size_t size) noexcept
+{
+  return {size,
+          ustring_simd::count_code_points(data, size),
+          static_cast<size_t>(std::count(data, data + size, u8'\n'))};
+}
+
+bool is_continuation(char8_t byte) noexcept
+{
+  return (byte & 0xC0) == 0x80;
+}
+
+// The code point boundary at or before `pos`. Falls back to `pos` itself for a run of
+// continuation bytes that long, which only invalid input has.
+size_t boundary_before(const char8_t *data, size_t pos) noexcept
+{
+  size_t i = pos;
+  while (i > 0 && is_continuation(data[i])) {
+    --i;
+  }
+  return i > 0 ? i : pos;
+}
+
+// Offset of the code point with index `k` in a chunk
+size_t nth_code_point(const ustring &text, size_t k) noexcept
+{
+  size_t i = 0;
+  for (;; ++i) {
+    if (!is_continuation(text.data()[i])) {
+      if (k == 0) {
+        return i;
+      }
+      --k;
+    }
+  }
+}
+
+}  // namespace
+
+struct urope::node {
+  metrics sum;
+  bool leaf = true;
+  // Inner nodes
+  std::vector<std::unique_ptr<node>> children;
+  // Leaves, which are never empty and are linked in text order
+  ustring text;
+  node *prev = nullptr;
+  node *next = nullptr;
+
+  static std::unique_ptr<node> make_leaf(ustring::view str)
+  {
+    auto n = std::make_unique<node>();
+    n->text = ustring(str);
+    n->sum = measure(str.data(), str.size());
+    return n;
+  }
+
+  static std::unique_ptr<node> make_inner()
+  {
+    auto n = std::make_unique<node>();
+    n->leaf = false;
+    return n;
+  }
+
+  static node *leftmost(node *n) noexcept
+  {
+    while (!n->leaf) {
+      n = n->children.front().get();
+    }
+    return n;
+  }
+
+  static node *rightmost(node *n) noexcept
+  {
+    while (!n->leaf) {
+      n = n->children.back().get();
+    }
+    return n;
+  }
+
+  void refresh() noexcept
+  {
+    if (leaf) {
+      sum = measure(text.data(), text.size());
+    }
+    else {
+      sum = {};
+      for (const auto &child : children) {
+        sum += child->sum;
+      }
+    }
+  }
+
+  bool underfull() const noexcept
+  {
+    return leaf ? text.size() < leaf_min : children.size() < children_min;
+  }
+
+  // Puts `right` after this leaf in the leaf list
+  void link_after(node *right) noexcept
+  {
+    right->prev = this;
+    right->next = next;
+    if (next) {
+      next->prev = right;
+    }
+    next = right;
+  }
+
+  // Takes this subtree's leaves out of the leaf list
+  void unlink() noexcept
+  {
+    node *first = leftmost(this);
+    node *last = rightmost(this);
+    if (first->prev) {
+      first->prev->next = last->next;
+    }
+    if (last->next) {
+      last->next->prev = first->prev;
+    }
+  }
+
+  // Moves the upper half of an overfull node into a new right sibling
+  std::unique_ptr<node> split()
+  {
+    if (leaf) {
+      const size_t mid = boundary_before(text.data(), text.size() / 2);
+      auto right = make_leaf(ustring::view(text.data() + mid, text.size() - mid));
+      text.erase(mid);
+      refresh();
+      link_after(right.get());
+      return right;
+    }
+    auto right = make_inner();
+    const auto half = children.begin() + children.size() / 2;
+    right->children.assign(std::make_move_iterator(half), std::make_move_iterator(children.end()));
+    children.erase(half, children.end());
+    refresh();
+    right->refresh();
+    return right;
+  }
+
+  // Joins children i and i + 1, splitting the result again when it is too big
+  void merge_children(size_t i)
+  {
+    node &left = *children[i];
+    std::unique_ptr<node> right = std::move(children[i + 1]);
+    children.erase(children.begin() + i + 1);
+    if (left.leaf) {
+      left.text.append(right->text);
+      right->unlink();
+    }
+    else {
+      for (auto &child : right->children) {
+        left.children.push_back(std::move(child));
+      }
+      // the children meeting at the seam may be underfull themselves
+      left.rebalance();
+    }
+    left.refresh();
+    if (left.leaf ? left.text.size() > leaf_max : left.children.size() > children_max) {
+      children.insert(children.begin() + i + 1, left.split());
+    }
+  }
+
+  void rebalance()
+  {
+    for (size_t i = 0; i < children.size() && children.size() > 1;) {
+      if (!children[i]->underfull()) {
+        ++i;
+        continue;
+      }
+      i = i + 1 < children.size() ? i : i - 1;
+      merge_children(i);
+    }
+  }
+
+  // Inserts a piece of at most leaf_max bytes, returning the new right sibling if this node split
+  std::unique_ptr<node> insert(size_t pos, ustring::view str, const metrics &m)
+  {
+    sum += m;
+    if (leaf) {
+      text.insert(static_cast<ustring::size_type>(pos), str.data(), str.size());
+      return text.size() > leaf_max ? split() : nullptr;
+    }
+    size_t i = 0;
+    for (; i + 1 < children.size() && pos > children[i]->sum.bytes; ++i) {
+      pos -= children[i]->sum.bytes;
+    }
+    if (auto sibling = children[i]->insert(pos, str, m)) {
+      children.insert(children.begin() + i + 1, std::move(sibling));
+      if (children.size() > children_max) {
+        return split();
+      }
+    }
+    return nullptr;
+  }
+
+  // Erases a range that lies within this node but is not all of it
+  void erase(size_t pos, size_t count)
+  {
+    if (leaf) {
+      sum -= measure(text.data() + pos, count);
+      text.erase(static_cast<ustring::size_type>(pos), static_cast<ustring::size_type>(count));
+      return;
+    }
+    const size_t end = pos + count;
+    size_t offset = 0;
+    for (size_t i = 0; i < children.size() && offset < end;) {
+      const size_t bytes = children[i]->sum.bytes;
+      const size_t from = std::max(pos, offset);
+      const size_t to = std::min(end, offset + bytes);
+      offset += bytes;
+      if (from == offset - bytes && to == offset) {
+        children[i]->unlink();
+        children.erase(children.begin() + i);
+        continue;
+      }
+      if (from < to) {
+        children[i]->erase(from - (offset - bytes), to - from);
+      }
+      ++i;
+    }
+    rebalance();
+    refresh();
+  }
+
+  // Walks down to the leaf holding index `target` of `field`, or the last leaf when `target` is
+  // at the end. `before` receives the totals of everything left of that leaf.
+  static const node *find(const node *n, size_t target, size_t metrics::*field, metrics &before)
+  {
+    while (!n->leaf) {
+      size_t i = 0;
+      for (; i + 1 < n->children.size(); ++i) {
+        const metrics &child = n->children[i]->sum;
+        if (target < before.*field + child.*field) {
+          break;
+        }
+        before += child;
+      }
+      n = n->children[i].get();
+    }
+    return n;
+  }
+
+  std::unique_ptr<node> clone(node *&last_leaf) const
+  {
+    auto copy = std::make_unique<node>();
+    copy->sum = sum;
+    copy->leaf = leaf;
+    if (leaf) {
+      copy->text = text;
+      if (last_leaf) {
+        last_leaf->link_after(copy.get());
+      }
+      last_leaf = copy.get();
+    }
+    for (const auto &child : children) {
+      copy->children.push_back(child->clone(last_leaf));
+    }
+    return copy;
+  }
+
+  // A tree over `str`, built bottom up with full leaves
+  static std::unique_ptr<node> build(ustring::view str)
+  {
+    std::vector<std::unique_ptr<node>> level;
+    node *last = nullptr;
+    for (size_t pos = 0; pos < static_cast<size_t>(str.size());) {
+      size_t n = std::min<size_t>(leaf_max, str.size() - pos);
+      if (pos + n < static_cast<size_t>(str.size())) {
+        n = boundary_before(str.data() + pos, n);
+      }
+      level.push_back(make_leaf(ustring::view(str.data() + pos, static_cast<ustring::size_type>(n))));
+      if (last) {
+        last->link_after(level.back().get());
+      }
+      last = level.back().get();
+      pos += n;
+    }
+    while (level.size() > 1) {
+      std::vector<std::unique_ptr<node>> parents;
+      const size_t groups = (level.size() + children_max - 1) / children_max;
+      // Spread the children evenly, so the last parent is not left underfull
+      for (size_t g = 0, begin = 0; g < groups; ++g) {
+        const size_t end = level.size() * (g + 1) / groups;
+        auto parent = make_inner();
+        for (size_t i = begin; i < end; ++i) {
+          parent->children.push_back(std::move(level[i]));
+        }
+        parent->refresh();
+        parents.push_back(std::move(parent));
+        begin = end;
+      }
+      level = std::move(parents);
+    }
+    return level.empty() ? nullptr : std::move(level.front());
+  }
+};
+
+// chunk_iterator
+
+ustring::view urope::chunk_iterator::operator*() const noexcept
+{
+  return _leaf->text;
+}
+
+urope::chunk_iterator &urope::chunk_iterator::operator++() noexcept
+{
+  _leaf = _leaf->next;
+  return *this;
+}
+
+// code_point_iterator
+
+urope::code_point_iterator::code_point_iterator(const node *root, const node *leaf, size_type pos) noexcept
+    : _root(root), _leaf(leaf), _pos(pos)
+{
+  decode();
+}
+
+void urope::code_point_iterator::decode() noexcept
+{
+  if (!_leaf) {
+    _size = 0;
+    _codepoint = 0;
+    return;
+  }
+  const ustring &text = _leaf->text;
+  int32_t i = static_cast<int32_t>(_pos);
+  UChar32 c;
+  U8_NEXT(text.data(), i, text.size(), c);
+  _size = i - _pos;
+  _codepoint = c < 0 ? 0xFFFD : static_cast<char32_t>(c);
+}
+
+urope::code_point_iterator &urope::code_point_iterator::operator++() noexcept
+{
+  _pos += _size;
+  if (_pos >= static_cast<size_type>(_leaf->text.size())) {
+    _leaf = _leaf->next;
+    _pos = 0;
+  }
+  decode();
+  return *this;
+}
+
+urope::code_point_iterator &urope::code_point_iterator::operator--() noexcept
+{
+  if (!_leaf) {
+    _leaf = node::rightmost(const_cast<node *>(_root));
+    _pos = _leaf->text.size();
+  }
+  if (_pos == 0) {
+    _leaf = _leaf->prev;
+    _pos = _leaf->text.size();
+  }
+  do {
+    --_pos;
+  } while (_pos > 0 && is_continuation(_leaf->text.data()[_pos]));
+  decode();
+  return *this;
+}
+
+// urope
+
+urope::urope() = default;
+
+urope::urope(ustring::view str) : _root(node::build(str)) {}
+
+urope::urope(const urope &other)
+{
+  if (other._root) {
+    node *last_leaf = nullptr;
+    _root = other._root->clone(last_leaf);
+  }
+}
+
+urope::urope(urope &&other) noexcept = default;
+
+urope &urope::operator=(const urope &other)
+{
+  if (this != &other) {
+    urope copy(other);
+    _root = std::move(copy._root);
+  }
+  return *this;
+}
+
+urope &urope::operator=(urope &&other) noexcept = default;
+
+urope::~urope() = default;
+
+urope::size_type urope::size() const noexcept
+{
+  return _root ? _root->sum.bytes : 0;
+}
+
+urope::size_type urope::length() const noexcept
+{
+  return _root ? _root->sum.code_points : 0;
+}
+
+urope::size_type urope::line_count() const noexcept
+{
+  return (_root ? _root->sum.newlines : 0) + 1;
+}
+
+urope &urope::insert(size_type pos, ustring::view str)
+{
+  if (pos > size()) {
+    throw std::out_of_range("urope::insert: position out of range");
+  }
+  if (str.empty()) {
+    return *this;
+  }
+  if (!_root) {
+    _root = node::build(str);
+    return *this;
+  }
+  // Pieces of at most leaf_max bytes, so a leaf splits at most once per piece
+  for (size_t done = 0; done < static_cast<size_t>(str.size());) {
+    size_t n = std::min<size_t>(leaf_max, str.size() - done);
+    if (done + n < static_cast<size_t>(str.size())) {
+      n = boundary_before(str.data() + done, n);
+    }
+    const ustring::view piece(str.data() + done, static_cast<ustring::size_type>(n));
+    if (auto sibling = _root->insert(pos + done, piece, measure(piece.data(), n))) {
+      auto root = node::make_inner();
+      root->children.push_back(std::move(_root));
+      root->children.push_back(std::move(sibling));
+      root->refresh();
+      _root = std::move(root);
+    }
+    done += n;
+  }
+  return *this;
+}
+
+urope &urope::erase(size_type pos, size_type n)
+{
+  if (pos > size()) {
+    throw std::out_of_range("urope::erase: position out of range");
+  }
+  n = std::min(n, size() - pos);
+  if (n == 0) {
+    return *this;
+  }
+  if (n == size()) {
+    clear();
+    return *this;
+  }
+  _root->erase(pos, n);
+  while (!_root->leaf && _root->children.size() == 1) {
+    _root = std::move(_root->children.front());
+  }
+  return *this;
+}
+
+void urope::clear()
+{
+  _root.reset();
+}
+
+urope::size_type urope::byte_offset(size_type code_point) const
+{
+  if (code_point >= length()) {
+    if (code_point == length()) {
+      return size();
+    }
+    throw std::out_of_range("urope::byte_offset: code point out of range");
+  }
+  metrics before;
+  const node *leaf = node::find(_root.get(), code_point, &metrics::code_points, before);
+  return before.bytes + nth_code_point(leaf->text, code_point - before.code_points);
+}
+
+urope::size_type urope::code_point_index(size_type pos) const
+{
+  if (pos > size()) {
+    throw std::out_of_range("urope::code_point_index: position out of range");
+  }
+  if (pos == 0) {
+    return 0;
+  }
+  metrics before;
+  const node *leaf = node::find(_root.get(), pos, &metrics::bytes, before);
+  return before.code_points + ustring_simd::count_code_points(leaf->text.data(), pos - before.bytes);
+}
+
+urope::size_type urope::line_offset(size_type line) const
+{
+  if (line == 0) {
+    return 0;
+  }
+  if (line >= line_count()) {
+    throw std::out_of_range("urope::line_offset: line out of range");
+  }
+  // The line starts after newline number line - 1
+  metrics before;
+  const node *leaf = node::find(_root.get(), line - 1, &metrics::newlines, before);
+  const char8_t *data = leaf->text.data();
+  size_t k = line - 1 - before.newlines;
+  size_t i = 0;
+  for (;; ++i) {
+    if (data[i] == u8'\n' && k-- == 0) {
+      break;
+    }
+  }
+  return before.bytes + i + 1;
+}
+
+urope::size_type urope::line_index(size_type pos) const
+{
+  if (pos > size()) {
+    throw std::out_of_range("urope::line_index: position out of range");
+  }
+  if (pos == 0) {
+    return 0;
+  }
+  metrics before;
+  const node *leaf = node::find(_root.get(), pos, &metrics::bytes, before);
+  const char8_t *data = leaf->text.data();
+  return before.newlines + std::count(data, data + (pos - before.bytes), u8'\n');
+}
+
+char32_t urope::code_point_at(size_type code_point) const
+{
+  if (code_point >= length()) {
+    throw std::out_of_range("urope::code_point_at: code point out of range");
+  }
+  return *code_points_begin(code_point);
+}
+
+std::pair<ustring::view, urope::size_type> urope::chunk_at(size_type pos) const
+{
+  if (pos > size()) {
+    throw std::out_of_range("urope::chunk_at: position out of range");
+  }
+  if (!_root) {
+    return {};
+  }
+  metrics before;
+  const node *leaf = node::find(_root.get(), pos, &metrics::bytes, before);
+  return {leaf->text, before.bytes};
+}
+
+urope::chunk_iterator urope::chunks_begin() const noexcept
+{
+  return chunk_iterator(_root ? node::leftmost(_root.get()) : nullptr);
+}
+
+urope::code_point_iterator urope::code_points_begin(size_type code_point) const
+{
+  if (code_point >= length()) {
+    return code_points_end();
+  }
+  metrics before;
+  const node *leaf = node::find(_root.get(), code_point, &metrics::code_points, before);
+  return code_point_iterator(
+      _root.get(), leaf, nth_code_point(leaf->text, code_point - before.code_points));
+}
+
+urope::code_point_iterator urope::code_points_end() const noexcept
+{
+  return code_point_iterator(_root.get(), nullptr, 0);
+}
+
+ustring urope::substr(size_type pos, size_type n) const
+{
+  if (pos > size()) {
+    throw std::out_of_range("urope::substr: position out of range");
+  }
+  n = std::min(n, size() - pos);
+  ustring result;
+  if (n == 0) {
+    return result;
+  }
+  result.reserve(static_cast<ustring::size_type>(n));
+  metrics before;
+  const node *leaf = node::find(_root.get(), pos, &metrics::bytes, before);
+  for (size_t skip = pos - before.bytes; n > 0; leaf = leaf->next, skip = 0) {
+    const size_t take = std::min<size_t>(n, leaf->text.size() - skip);
+    result.append(leaf->text.data() + skip, static_cast<ustring::size_type>(take));
+    n -= take;
+  }
+  return result;
+}
+
+bool operator==(const urope &lhs, ustring::view rhs) noexcept
+{
+  if (lhs.size() != static_cast<size_t>(rhs.size())) {
+    return false;
+  }
+  size_t offset = 0;
+  for (const ustring::view chunk : lhs.chunks()) {
+    if (std::memcmp(chunk.data(), rhs.data() + offset, chunk.size()) != 0) {
+      return false;
+    }
+    offset += chunk.size();
+  }
+  return true;
+}
+
+bool operator==(const urope &lhs, const urope &rhs) noexcept
+{
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  auto a = lhs.chunks_begin();
+  auto b = rhs.chunks_begin();
+  size_t a_pos = 0;
+  size_t b_pos = 0;
+  while (a != lhs.chunks_end()) {
+    const ustring::view x = *a;
+    const ustring::view y = *b;
+    const size_t n = std::min<size_t>(x.size() - a_pos, y.size() - b_pos);
+    if (std::memcmp(x.data() + a_pos, y.data() + b_pos, n) != 0) {
+      return false;
+    }
+    a_pos += n;
+    b_pos += n;
+    if (a_pos == static_cast<size_t>(x.size())) {
+      ++a;
+      a_pos = 0;
+    }
+    if (b_pos == static_cast<size_t>(y.size())) {
+      ++b;
+      b_pos = 0;
+    }
+  }
+  return true;
+}
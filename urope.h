@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <utility>
+
+#include "ustring.h"
+
+// A rope for large editable UTF-8 documents. The text lives in chunks of at most a few KB, which
+// are the leaves of a B-tree, and every node caches the bytes, code points and newlines below it.
+// Inserting, erasing and finding a position by byte, code point or line are O(log n) instead of
+// moving the whole tail as ustring::insert and erase do.
+//
+// Positions are byte offsets, as in ustring, and must fall on code point boundaries. Chunks never
+// split a code point, so each one is valid UTF-8 on its own and can be handed out as a view.
+class urope {
+  struct node;
+
+ public:
+  using value_type = ustring::value_type;
+  using size_type = size_t;
+
+  static constexpr size_type npos = static_cast<size_type>(-1);
+
+  // Walks the chunks in order. Like every iterator and view into a rope, it is invalidated by any
+  // change to the rope.
+  class chunk_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ustring::view;
+    using reference = ustring::view;
+    using difference_type = std::ptrdiff_t;
+
+    chunk_iterator() noexcept = default;
+
+    ustring::view operator*() const noexcept;
+    chunk_iterator &operator++() noexcept;
+    chunk_iterator operator++(int) noexcept
+    {
+      chunk_iterator old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(const chunk_iterator &other) const noexcept = default;
+
+   private:
+    friend class urope;
+    explicit chunk_iterator(const node *leaf) noexcept : _leaf(leaf) {}
+
+    const node *_leaf = nullptr;
+  };
+
+  // Same interface as ustring::code_point_iterator, but steps from one chunk to the next
+  class code_point_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = char32_t;
+    using pointer = char32_t *;
+    using reference = char32_t;
+    using size_type = urope::size_type;
+    using difference_type = std::ptrdiff_t;
+
+    code_point_iterator() noexcept = default;
+
+    char32_t operator*() const noexcept
+    {
+      return _codepoint;
+    }
+    const char32_t *operator->() const noexcept
+    {
+      return &_codepoint;
+    }
+    code_point_iterator &operator++() noexcept;
+    code_point_iterator operator++(int) noexcept
+    {
+      code_point_iterator old = *this;
+      ++*this;
+      return old;
+    }
+    code_point_iterator &operator--() noexcept;
+    code_point_iterator operator--(int) noexcept
+    {
+      code_point_iterator old = *this;
+      --*this;
+      return old;
+    }
+    bool operator==(const code_point_iterator &other) const noexcept
+    {
+      return _leaf == other._leaf && _pos == other._pos;
+    }
+
+    // Bytes of the current code point
+    size_type size() const noexcept
+    {
+      return _size;
+    }
+    char32_t codepoint() const noexcept
+    {
+      return _codepoint;
+    }
+
+   private:
+    friend class urope;
+    code_point_iterator(const node *root, const node *leaf, size_type pos) noexcept;
+    void decode() noexcept;
+
+    const node *_root = nullptr;
+    // null past the end
+    const node *_leaf = nullptr;
+    size_type _pos = 0;
+    size_type _size = 0;
+    char32_t _codepoint = 0;
+  };
+
+  urope();
+  explicit urope(ustring::view str);
+  urope(const urope &other);
+  urope(urope &&other) noexcept;
+  urope &operator=(const urope &other);
+  urope &operator=(urope &&other) noexcept;
+  ~urope();
+
+  [[nodiscard]] size_type size() const noexcept;
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return size() == 0;
+  }
+  // Code points
+  [[nodiscard]] size_type length() const noexcept;
+  // Newlines plus one, so an empty rope has one (empty) line
+  [[nodiscard]] size_type line_count() const noexcept;
+
+  urope &insert(size_type pos, ustring::view str);
+  urope &erase(size_type pos, size_type n = npos);
+  urope &append(ustring::view str)
+  {
+    return insert(size(), str);
+  }
+  void clear();
+
+  // Byte offset of the code point with the given index, size() for length()
+  [[nodiscard]] size_type byte_offset(size_type code_point) const;
+  // Number of code points before byte offset `pos`
+  [[nodiscard]] size_type code_point_index(size_type pos) const;
+  // Byte offset where the line with the given index starts
+  [[nodiscard]] size_type line_offset(size_type line) const;
+  // Index of the line containing byte offset `pos`
+  [[nodiscard]] size_type line_index(size_type pos) const;
+  [[nodiscard]] char32_t code_point_at(size_type code_point) const;
+
+  // The chunk holding byte offset `pos` and the offset at which that chunk starts
+  [[nodiscard]] std::pair<ustring::view, size_type> chunk_at(size_type pos) const;
+  [[nodiscard]] chunk_iterator chunks_begin() const noexcept;
+  [[nodiscard]] chunk_iterator chunks_end() const noexcept
+  {
+    return {};
+  }
+  [[nodiscard]] auto chunks() const noexcept
+  {
+    return std::ranges::subrange(chunks_begin(), chunks_end());
+  }
+
+  // Iterator at the code point with the given index
+  [[nodiscard]] code_point_iterator code_points_begin(size_type code_point = 0) const;
+  [[nodiscard]] code_point_iterator code_points_end() const noexcept;
+  [[nodiscard]] auto code_points() const
+  {
+    return std::ranges::subrange(code_points_begin(), code_points_end());
+  }
+
+  [[nodiscard]] ustring substr(size_type pos, size_type n = npos) const;
+  [[nodiscard]] ustring to_ustring() const
+  {
+    return substr(0);
+  }
+
+  friend bool operator==(const urope &lhs, ustring::view rhs) noexcept;
+  friend bool operator==(const urope &lhs, const urope &rhs) noexcept;
+
+ private:
+  std::unique_ptr<node> _root;
+};
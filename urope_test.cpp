@@ -0,0 +1,194 @@
+#include "urope.h"
+#include "ustring_simd.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Several thousand lines of mixed width text, enough for a tree a few levels deep
+ustring sample_text(int lines)
+{
+  ustring text;
+  for (int i = 0; i < lines; ++i) {
+    text.append(ustring(std::to_string(i)));
+    text.append(ustring(u8" línea 行 🌍 of the sample document\n"));
+  }
+  return text;
+}
+
+}  // namespace
+
+TEST(UropeTest, Empty)
+{
+  urope rope;
+  EXPECT_TRUE(rope.empty());
+  EXPECT_EQ(rope.size(), 0u);
+  EXPECT_EQ(rope.length(), 0u);
+  EXPECT_EQ(rope.line_count(), 1u);
+  EXPECT_EQ(rope.byte_offset(0), 0u);
+  EXPECT_EQ(rope.code_point_index(0), 0u);
+  EXPECT_EQ(rope.line_offset(0), 0u);
+  EXPECT_TRUE(rope.chunks().empty());
+  EXPECT_EQ(rope.code_points_begin(), rope.code_points_end());
+  EXPECT_TRUE(rope.to_ustring().empty());
+  EXPECT_TRUE(rope == ustring::view());
+  EXPECT_THROW(rope.insert(1, ustring(u8"x")), std::out_of_range);
+}
+
+TEST(UropeTest, BuildAndMetrics)
+{
+  const ustring text = sample_text(3000);
+  const urope rope(text);
+  EXPECT_EQ(rope.size(), static_cast<size_t>(text.size()));
+  EXPECT_EQ(rope.length(), static_cast<size_t>(text.length()));
+  EXPECT_EQ(rope.line_count(), 3001u);
+  EXPECT_TRUE(rope == text);
+  EXPECT_EQ(rope.to_ustring(), text);
+
+  // every chunk is complete UTF-8
+  size_t chunks = 0;
+  for (const ustring::view chunk : rope.chunks()) {
+    EXPECT_EQ(static_cast<size_t>(chunk.length()),
+              ustring_simd::count_code_points(chunk.data(), chunk.size()));
+    EXPECT_NE(chunk.data()[0] & 0xC0, 0x80);
+    ++chunks;
+  }
+  EXPECT_GT(chunks, 16u);
+}
+
+TEST(UropeTest, PositionLookups)
+{
+  const ustring text = sample_text(2000);
+  const urope rope(text);
+
+  const ustring::view line = text.substr_view(0, text.find(u8'\n') + 1);
+  EXPECT_EQ(rope.line_offset(1), static_cast<size_t>(line.size()));
+  for (size_t i : {0u, 1u, 17u, 999u, 1999u}) {
+    const size_t offset = rope.line_offset(i);
+    EXPECT_EQ(rope.line_index(offset), i);
+    EXPECT_TRUE(offset == 0 || text.data()[offset - 1] == u8'\n');
+    EXPECT_EQ(rope.substr(offset, std::to_string(i).size()), ustring(std::to_string(i)));
+  }
+  EXPECT_THROW((void)rope.line_offset(2001), std::out_of_range);
+
+  size_t cp = 0;
+  for (size_t pos = 0; pos < rope.size(); pos += 997) {
+    while (text.data()[pos] >= 0x80 && text.data()[pos] < 0xC0) {
+      ++pos;
+    }
+    cp = rope.code_point_index(pos);
+    EXPECT_EQ(cp, ustring_simd::count_code_points(text.data(), pos));
+    EXPECT_EQ(rope.byte_offset(cp), pos);
+  }
+  EXPECT_EQ(rope.byte_offset(rope.length()), rope.size());
+  EXPECT_EQ(rope.code_point_at(rope.code_point_index(line.find(u8"行"))), U'行');
+
+  const auto [chunk, start] = rope.chunk_at(5000);
+  EXPECT_LE(start, 5000u);
+  EXPECT_GT(start + chunk.size(), 5000u);
+  EXPECT_EQ(chunk, text.substr_view(static_cast<ustring::size_type>(start), chunk.size()));
+}
+
+TEST(UropeTest, CodePointIterator)
+{
+  const ustring text = sample_text(300);
+  const urope rope(text);
+
+  std::u32string forward;
+  for (char32_t c : rope.code_points()) {
+    forward.push_back(c);
+  }
+  std::u32string expected;
+  for (char32_t c : text.code_points()) {
+    expected.push_back(c);
+  }
+  EXPECT_EQ(forward, expected);
+
+  std::u32string backward;
+  for (auto it = rope.code_points_end(); it != rope.code_points_begin();) {
+    backward.push_back(*--it);
+  }
+  std::reverse(backward.begin(), backward.end());
+  EXPECT_EQ(backward, expected);
+
+  auto it = rope.code_points_begin(rope.code_point_index(text.find(u8"🌍")));
+  EXPECT_EQ(*it, U'🌍');
+  EXPECT_EQ(it.size(), 4u);
+  EXPECT_EQ(*++it, U' ');
+}
+
+TEST(UropeTest, InsertAndErase)
+{
+  urope rope(ustring(u8"hello world"));
+  rope.insert(5, ustring(u8", 美丽的"));
+  EXPECT_TRUE(rope == ustring(u8"hello, 美丽的 world"));
+  rope.erase(5, 11);
+  EXPECT_TRUE(rope == ustring(u8"hello world"));
+  rope.append(ustring(u8"!\n"));
+  EXPECT_EQ(rope.line_count(), 2u);
+  rope.erase(0);
+  EXPECT_TRUE(rope.empty());
+
+  // a large insert in the middle of a large rope
+  const ustring text = sample_text(2000);
+  urope big(text);
+  const size_t middle = big.line_offset(1000);
+  big.insert(middle, text);
+  EXPECT_EQ(big.size(), 2u * text.size());
+  EXPECT_EQ(big.line_count(), 4001u);
+  EXPECT_EQ(big.substr(middle, text.size()), text);
+  big.erase(middle, text.size());
+  EXPECT_TRUE(big == text);
+
+  urope copy = big;
+  copy.erase(10, copy.size() - 20);
+  EXPECT_EQ(copy.size(), 20u);
+  EXPECT_TRUE(big == text);
+  EXPECT_FALSE(copy == big);
+  copy = big;
+  EXPECT_TRUE(copy == big);
+}
+
+TEST(UropeTest, RandomEditsMatchUstring)
+{
+  std::mt19937 rng(12345);
+  const std::vector<ustring> pieces = {ustring(u8"a"),
+                                       ustring(u8"\n"),
+                                       ustring(u8"é"),
+                                       ustring(u8"日本語"),
+                                       ustring(u8"🌍\n"),
+                                       ustring(std::string(700, 'x')),
+                                       sample_text(40)};
+  ustring reference;
+  urope rope;
+  auto boundary = [&reference](size_t pos) {
+    while (pos < static_cast<size_t>(reference.size()) && (reference.data()[pos] & 0xC0) == 0x80) {
+      ++pos;
+    }
+    return pos;
+  };
+
+  for (int step = 0; step < 3000; ++step) {
+    const size_t pos = boundary(rng() % (reference.size() + 1));
+    if (rng() % 3 != 0 || reference.size() < 64) {
+      const ustring &piece = pieces[rng() % pieces.size()];
+      reference.insert(static_cast<ustring::size_type>(pos), piece);
+      rope.insert(pos, piece);
+    }
+    else {
+      const size_t end = boundary(std::min<size_t>(pos + rng() % 3000, reference.size()));
+      reference.erase(static_cast<ustring::size_type>(pos), static_cast<ustring::size_type>(end - pos));
+      rope.erase(pos, end - pos);
+    }
+    ASSERT_EQ(rope.size(), static_cast<size_t>(reference.size())) << "step " << step;
+    if (step % 100 == 0) {
+      ASSERT_TRUE(rope == reference) << "step " << step;
+      ASSERT_EQ(rope.length(), static_cast<size_t>(reference.length()));
+      ASSERT_EQ(rope.line_count(),
+                1u + std::count(reference.begin(), reference.end(), u8'\n'));
+    }
+  }
+  EXPECT_TRUE(rope == reference);
+}
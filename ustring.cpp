@@ -1,40 +1,54 @@
 #include "ustring.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cstring>
 #include <locale>
+#include <map>
 #include <memory>
 #include <numeric>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+
+#include "ustring_simd.h"
 
 #define U_CHARSET_IS_UTF8 1
 
 #include <unicode/brkiter.h>
+#include <unicode/bytestream.h>
 #include <unicode/casemap.h>
 #include <unicode/coleitr.h>
 #include <unicode/coll.h>
+#include <unicode/edits.h>
 #include <unicode/errorcode.h>
 #include <unicode/localpointer.h>
 #include <unicode/locid.h>
+#include <unicode/normalizer2.h>
 #include <unicode/schriter.h>
 #include <unicode/tblcoll.h>
 #include <unicode/translit.h>
 #include <unicode/ubrk.h>
+#include <unicode/ucasemap.h>
 #include <unicode/uchar.h>
 #include <unicode/uclean.h>
 #include <unicode/ucnv.h>
 #include <unicode/ucol.h>
 #include <unicode/ucsdet.h>
 #include <unicode/udat.h>
+#include <unicode/uloc.h>
 #include <unicode/umsg.h>
 #include <unicode/unistr.h>
 #include <unicode/unorm2.h>
 #include <unicode/unum.h>
 #include <unicode/urename.h>
 #include <unicode/usearch.h>
+#include <unicode/uset.h>
 #include <unicode/ustream.h>
 #include <unicode/ustring.h>
 #include <unicode/utf16.h>
@@ -75,14 +89,44 @@ auto _swap_case(char32_t c, ustring::size_type)
   return c;
 }
 
-auto _to_lower(char32_t c, ustring::size_type)
-{
-  return u_tolower(c);
-}
-
-auto _to_upper(char32_t c, ustring::size_type)
+// Writes the simple case mappings of s[r, n) to d from w, with the ASCII letters already mapped
+// and ill-formed bytes copied as they are. When d is s, it stops before a mapping that would
+// overwrite bytes not read yet and returns false; r and w then point at that code point and at
+// where it goes.
+bool map_simple_case(bool upper, const char8_t *s, int32_t &r, int32_t n, char8_t *d, int32_t &w)
 {
-  return u_toupper(c);
+  const bool in_place = s == d;
+  while (r < n) {
+    if (s[r] < 0x80) {
+      if (in_place && w == r) {
+        while (++r < n && s[r] < 0x80) {
+        }
+        w = r;
+      }
+      else {
+        d[w++] = s[r++];
+      }
+      continue;
+    }
+    const int32_t start = r;
+    UChar32 c;
+    U8_NEXT(s, r, n, c);
+    const UChar32 mapped = c < 0 ? c : upper ? u_toupper(c) : u_tolower(c);
+    if (mapped == c) {
+      if (w != start) {
+        std::memmove(d + w, s + start, r - start);
+      }
+      w += r - start;
+    }
+    else if (in_place && w + U8_LENGTH(mapped) > r) {
+      r = start;
+      return false;
+    }
+    else {
+      U8_APPEND_UNSAFE(d, w, mapped);
+    }
+  }
+  return true;
 }
 
 const char *_get_normalization_data_file(const NormalizationConfig &config)
@@ -102,6 +146,254 @@ const char *_get_normalization_data_file(const NormalizationConfig &config)
   return nullptr;
 }
 
+const icu::Normalizer2 *_get_normalizer(const NormalizationConfig &config)
+{
+  UErrorCode status = U_ZERO_ERROR;
+  const icu::Normalizer2 *normalizer =
+      icu::Normalizer2::getInstance(nullptr,
+                                    _get_normalization_data_file(config),
+                                    static_cast<UNormalization2Mode>(config.mode),
+                                    status);
+  return U_SUCCESS(status) ? normalizer : nullptr;
+}
+
+// Offset from which `str` can need normalizing. With the nfc and nfkc data, ASCII is normalized
+// in every mode and nothing before an ASCII character interacts with it, so a leading ASCII run
+// can be skipped up to its last character, which may still combine with a mark after it.
+// Case folding data maps ASCII too, so there (and for custom data) everything is checked.
+size_t _normalization_start(const NormalizationConfig &config, ustring::view str)
+{
+  if (config.data_file != NormalizationDataFile::NFC &&
+      config.data_file != NormalizationDataFile::NFKC) {
+    return 0;
+  }
+  const size_t ascii = ustring_simd::ascii_prefix(str.data(), str.size());
+  return ascii == static_cast<size_t>(str.size()) || ascii == 0 ? ascii : ascii - 1;
+}
+
+// Appends ICU's UTF-8 output to a ustring
+class ustring_sink : public icu::ByteSink {
+ public:
+  explicit ustring_sink(ustring &out) : _out(out) {}
+
+  void Append(const char *bytes, int32_t n) override
+  {
+    _out.append(reinterpret_cast<const char8_t *>(bytes), n);
+  }
+
+ private:
+  ustring &_out;
+};
+
+// ICU services that take far longer to create than to use, cached per thread. Break iterators
+// are opened once per type and locale: calls that finish with one borrow the cached instance,
+// iterator objects that outlive the call get a clone of it. Title case maps keep the break
+// iterator ICU creates for them, and transliterators are only used through const members.
+class icu_service_cache {
+ public:
+  static icu_service_cache &local()
+  {
+    thread_local icu_service_cache cache;
+    return cache;
+  }
+
+  // A null locale is the default locale at the time of the call
+  UBreakIterator *break_iterator(UBreakIteratorType type, const char *locale, UErrorCode &status)
+  {
+    if (!locale)
+      locale = uloc_getDefault();
+    for (auto &entry : _break_iterators) {
+      if (entry.type == type && entry.locale == locale)
+        return entry.iterator.getAlias();
+    }
+    icu::LocalUBreakIteratorPointer iterator(ubrk_open(type, locale, nullptr, 0, &status));
+    if (U_FAILURE(status))
+      return nullptr;
+    return _break_iterators.emplace_back(type, locale, std::move(iterator)).iterator.getAlias();
+  }
+
+  UCaseMap *title_case_map(const char *locale, uint32_t options, UErrorCode &status)
+  {
+    for (auto &entry : _title_case_maps) {
+      if (entry.options == options && entry.locale == locale)
+        return entry.case_map.getAlias();
+    }
+    icu::LocalUCaseMapPointer case_map(ucasemap_open(locale, options, &status));
+    if (U_FAILURE(status))
+      return nullptr;
+    return _title_case_maps.emplace_back(locale, options, std::move(case_map)).case_map.getAlias();
+  }
+
+  const icu::Transliterator *transliterator(const char *id, UErrorCode &status)
+  {
+    for (auto &entry : _transliterators) {
+      if (entry.id == id)
+        return entry.transliterator.get();
+    }
+    std::unique_ptr<icu::Transliterator> transliterator(icu::Transliterator::createInstance(
+        icu::UnicodeString::fromUTF8(id), UTRANS_FORWARD, status));
+    if (U_FAILURE(status))
+      return nullptr;
+    return _transliterators.emplace_back(id, std::move(transliterator)).transliterator.get();
+  }
+
+ private:
+  struct break_iterator_entry {
+    UBreakIteratorType type;
+    std::string locale;
+    icu::LocalUBreakIteratorPointer iterator;
+  };
+  struct case_map_entry {
+    std::string locale;
+    uint32_t options;
+    icu::LocalUCaseMapPointer case_map;
+  };
+  struct transliterator_entry {
+    std::string id;
+    std::unique_ptr<icu::Transliterator> transliterator;
+  };
+
+  // a handful of entries per thread, so a linear search beats hashing the locale name
+  std::vector<break_iterator_entry> _break_iterators;
+  std::vector<case_map_entry> _title_case_maps;
+  std::vector<transliterator_entry> _transliterators;
+};
+
+// The calling thread's cached break iterator for the length of a scope. Its text is reset on the
+// way out so the cache never points into a string that is gone.
+class borrowed_break_iterator {
+ public:
+  borrowed_break_iterator(UBreakIteratorType type, const char *locale, UErrorCode &status)
+      : _iterator(icu_service_cache::local().break_iterator(type, locale, status))
+  {
+  }
+  borrowed_break_iterator(const borrowed_break_iterator &) = delete;
+  borrowed_break_iterator &operator=(const borrowed_break_iterator &) = delete;
+  ~borrowed_break_iterator()
+  {
+    if (_iterator) {
+      UErrorCode status = U_ZERO_ERROR;
+      ubrk_setText(_iterator, u"", 0, &status);
+    }
+  }
+
+  UBreakIterator *get() const noexcept
+  {
+    return _iterator;
+  }
+
+ private:
+  UBreakIterator *_iterator;
+};
+
+// A break iterator the caller owns, cloned from the calling thread's cached one
+UBreakIterator *_open_break_iterator(UBreakIteratorType type,
+                                     const char *locale,
+                                     UErrorCode &status)
+{
+  UBreakIterator *cached = icu_service_cache::local().break_iterator(type, locale, status);
+  return cached ? ubrk_clone(cached, &status) : nullptr;
+}
+
+// Runs `str` through the calling thread's cached transliterator `id`; on failure `str` is left
+// as it was
+void _transliterate(ustring &str, const char *id)
+{
+  UErrorCode status = U_ZERO_ERROR;
+  const icu::Transliterator *trans = icu_service_cache::local().transliterator(id, status);
+  if (!trans)
+    return;
+  icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
+      icu::StringPiece(reinterpret_cast<const char *>(str.data()), str.size()));
+  trans->transliterate(ustr);
+  std::string utf8;
+  ustr.toUTF8String(utf8);
+  str.assign(reinterpret_cast<const char8_t *>(utf8.data()), utf8.length());
+}
+
+// Members of a strip() set. ASCII members live in a bitmap the byte kernels can scan with, the
+// rest in sorted, merged code point ranges.
+class code_point_set {
+ public:
+  explicit code_point_set(ustring::view chars)
+  {
+    const char8_t *p = chars.data();
+    const int32_t length = static_cast<int32_t>(chars.size());
+    std::vector<UChar32> others;
+    for (int32_t i = 0; i < length;) {
+      UChar32 c;
+      U8_NEXT(p, i, length, c);
+      if (c < 0)
+        break;
+      if (c < 0x80)
+        _ascii.insert(static_cast<uint8_t>(c));
+      else
+        others.push_back(c);
+    }
+
+    std::sort(others.begin(), others.end());
+    for (const UChar32 c : others) {
+      if (!_ranges.empty() && c <= _ranges.back().second + 1)
+        _ranges.back().second = c;
+      else
+        _ranges.emplace_back(c, c);
+    }
+  }
+
+  bool contains(UChar32 c) const noexcept
+  {
+    if (c < 0)
+      return false;
+    if (c < 0x80)
+      return _ascii.contains(static_cast<uint8_t>(c));
+    auto it = std::upper_bound(_ranges.begin(),
+                               _ranges.end(),
+                               c,
+                               [](UChar32 v, const auto &range) { return v < range.first; });
+    return it != _ranges.begin() && c <= (--it)->second;
+  }
+
+  // Byte range of `src` left after removing leading and trailing members. Stripping stops at
+  // the first ill-formed sequence from either side.
+  std::pair<ustring::size_type, ustring::size_type> strip_bounds(const char8_t *src,
+                                                               ustring::size_type length) const
+  {
+    if (_ranges.empty()) {
+      // Bytes of multi-byte sequences are never ASCII members, so a byte scan is exact
+      const size_t start = ustring_simd::find_first_not_of(src, length, _ascii);
+      if (start == ustring_simd::not_found)
+        return {length, length};
+      const size_t last = ustring_simd::find_last_not_of(src, length, _ascii);
+      return {static_cast<ustring::size_type>(start), static_cast<ustring::size_type>(last + 1)};
+    }
+
+    const int32_t src_length = static_cast<int32_t>(length);
+    int32_t start = 0, end = src_length;
+    UChar32 c;
+    while (start < src_length) {
+      const int32_t old_start = start;
+      U8_NEXT(src, start, src_length, c);
+      if (!contains(c)) {
+        start = old_start;
+        break;
+      }
+    }
+    while (end > start) {
+      const int32_t old_end = end;
+      U8_PREV(src, start, end, c);
+      if (!contains(c)) {
+        end = old_end;
+        break;
+      }
+    }
+    return {static_cast<ustring::size_type>(start), static_cast<ustring::size_type>(end)};
+  }
+
+ private:
+  ustring_simd::byte_set _ascii;
+  std::vector<std::pair<UChar32, UChar32>> _ranges;
+};
+
 }  // namespace
 
 std::string to_utf8(char32_t codepoint)
@@ -135,50 +427,10 @@ std::string to_utf8(char32_t codepoint)
   return sResult;
 }
 
-inline CharProperty operator|(CharProperty a, CharProperty b)
-{
-  return static_cast<CharProperty>(static_cast<int>(a) | static_cast<int>(b));
-}
-
-bool has_property(std::u8string_view str, CharProperty property)
-{
-  if (str.empty()) {
-    return false;
-  }
-
-  int32_t offset = 0, len = str.size();
-  UChar32 codePoint;
-
-  U8_NEXT(str.data(), offset, len, codePoint);
-  if (codePoint < 0 || len < str.size()) {
-    return false;
-  }
-
-  return has_property(codePoint, property);
-}
-
-bool has_property(const char8_t *str, CharProperty property)
-{
-  return str && has_property(to_codepoint(str), property);
-}
-
-bool has_property(char32_t codepoint, CharProperty property)
-{
-  auto result = get_property(codepoint);
-  return (static_cast<int>(result) & static_cast<int>(property)) != 0;
-}
-
-CharProperty get_property(std::u8string_view str)
-{
-  return str.empty() ? CharProperty::NONE : get_property(to_codepoint(str.data()));
-}
-
-CharProperty get_property(const char8_t *str)
-{
-  return str ? get_property(to_codepoint(str)) : CharProperty::NONE;
-}
+namespace {
 
-CharProperty get_property(char32_t codepoint)
+// Every property behind CharProperty, straight from ICU. property_table caches the result.
+uint32_t _compute_property(UChar32 codepoint)
 {
   uint32_t result = 0;
   if (u_isalpha(codepoint))
@@ -245,7 +497,256 @@ CharProperty get_property(char32_t codepoint)
     result |= static_cast<uint32_t>(CharProperty::SPACE);
   // if (u_hasBinaryProperty(codepoint, UCHAR_PRIVATE_USE))
   //   result |= static_cast<uint32_t>(CharProperty::PRIVATE_USE);
-  return static_cast<CharProperty>(result);
+  return result;
+}
+
+
+// The binary properties _compute_property asks ICU about
+constexpr UProperty _binary_properties[] = {
+    UCHAR_EMOJI,
+    UCHAR_IDEOGRAPHIC,
+    UCHAR_MATH,
+    UCHAR_DASH,
+    UCHAR_DIACRITIC,
+    UCHAR_EXTENDER,
+    UCHAR_GRAPHEME_BASE,
+    UCHAR_GRAPHEME_EXTEND,
+    UCHAR_GRAPHEME_LINK,
+    UCHAR_IDS_BINARY_OPERATOR,
+    UCHAR_IDS_TRINARY_OPERATOR,
+    UCHAR_JOIN_CONTROL,
+    UCHAR_LOGICAL_ORDER_EXCEPTION,
+    UCHAR_NONCHARACTER_CODE_POINT,
+    UCHAR_QUOTATION_MARK,
+    UCHAR_RADICAL,
+    UCHAR_SOFT_DOTTED,
+    UCHAR_TERMINAL_PUNCTUATION,
+    UCHAR_UNIFIED_IDEOGRAPH,
+    UCHAR_VARIATION_SELECTOR,
+    UCHAR_WHITE_SPACE,
+};
+
+// CharProperty masks of all code points in three stages: a block number for every 128 code
+// points, the distinct blocks as indices into the distinct masks, and the masks. A lookup is
+// three dependent loads.
+class property_table {
+ public:
+  static const property_table &instance()
+  {
+    static const property_table table;
+    return table;
+  }
+
+  uint32_t operator[](UChar32 c) const noexcept
+  {
+    if (static_cast<uint32_t>(c) > 0x10FFFF)
+      return 0;
+    return _masks[_blocks[_index[c >> block_bits] << block_bits | (c & block_mask)]];
+  }
+
+  // The ASCII characters with any of the properties in `mask` (with = true) or with none of them
+  ustring_simd::byte_set ascii_set(uint32_t mask, bool with) const noexcept
+  {
+    ustring_simd::byte_set set;
+    for (; mask != 0; mask &= mask - 1) {
+      const ustring_simd::byte_set &bit = _ascii_sets[std::countr_zero(mask)];
+      set.bits[0] |= bit.bits[0];
+      set.bits[1] |= bit.bits[1];
+      for (int i = 0; i < 16; ++i) {
+        set.low_nibble[i] |= bit.low_nibble[i];
+      }
+    }
+    if (!with) {
+      set.bits[0] = ~set.bits[0];
+      set.bits[1] = ~set.bits[1];
+      for (auto &row : set.low_nibble) {
+        row = static_cast<uint8_t>(~row);
+      }
+    }
+    return set;
+  }
+
+ private:
+  static constexpr int block_bits = 7;
+  static constexpr UChar32 block_size = 1 << block_bits;
+  static constexpr UChar32 block_mask = block_size - 1;
+  static constexpr UChar32 code_point_limit = 0x110000;
+
+  // Built on first use. ICU's data is constant between the boundaries of the general category
+  // ranges and of the binary property sets, so the properties are computed once per such range
+  // instead of once per code point. u_isspace and u_isxdigit also single out some Latin-1 and
+  // fullwidth characters, which are computed one by one.
+  property_table()
+  {
+    std::vector<UChar32> cuts{0, code_point_limit};
+    u_enumCharTypes(
+        [](const void *context, UChar32 start, UChar32, UCharCategory) -> UBool {
+          static_cast<std::vector<UChar32> *>(const_cast<void *>(context))->push_back(start);
+          return true;
+        },
+        &cuts);
+    UErrorCode status = U_ZERO_ERROR;
+    for (const UProperty property : _binary_properties) {
+      const USet *set = u_getBinaryPropertySet(property, &status);
+      for (int32_t i = 0, n = U_SUCCESS(status) ? uset_getItemCount(set) : 0; i < n; ++i) {
+        UChar32 start, end;
+        uset_getItem(set, i, &start, &end, nullptr, 0, &status);
+        cuts.push_back(start);
+        cuts.push_back(end + 1);
+      }
+    }
+    if (U_FAILURE(status)) {
+      cuts.resize(code_point_limit + 1);
+      std::iota(cuts.begin(), cuts.end(), 0);
+    }
+    for (UChar32 c = 0; c <= 0xFF; ++c) {
+      cuts.push_back(c);
+    }
+    for (UChar32 c = 0xFF00; c <= 0xFFFF; ++c) {
+      cuts.push_back(c);
+    }
+    std::sort(cuts.begin(), cuts.end());
+    cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+    std::unordered_map<uint32_t, uint16_t> mask_ids;
+    std::map<std::array<uint16_t, block_size>, uint16_t> block_ids;
+    std::array<uint16_t, block_size> block;
+    _index.resize(code_point_limit >> block_bits);
+    uint16_t id = 0;
+    for (UChar32 c = 0, cut = 0; c < code_point_limit; ++c) {
+      if (c == cuts[cut]) {
+        const uint32_t mask = _compute_property(c);
+        auto [it, inserted] = mask_ids.try_emplace(mask, static_cast<uint16_t>(_masks.size()));
+        if (inserted)
+          _masks.push_back(mask);
+        id = it->second;
+        ++cut;
+      }
+      block[c & block_mask] = id;
+      if ((c & block_mask) == block_mask) {
+        auto [it, inserted] = block_ids.try_emplace(block, static_cast<uint16_t>(block_ids.size()));
+        if (inserted)
+          _blocks.insert(_blocks.end(), block.begin(), block.end());
+        _index[c >> block_bits] = it->second;
+      }
+    }
+
+    for (UChar32 c = 0; c < 0x80; ++c) {
+      for (uint32_t mask = (*this)[c]; mask != 0; mask &= mask - 1) {
+        _ascii_sets[std::countr_zero(mask)].insert(static_cast<uint8_t>(c));
+      }
+    }
+  }
+
+  std::vector<uint16_t> _index;
+  std::vector<uint16_t> _blocks;
+  std::vector<uint32_t> _masks;
+  ustring_simd::byte_set _ascii_sets[32];  // the ASCII characters with each property bit
+};
+
+// Offset of the first code point from `pos` on that has (Has) or lacks all of the properties in
+// `mask`, or npos. Runs of 16 or more ASCII characters go to the byte set kernels, which skip the
+// ones that cannot match a block at a time; everything else is looked up one by one.
+template<bool Has>
+ustring::size_type _find_property(ustring::view str, ustring::size_type pos, uint32_t mask) noexcept
+{
+  const property_table &table = property_table::instance();
+  const ustring_simd::byte_set skip = table.ascii_set(mask, !Has);
+  const char8_t *s = str.data();
+  const int32_t len = str.size();
+  int32_t ascii_run = 0;
+  for (int32_t i = pos; i < len;) {
+    if (s[i] < 0x80) {
+      if (!skip.contains(s[i]))
+        return i;
+      ++i;
+      if (++ascii_run == 16) {
+        const size_t offset = ustring_simd::find_first_not_of(s + i, len - i, skip);
+        if (offset == ustring_simd::not_found)
+          return ustring::npos;
+        i += static_cast<int32_t>(offset);
+        ascii_run = 0;
+      }
+      continue;
+    }
+    ascii_run = 0;
+    const int32_t start = i;
+    UChar32 c;
+    U8_NEXT(s, i, len, c);
+    if (((table[c] & mask) != 0) == Has)
+      return start;
+  }
+  return ustring::npos;
+}
+
+size_t _count_property(ustring::view str, uint32_t mask) noexcept
+{
+  const property_table &table = property_table::instance();
+  const char8_t *s = str.data();
+  const int32_t len = str.size();
+  // all ASCII members in one pass, then the other code points one by one
+  size_t n = ustring_simd::count_of(s, len, table.ascii_set(mask, true));
+  for (int32_t i = static_cast<int32_t>(ustring_simd::ascii_prefix(s, len)); i < len;) {
+    if (s[i] < 0x80) {
+      i += static_cast<int32_t>(ustring_simd::ascii_prefix(s + i, len - i));
+      continue;
+    }
+    UChar32 c;
+    U8_NEXT(s, i, len, c);
+    n += (table[c] & mask) != 0;
+  }
+  return n;
+}
+
+// Whether every code point of `str` has one of the properties in `mask`. False for empty or
+// ill-formed text.
+bool _all_have_property(ustring::view str, uint32_t mask) noexcept
+{
+  return !str.empty() && _find_property<false>(str, 0, mask) == ustring::npos;
+}
+
+}  // namespace
+
+bool has_property(std::u8string_view str, CharProperty property)
+{
+  if (str.empty()) {
+    return false;
+  }
+
+  int32_t offset = 0, len = str.size();
+  UChar32 codePoint;
+
+  U8_NEXT(str.data(), offset, len, codePoint);
+  if (codePoint < 0 || len < str.size()) {
+    return false;
+  }
+
+  return has_property(codePoint, property);
+}
+
+bool has_property(const char8_t *str, CharProperty property)
+{
+  return str && has_property(to_codepoint(str), property);
+}
+
+bool has_property(char32_t codepoint, CharProperty property)
+{
+  return (property_table::instance()[codepoint] & static_cast<uint32_t>(property)) != 0;
+}
+
+CharProperty get_property(std::u8string_view str)
+{
+  return str.empty() ? CharProperty::NONE : get_property(to_codepoint(str.data()));
+}
+
+CharProperty get_property(const char8_t *str)
+{
+  return str ? get_property(to_codepoint(str)) : CharProperty::NONE;
+}
+
+CharProperty get_property(char32_t codepoint)
+{
+  return static_cast<CharProperty>(property_table::instance()[codepoint]);
 }
 
 char32_t to_codepoint(std::u8string_view str)
@@ -283,21 +784,88 @@ char32_t to_codepoint(const char *str, size_t offset)
   return 0;
 }
 
-void ustring::preallocate(ustring::size_type size)
+namespace {
+
+std::atomic<ustring::growth_policy> growth;
+
+// Smallest mimalloc size class holding n bytes: 8 byte steps up to 64, then four steps per
+// power of two
+int64_t round_to_size_class(int64_t n)
+{
+  if (n <= 64) {
+    return (n + 7) & ~int64_t{7};
+  }
+  const int64_t step = int64_t{1} << (std::bit_width(static_cast<uint64_t>(n - 1)) - 3);
+  return (n + step - 1) & ~(step - 1);
+}
+
+}  // namespace
+
+void ustring::set_growth_policy(growth_policy policy) noexcept
+{
+  growth.store(policy, std::memory_order_relaxed);
+}
+
+ustring::growth_policy ustring::get_growth_policy() noexcept
+{
+  return growth.load(std::memory_order_relaxed);
+}
+
+ustring::size_type ustring::next_capacity(size_type required) const noexcept
+{
+  const growth_policy policy = get_growth_policy();
+  const int64_t current = capacity();
+  int64_t result = policy.factor == growth_policy::Factor::DOUBLE ? current * 2 : current + current / 2;
+  result = std::max<int64_t>(result, required);
+  if (policy.size_classes) {
+    result = round_to_size_class(result);
+  }
+  return static_cast<size_type>(std::min<int64_t>(result, max_size()));
+}
+
+ustring::value_type *ustring::allocate(size_type capacity, std::pmr::memory_resource *resource)
+{
+  if (!resource) {
+    return new value_type[capacity];
+  }
+  auto *block = static_cast<value_type *>(
+      resource->allocate(resource_header + capacity, alignof(std::pmr::memory_resource *)));
+  std::memcpy(block, &resource, resource_header);
+  return block + resource_header;
+}
+
+void ustring::preallocate(ustring::size_type size, std::pmr::memory_resource *resource)
 {
-  if (size <= default_size) {
-    _using_buffer = true;
-    _capacity = default_size;
-    // if (size < default_size) {
-    //   _buf[size] = '\0';
-    // }
+  if (size <= default_size && !resource) {
+    _buf[default_size] = static_cast<value_type>(default_size - size);
   }
   else {
-    _using_buffer = false;
-    _capacity = size;
-    _ptr = new value_type[_capacity];
+    set_heap(allocate(size, resource), size, size, resource);
   }
-  _size = size;
+}
+
+void ustring::release() noexcept
+{
+  if (is_using_buffer()) {
+    return;
+  }
+  if (std::pmr::memory_resource *r = resource()) {
+    r->deallocate(
+        _ptr - resource_header, resource_header + _capacity, alignof(std::pmr::memory_resource *));
+  }
+  else {
+    delete[] _ptr;
+  }
+}
+
+std::pmr::memory_resource *ustring::resource() const noexcept
+{
+  if ((tag() & resource_flag) == 0) {
+    return nullptr;
+  }
+  std::pmr::memory_resource *result;
+  std::memcpy(&result, _ptr - resource_header, resource_header);
+  return result;
 }
 
 ustring::ustring()
@@ -307,93 +875,86 @@ ustring::ustring()
 
 ustring::ustring(const ustring &other)
 {
-  _using_buffer = other._using_buffer;
-  _capacity = other._capacity;
-  if (!is_using_buffer()) {
-    _ptr = new value_type[_capacity];
+  if (other.is_using_buffer()) {
+    std::memcpy(_buf, other._buf, sizeof(_buf));
+    return;
   }
+  preallocate(other.size());
   std::memcpy(data(), other.data(), other.size());
-  _size = other._size;
+  if (!is_using_buffer()) {
+    _length = std::atomic_ref(other._length).load(std::memory_order_relaxed);
+  }
 }
 
 ustring::ustring(ustring &&other) noexcept
 {
-  _using_buffer = other._using_buffer;
-  _capacity = other._capacity;
-  other._capacity = default_size;
-  if (is_using_buffer()) {
-    std::memmove(data(), other.data(), other.size());
-  }
-  else {
-    _ptr = other._ptr;
-    other._ptr = nullptr;
-    other._using_buffer = true;
-  }
-  _size = other._size;
-  other._size = 0;
-  other._buf[0] = '\0';
+  // takes over the heap block, if any, with its resource
+  std::memcpy(_buf, other._buf, sizeof(_buf));
+  other.preallocate();
 }
 
 ustring::ustring(view other)
 {
-  if (other.size() <= default_size) {
-    _using_buffer = true;
-    _capacity = default_size;
-  }
-  else {
-    _using_buffer = false;
-    _capacity = other.size();
-    _ptr = new value_type[_capacity];
-  }
+  preallocate(other.size());
+  std::memmove(data(), other.data(), other.size());
+}
+
+ustring::ustring(std::pmr::memory_resource *resource)
+{
+  preallocate(0, resource);
+}
+
+ustring::ustring(view other, std::pmr::memory_resource *resource)
+{
+  preallocate(other.size(), resource);
   std::memmove(data(), other.data(), other.size());
-  _size = other.size();
+}
+
+ustring::ustring(const char *s, std::pmr::memory_resource *resource)
+    : ustring(view(reinterpret_cast<const value_type *>(s), static_cast<size_type>(std::strlen(s))),
+              resource)
+{
+}
+
+ustring::ustring(const char8_t *s, std::pmr::memory_resource *resource)
+    : ustring(reinterpret_cast<const char *>(s), resource)
+{
 }
 
 ustring::~ustring()
 {
-  if (!is_using_buffer()) {
-    delete[] _ptr;
-  }
+  release();
 }
 
 ustring &ustring::operator=(const char8_t *other)
 {
-  _size = strlen((const char *)other);
-  preallocate(_size);
-  std::memmove(data(), other, _size);
-  return *this;
+  return assign(other, static_cast<size_type>(strlen((const char *)other)));
 }
 
 ustring &ustring::operator=(const ustring &other)
 {
-  _using_buffer = other._using_buffer;
-  _capacity = other._capacity;
-  if (!is_using_buffer()) {
-    _ptr = new value_type[_capacity + 1];
+  if (this == &other) {
+    return *this;
   }
-  std::memcpy(data(), other.data(), other.size());
-  _size = other._size;
-
-  return *this;
+  if (is_using_buffer() && other.is_using_buffer()) {
+    std::memcpy(_buf, other._buf, sizeof(_buf));
+    return *this;
+  }
+  return assign(other.data(), other.size());
 }
 
 ustring &ustring::operator=(ustring &&other)
 {
-  _using_buffer = other._using_buffer;
-  _capacity = other._capacity;
-  other._capacity = default_size;
-  if (is_using_buffer()) {
-    std::memmove(data(), other.data(), other.size());
+  if (this == &other) {
+    return *this;
   }
-  else {
-    _ptr = other._ptr;
-    other._ptr = nullptr;
-    other._using_buffer = true;
+  std::pmr::memory_resource *r = resource();
+  if (r != other.resource()) {
+    return assign(other.data(), other.size());
   }
-  _size = other._size;
-  other._size = 0;
-  other._buf[0] = '\0';
-
+  release();
+  std::memcpy(_buf, other._buf, sizeof(_buf));
+  other.preallocate();
   return *this;
 }
 
@@ -454,22 +1015,15 @@ ustring::ustring(const char *s, size_t length, bool validate)
     preallocate();
     return;
   }
-  _size = length;
 
-  // Validate and measure UTF-8
-  if (validate) {
-    int32_t length = 0;
-    UErrorCode status = U_ZERO_ERROR;
-    u_strFromUTF8(nullptr, 0, &length, s, -1, &status);
-    if (status != U_BUFFER_OVERFLOW_ERROR && U_FAILURE(status)) {
-      preallocate(0);
-      return;
-    }
+  // Validate UTF-8
+  if (validate && validate_utf8({reinterpret_cast<const char8_t *>(s), length}) != npos) {
+    preallocate(0);
+    return;
   }
 
-  // Get actual UTF-8 length
-  preallocate(_size);
-  std::memcpy(data(), s, _size);
+  preallocate(static_cast<size_type>(length));
+  std::memcpy(data(), s, length);
 }
 
 // Constructor from char8_t*
@@ -521,34 +1075,15 @@ ustring::ustring(const wchar_t *s, size_t length, bool validate)
     return;
   }
 
+  preallocate();
   if constexpr (sizeof(wchar_t) == 2) {
     // Windows: wchar_t is UTF-16
-    // Get required UTF-8 length
-    int32_t utf8Length;
-    {
-      UErrorCode status;
-      u_strToUTF8(nullptr, 0, &utf8Length, reinterpret_cast<const UChar *>(s), length, &status);
-      preallocate(utf8Length);
-    }
-
-    {
-      // Convert to UTF-8
-      UErrorCode status;
-      u_strToUTF8(reinterpret_cast<char *>(data()),
-                  _capacity,
-                  &utf8Length,
-                  reinterpret_cast<const UChar *>(s),
-                  length,
-                  &status);
-      if (U_FAILURE(status)) {
-        throw std::runtime_error("Failed to convert ustring to u16string");
-      }
-    }
+    from_utf16(reinterpret_cast<const char16_t *>(s), length);
   }
   else {
     // Unix-like: wchar_t is UTF-32
     // todo: on AIX is 2 bytes
-    *this = ustring(reinterpret_cast<const char32_t *>(s), length);
+    from_utf32(reinterpret_cast<const char32_t *>(s), length);
   }
 }
 
@@ -568,8 +1103,8 @@ ustring::ustring(std::wstring_view s) : ustring(s.data(), s.length()) {}
 
 ustring::ustring(size_type n, const char8_t *base_str)
 {
-  _size = strlen((const char *)base_str);
-  preallocate(_size * n);
+  preallocate();
+  reserve(static_cast<size_type>(strlen((const char *)base_str)) * n);
   for (size_type i = 0; i < n; ++i) {
     append(base_str);
   }
@@ -577,7 +1112,8 @@ ustring::ustring(size_type n, const char8_t *base_str)
 
 ustring::ustring(size_type n, const ustring &base_str)
 {
-  preallocate(base_str.size() * n);
+  preallocate();
+  reserve(base_str.size() * n);
   for (size_type i = 0; i < n; ++i) {
     append(base_str);
   }
@@ -589,44 +1125,42 @@ ustring &ustring::from_utf8(const char8_t *str, size_t size)
   return *this;
 }
 
+ustring::size_type ustring::validate_utf8(std::u8string_view str) noexcept
+{
+  const size_t offset = ustring_simd::validate_utf8(str.data(), str.size());
+  return offset == str.size() ? npos : static_cast<size_type>(offset);
+}
+
 ustring &ustring::from_utf16(const char16_t *str, size_t size)
 {
-  // Get required UTF-8 length
-  int32_t utf8Length = 0;
-  {
-    UErrorCode status = UErrorCode::U_ZERO_ERROR;
-    u_strToUTF8(nullptr, 0, &utf8Length, reinterpret_cast<const UChar *>(str), size, &status);
-    resize(utf8Length);
+  if (size == static_cast<size_t>(-1)) {
+    size = std::char_traits<char16_t>::length(str);
   }
-
-  {
-    // Convert to UTF-8
-    UErrorCode status = UErrorCode::U_ZERO_ERROR;
-    u_strToUTF8(reinterpret_cast<char *>(data()),
-                _capacity,
-                &utf8Length,
-                reinterpret_cast<const UChar *>(str),
-                size,
-                &status);
-    if (U_FAILURE(status)) {
-      throw std::runtime_error("Failed to convert ustring to u16string");
-    }
+  if (size > static_cast<size_t>(max_size()) / 3) {
+    throw std::length_error("ustring::from_utf16: length would exceed maximum");
+  }
+  clear();
+  reserve(static_cast<size_type>(size * 3));
+  const size_t length = ustring_simd::utf16_to_utf8(str, size, data());
+  if (length == ustring_simd::transcode_error) {
+    throw std::runtime_error("Failed to convert ustring to u16string");
   }
+  resize(static_cast<size_type>(length));
 
   return *this;
 }
 
 ustring &ustring::from_utf32(const char32_t *str, size_t size)
 {
-  std::string result;
-  result.reserve(size * 4);
-  for (size_t i = 0; i < size; ++i) {
-    char32_t ch = str[i];
-    result += to_utf8(str[i]);
+  if (size == static_cast<size_t>(-1)) {
+    size = std::char_traits<char32_t>::length(str);
   }
-
-  resize(result.size());
-  std::memcpy(data(), result.c_str(), result.size() + 1);
+  if (size > static_cast<size_t>(max_size()) / 4) {
+    throw std::length_error("ustring::from_utf32: length would exceed maximum");
+  }
+  clear();
+  reserve(static_cast<size_type>(size * 4));
+  resize(static_cast<size_type>(ustring_simd::utf32_to_utf8(str, size, data())));
 
   return *this;
 }
@@ -670,20 +1204,15 @@ std::u8string_view ustring::view::to_u8string_view() const &
 
 std::u16string ustring::view::to_u16string() const
 {
+  // the operation must not throw, so a failure is only reported once it has returned
+  bool failed = false;
   std::u16string result;
-  int32_t length;
-  UErrorCode status = U_ZERO_ERROR;
-  u_strFromUTF8(nullptr, 0, &length, reinterpret_cast<const char *>(data()), _size, &status);
-
-  status = U_ZERO_ERROR;
-  result.resize(length);
-  u_strFromUTF8(&result[0],
-                result.capacity(),
-                nullptr,
-                reinterpret_cast<const char *>(data()),
-                _size,
-                &status);
-  if (U_FAILURE(status)) {
+  result.resize_and_overwrite(_size, [this, &failed](char16_t *buf, size_t) {
+    const size_t length = ustring_simd::utf8_to_utf16(data(), _size, buf);
+    failed = length == ustring_simd::transcode_error;
+    return failed ? 0 : length;
+  });
+  if (failed) {
     throw std::runtime_error("Failed to convert ustring to u16string");
   }
   return result;
@@ -691,63 +1220,36 @@ std::u16string ustring::view::to_u16string() const
 
 std::u32string ustring_view::view::to_u32string() const
 {
+  bool failed = false;
   std::u32string result;
-
-  const_iterator it = data();
-  int32_t offset = 0, len = size();
-  UChar32 codePoint;
-
-  result.reserve(length());
-
-  while (offset < len) {
-    U8_NEXT(it, offset, len, codePoint);
-    if (codePoint < 0) {
-      throw std::runtime_error("Failed to convert ustring to u32string");
-    }
-    result.push_back(codePoint);
+  result.resize_and_overwrite(size(), [this, &failed](char32_t *buf, size_t) {
+    const size_t length = ustring_simd::utf8_to_utf32(data(), size(), buf);
+    failed = length == ustring_simd::transcode_error;
+    return failed ? 0 : length;
+  });
+  if (failed) {
+    throw std::runtime_error("Failed to convert ustring to u32string");
   }
-
   return result;
 }
 
 std::wstring ustring::view::to_wstring() const
 {
+  bool failed = false;
   std::wstring result;
-  if constexpr (sizeof(wchar_t) == 2) {
-    int32_t length;
-    UErrorCode status = U_ZERO_ERROR;
-    u_strFromUTF8(nullptr, 0, &length, reinterpret_cast<const char *>(data()), _size, &status);
-    if (U_FAILURE(status)) {
-      throw std::runtime_error("Failed to convert ustring to u16string");
-    }
-
-    status = U_ZERO_ERROR;
-    result.resize(length);
-    u_strFromUTF8((UChar *)&result[0],
-                  result.capacity(),
-                  nullptr,
-                  reinterpret_cast<const char *>(data()),
-                  _size,
-                  &status);
-    if (U_FAILURE(status)) {
-      throw std::runtime_error("Failed to convert ustring to u16string");
+  result.resize_and_overwrite(_size, [this, &failed](wchar_t *buf, size_t) {
+    size_t length;
+    if constexpr (sizeof(wchar_t) == 2) {
+      length = ustring_simd::utf8_to_utf16(data(), _size, reinterpret_cast<char16_t *>(buf));
     }
-  }
-  else if constexpr (sizeof(wchar_t) == 4) {
-    const_iterator it = data();
-    int32_t offset = 0, len = size();
-    UChar32 codePoint;
-
-    while (offset < len) {
-      U8_NEXT(it, offset, len, codePoint);
-      if (codePoint < 0) {
-        throw std::runtime_error("Failed to convert ustring to u32string");
-      }
-      result.push_back(codePoint);
+    else {
+      length = ustring_simd::utf8_to_utf32(data(), _size, reinterpret_cast<char32_t *>(buf));
     }
-  }
-  else {
-    assert(false);
+    failed = length == ustring_simd::transcode_error;
+    return failed ? 0 : length;
+  });
+  if (failed) {
+    throw std::runtime_error("Failed to convert ustring to wstring");
   }
   return result;
 }
@@ -821,17 +1323,17 @@ ustring::const_iterator ustring::cbegin() const noexcept
 
 ustring::iterator ustring::end() noexcept
 {
-  return data() + _size;
+  return data() + size();
 }
 
 ustring::const_iterator ustring::end() const noexcept
 {
-  return data() + _size;
+  return data() + size();
 }
 
 ustring::const_iterator ustring::cend() const noexcept
 {
-  return data() + _size;
+  return data() + size();
 }
 
 ustring::reverse_iterator ustring::rbegin() noexcept
@@ -867,12 +1369,12 @@ ustring::const_reverse_iterator ustring::crend() const noexcept
 //  Capacity functions
 bool ustring::empty() const noexcept
 {
-  return _size == 0;
+  return size() == 0;
 }
 
 ustring::size_type ustring::size() const noexcept
 {
-  return _size;
+  return is_using_buffer() ? default_size - tag() : _heap_size;
 }
 
 ustring::size_type ustring::view::length() const noexcept
@@ -880,31 +1382,155 @@ ustring::size_type ustring::view::length() const noexcept
   if (!_data) {
     return 0;
   }
+  // every byte that is not a continuation byte starts a code point
+  return static_cast<size_type>(ustring_simd::count_code_points(data(), size()));
+}
+
+ustring::size_type ustring::length() const noexcept
+{
+  // short strings have nowhere to cache the count, and it is cheap for them anyway
+  if (is_using_buffer()) {
+    return to_view().length();
+  }
+  // const callers may share the string between threads, so the cache is filled atomically;
+  // racing threads compute the same count
+  std::atomic_ref cached(_length);
+  size_type length = cached.load(std::memory_order_relaxed);
+  if (length == npos) {
+    length = to_view().length();
+    cached.store(length, std::memory_order_relaxed);
+  }
+  return length;
+}
 
-  int32_t offset = 0;
-  int32_t length = static_cast<int32_t>(size());
-  UChar32 codepoint;
-  size_type count = 0;
+namespace {
 
-  while (offset < length) {
-    U8_NEXT(data(), offset, length, codepoint);
+// Feeds ICU's output straight into a hasher, so the folded string is never built
+class hashing_sink : public icu::ByteSink {
+ public:
+  explicit hashing_sink(ustring::hasher &hasher) : _hasher(hasher) {}
 
-    if (codepoint < 0) {
-      continue;
+  void Append(const char *bytes, int32_t n) override
+  {
+    _hasher.update(ustring::view(reinterpret_cast<const char8_t *>(bytes), n));
+  }
+
+ private:
+  ustring::hasher &_hasher;
+};
+
+const icu::Normalizer2 *casefold_normalizer()
+{
+  UErrorCode status = U_ZERO_ERROR;
+  const icu::Normalizer2 *normalizer = icu::Normalizer2::getNFKCCasefoldInstance(status);
+  return U_SUCCESS(status) ? normalizer : nullptr;
+}
+
+FORCEINLINE char8_t ascii_lower(char8_t c)
+{
+  return c >= u8'A' && c <= u8'Z' ? c + (u8'a' - u8'A') : c;
+}
+
+}  // namespace
+
+ustring::hasher::hasher(uint64_t seed) noexcept
+{
+  ustring_simd::hash_init(_state, seed);
+}
+
+ustring::hasher &ustring::hasher::update(const view &piece) noexcept
+{
+  ustring_simd::hash_update(_state, piece.data(), piece.size());
+  return *this;
+}
+
+uint64_t ustring::hasher::digest() const noexcept
+{
+  return ustring_simd::hash_digest(_state);
+}
+
+uint64_t ustring::view::hash64(uint64_t seed) const noexcept
+{
+  return ustring_simd::hash(data(), size(), seed);
+}
+
+uint64_t ustring::hash64(uint64_t seed) const noexcept
+{
+  return to_view().hash64(seed);
+}
+
+uint64_t ustring::view::hash64_folded(uint64_t seed) const
+{
+  // NFKC_Casefold only lower-cases ASCII, so ASCII text is folded here a block at a time
+  hasher ascii(seed);
+  value_type block[64];
+  size_type i = 0;
+  for (; i < size(); i += sizeof(block)) {
+    const size_type n = std::min<size_type>(sizeof(block), size() - i);
+    std::memcpy(block, _data + i, n);
+    if (ustring_simd::ascii_to_lower(block, n) != static_cast<size_t>(n)) {
+      break;
     }
-    count++;
+    ascii.update(view(block, n));
   }
-  return count;
+  if (i >= size()) {
+    return ascii.digest();
+  }
+
+  const icu::Normalizer2 *normalizer = casefold_normalizer();
+  hasher folded(seed);
+  hashing_sink sink(folded);
+  UErrorCode status = U_ZERO_ERROR;
+  if (normalizer) {
+    const icu::StringPiece input(reinterpret_cast<const char *>(data()), size());
+    normalizer->normalizeUTF8(0, input, sink, nullptr, status);
+  }
+  return normalizer && U_SUCCESS(status) ? folded.digest() : hash64(seed);
 }
 
-ustring::size_type ustring::length() const noexcept
+uint64_t ustring::hash64_folded(uint64_t seed) const
 {
-  return to_view().length();
+  return to_view().hash64_folded(seed);
+}
+
+bool ustring::view::equals_folded(const view &other) const
+{
+  if (size() == other.size() && std::memcmp(data(), other.data(), size()) == 0) {
+    return true;
+  }
+
+  auto is_ascii = [](const view &str) {
+    return std::all_of(str.begin(), str.end(), [](char8_t c) { return c < 0x80; });
+  };
+  if (is_ascii(*this) && is_ascii(other)) {
+    return size() == other.size() &&
+           std::equal(begin(), end(), other.begin(), [](char8_t a, char8_t b) {
+             return ascii_lower(a) == ascii_lower(b);
+           });
+  }
+
+  const icu::Normalizer2 *normalizer = casefold_normalizer();
+  auto fold = [normalizer](const view &str) {
+    const icu::StringPiece input(reinterpret_cast<const char *>(str.data()), str.size());
+    std::string result;
+    icu::StringByteSink<std::string> sink(&result);
+    UErrorCode status = U_ZERO_ERROR;
+    if (normalizer) {
+      normalizer->normalizeUTF8(0, input, sink, nullptr, status);
+    }
+    return normalizer && U_SUCCESS(status) ? result : std::string(input.data(), input.size());
+  };
+  return fold(*this) == fold(other);
+}
+
+bool ustring::equals_folded(const view &other) const
+{
+  return to_view().equals_folded(other);
 }
 
 ustring::size_type ustring::capacity() const noexcept
 {
-  return _capacity;
+  return is_using_buffer() ? default_size : _capacity;
 }
 
 void ustring::reserve(size_type new_cap)
@@ -916,43 +1542,42 @@ void ustring::reserve(size_type new_cap)
 #endif
 
   if (new_cap > capacity()) {
-    value_type *new_data = nullptr;
-    new_data = new value_type[new_cap];
-    std::copy_n(data(), _size, new_data);
-
-    if (!is_using_buffer()) {
-      delete[] _ptr;
-    }
-
-    _ptr = new_data;
-    _capacity = new_cap;
-    _using_buffer = false;
+    std::pmr::memory_resource *r = resource();
+    value_type *new_data = allocate(new_cap, r);
+    const size_type n = size();
+    std::copy_n(data(), n, new_data);
+    release();
+    set_heap(new_data, n, new_cap, r);
   }
 }
 
 void ustring::shrink_to_fit()
 {
-  if (!is_using_buffer() && _size <= default_size) {
+  if (is_using_buffer()) {
+    return;
+  }
+
+  const size_type n = size();
+  std::pmr::memory_resource *r = resource();
+  if (n <= default_size && !r) {
     // Can switch back to using buffer
-    auto old_ptr = _ptr;
-    std::copy_n(_ptr, _size, _buf);
+    value_type *old_ptr = _ptr;
+    std::copy_n(old_ptr, n, _buf);
+    _buf[default_size] = static_cast<value_type>(default_size - n);
     delete[] old_ptr;
-    _using_buffer = true;
-    _capacity = default_size;
   }
-  else if (!is_using_buffer() && _size < capacity()) {
+  else if (n < capacity()) {
     // Reallocate to exact size
-    value_type *new_data = new value_type[_size];
-    std::copy_n(_ptr, _size, new_data);
-    delete[] _ptr;
-    _ptr = new_data;
-    _capacity = _size;
+    value_type *new_data = allocate(n, r);
+    std::copy_n(_ptr, n, new_data);
+    release();
+    set_heap(new_data, n, n, r);
   }
 }
 
 void ustring::clear() noexcept
 {
-  _size = 0;
+  set_size(0);
 }
 
 // Element access with conditional exception handling
@@ -983,7 +1608,7 @@ ustring::reference ustring::back()
     throw std::out_of_range("ustring::back: string is empty");
   }
 #endif
-  return data()[_size - 1];
+  return data()[size() - 1];
 }
 
 ustring::const_reference ustring::back() const
@@ -993,7 +1618,7 @@ ustring::const_reference ustring::back() const
     throw std::out_of_range("ustring::back: string is empty");
   }
 #endif
-  return data()[_size - 1];
+  return data()[size() - 1];
 }
 
 ustring::reference ustring::operator[](size_type pos)
@@ -1014,7 +1639,7 @@ std::span<ustring::value_type> ustring::span() noexcept
 ustring::reference ustring::at(size_type pos)
 {
 #ifdef _DEBUG
-  if (pos >= _size) {
+  if (pos >= size()) {
     throw std::out_of_range("ustring::at: position out of range");
   }
 #endif
@@ -1024,7 +1649,7 @@ ustring::reference ustring::at(size_type pos)
 ustring::const_reference ustring::at(size_type pos) const
 {
 #ifdef _DEBUG
-  if (pos >= _size) {
+  if (pos >= size()) {
     throw std::out_of_range("ustring::at: position out of range");
   }
 #endif
@@ -1033,7 +1658,12 @@ ustring::const_reference ustring::at(size_type pos) const
 
 ustring::pointer ustring::data() noexcept
 {
-  return is_using_buffer() ? _buf : _ptr;
+  // the caller may write through the pointer
+  if (!is_using_buffer()) {
+    _length = npos;
+    return _ptr;
+  }
+  return _buf;
 }
 
 ustring::const_pointer ustring::data() const noexcept
@@ -1045,7 +1675,7 @@ ustring::const_pointer ustring::data() const noexcept
 ustring &ustring::append(const ustring &str)
 {
 #ifdef _DEBUG
-  if (max_size() - _size < str.size()) {
+  if (max_size() - size() < str.size()) {
     throw std::length_error("ustring::append: length would exceed maximum");
   }
 #endif
@@ -1077,25 +1707,31 @@ ustring &ustring::append(const value_type *s, size_type n)
     return *this;
 
 #ifdef _DEBUG
-  if (max_size() - _size < n) {
+  if (max_size() - size() < n) {
     throw std::length_error("ustring::append: length would exceed maximum");
   }
 #endif
 
-  size_type new_size = _size + n;
+  size_type new_size = size() + n;
   if (new_size > capacity()) {
-    reserve(std::max(new_size, capacity() * 2));
+    // s may point into our own buffer, which reserve() frees
+    const value_type *old = data();
+    const bool aliased = s >= old && s < old + size();
+    reserve(next_capacity(new_size));
+    if (aliased) {
+      s = data() + (s - old);
+    }
   }
 
-  std::copy_n(s, n, data() + _size);
-  _size = new_size;
+  std::copy_n(s, n, data() + size());
+  set_size(new_size);
   return *this;
 }
 
 ustring &ustring::append(size_type n, value_type c)
 {
 #ifdef _DEBUG
-  if (max_size() - _size < n) {
+  if (max_size() - size() < n) {
     throw std::length_error("ustring::append: length would exceed maximum");
   }
 #endif
@@ -1103,13 +1739,13 @@ ustring &ustring::append(size_type n, value_type c)
   if (n == 0)
     return *this;
 
-  size_type new_size = _size + n;
+  size_type new_size = size() + n;
   if (new_size > capacity()) {
-    reserve(std::max(new_size, capacity() * 2));
+    reserve(next_capacity(new_size));
   }
 
-  std::fill_n(data() + _size, n, c);
-  _size = new_size;
+  std::fill_n(data() + size(), n, c);
+  set_size(new_size);
   return *this;
 }
 
@@ -1136,23 +1772,24 @@ ustring &ustring::assign(const value_type *s, size_type n)
     return *this;
   }
 
-  if (is_using_buffer() && n <= default_size) {
-    std::memcpy(data(), s, n * sizeof(value_type));
-    _size = n;
-    // #ifdef _DEBUG
-    //     if (n < default_size) {
-    //       data()[n] = '\0';
-    //     }
-    // #endif
+  // s may point into this string, e.g. when keeping only a part of it
+  if (s >= data() && s < data() + size()) {
+    std::memmove(data(), s, n * sizeof(value_type));
+    set_size(n);
     return *this;
   }
 
-  _using_buffer = false;
-  _size = n;
-  clear();
-  reserve(n);
-  append(s, n);
+  if (n > capacity()) {
+    std::pmr::memory_resource *r = resource();
+    value_type *new_data = allocate(n, r);
+    std::memcpy(new_data, s, n * sizeof(value_type));
+    release();
+    set_heap(new_data, n, n, r);
+    return *this;
+  }
 
+  std::memcpy(data(), s, n * sizeof(value_type));
+  set_size(n);
   return *this;
 }
 
@@ -1183,18 +1820,20 @@ ustring &ustring::operator+=(char s)
 void ustring::push_back(value_type ch)
 {
 #ifdef _DEBUG
-  if (_size == max_size()) {
+  if (size() == max_size()) {
     throw std::length_error("ustring::push_back: length exceeds maximum");
   }
-  if (_size > capacity()) {
+  if (size() > capacity()) {
     throw std::length_error("ustring::push_back: bad size");
   }
 #endif
 
-  if (_size == capacity()) {
-    reserve(capacity() * 3 / 2);
+  const size_type n = size();
+  if (n == capacity()) {
+    reserve(next_capacity(n + 1));
   }
-  data()[_size++] = ch;
+  data()[n] = ch;
+  set_size(n + 1);
 }
 
 void ustring::pop_back()
@@ -1205,25 +1844,25 @@ void ustring::pop_back()
   }
 #endif
   if (!empty()) {
-    --_size;
+    set_size(size() - 1);
   }
 }
 
 ustring &ustring::insert(size_type pos, const ustring &str)
 {
 #ifdef _DEBUG
-  if (pos > _size) {
+  if (pos > size()) {
     throw std::out_of_range("ustring::insert: position out of range");
   }
 #endif
 
 #ifdef _DEBUG
-  if (max_size() - _size < str.size()) {
+  if (max_size() - size() < str.size()) {
     throw std::length_error("ustring::insert: length would exceed maximum");
   }
 #endif
 
-  if (pos <= _size) {
+  if (pos <= size()) {
     return insert(pos, str.data(), str.size());
   }
   return *this;
@@ -1258,24 +1897,24 @@ ustring::iterator ustring::insert(const_iterator pos, value_type c)
 {
   size_type offset = pos - begin();
 #ifdef _DEBUG
-  if (offset > _size) {
+  if (offset > size()) {
     throw std::out_of_range("ustring::insert: iterator out of range");
   }
 #endif
-  if (offset <= _size) {
+  if (offset <= size()) {
     insert(offset, 1, c);
     return begin() + offset;
   }
-  return begin() + _size;
+  return begin() + size();
 }
 
 ustring &ustring::insert(size_type pos, size_type n, value_type c)
 {
 #ifdef _DEBUG
-  if (pos > _size) {
+  if (pos > size()) {
     throw std::out_of_range("ustring::insert: position out of range");
   }
-  if (max_size() - _size < n) {
+  if (max_size() - size() < n) {
     throw std::length_error("ustring::insert: length would exceed maximum");
   }
 #endif
@@ -1284,17 +1923,17 @@ ustring &ustring::insert(size_type pos, size_type n, value_type c)
     return *this;
   }
 
-  size_type new_size = _size + n;
+  size_type new_size = size() + n;
   if (new_size > capacity()) {
-    reserve(std::max(new_size, capacity() * 2));
+    reserve(next_capacity(new_size));
   }
 
-  if (pos < _size) {
-    std::copy_backward(data() + pos, data() + _size, data() + new_size);
+  if (pos < size()) {
+    std::copy_backward(data() + pos, data() + size(), data() + new_size);
   }
 
   std::fill_n(data() + pos, n, c);
-  _size = new_size;
+  set_size(new_size);
 
   return *this;
 }
@@ -1306,7 +1945,7 @@ ustring::iterator ustring::insert(const_iterator pos, size_type n, value_type c)
 
   size_type offset = pos - cbegin();
 #ifdef _DEBUG
-  if (offset > _size) {
+  if (offset > size()) {
     throw std::out_of_range("insert position out of range");
   }
 #endif
@@ -1318,7 +1957,7 @@ ustring::iterator ustring::insert(const_iterator pos, size_type n, value_type c)
 ustring &ustring::insert(size_type pos, const value_type *s, size_type n)
 {
 #ifdef _DEBUG
-  if (pos > _size) {
+  if (pos > size()) {
     throw std::out_of_range("insert position out of range");
   }
 #endif
@@ -1326,35 +1965,30 @@ ustring &ustring::insert(size_type pos, const value_type *s, size_type n)
     return *this;
 
   // Calculate new size and reserve space
-  size_type new_size = _size + n;
-  if (new_size > _capacity) {
-    size_type new_capacity = std::max(new_size, _capacity * 2);
-    value_type *new_data = new value_type[new_capacity + 1];
+  size_type new_size = size() + n;
+  if (new_size > capacity()) {
+    size_type new_capacity = next_capacity(new_size);
+    std::pmr::memory_resource *r = resource();
+    value_type *new_data = allocate(new_capacity, r);
 
     // Copy data before pos
     std::copy(data(), data() + pos, new_data);
     // Copy new data
     std::copy(s, s + n, new_data + pos);
     // Copy data after pos
-    std::copy(data() + pos, data() + _size, new_data + pos + n);
+    std::copy(data() + pos, data() + size(), new_data + pos + n);
 
-    // new_data[new_size] = '\0';
-
-    if (!is_using_buffer()) {
-      delete[] _ptr;
-    }
-    _ptr = new_data;
-    _using_buffer = false;
-    _capacity = new_capacity;
+    release();
+    set_heap(new_data, size(), new_capacity, r);
   }
   else {
     // Shift existing data
-    std::copy_backward(data() + pos, data() + _size, data() + new_size);
+    std::copy_backward(data() + pos, data() + size(), data() + new_size);
     // Insert new data
     std::copy(s, s + n, data() + pos);
   }
 
-  _size = new_size;
+  set_size(new_size);
   return *this;
 }
 
@@ -1367,7 +2001,7 @@ ustring::iterator ustring::erase(const_iterator first, const_iterator last)
 {
   size_type pos = first - cbegin(), len = last - first;
 #ifdef _DEBUG
-  if (pos > _size || pos + len > _size) {
+  if (pos > size() || pos + len > size()) {
     throw std::out_of_range("erase range out of range");
   }
 #endif
@@ -1376,8 +2010,8 @@ ustring::iterator ustring::erase(const_iterator first, const_iterator last)
     return first;
 
   // Move remaining characters
-  std::copy(data() + pos + len, data() + _size, data() + pos);
-  _size -= len;
+  std::copy(data() + pos + len, data() + size(), data() + pos);
+  set_size(size() - len);
   // data()[_size] = '\0';
 
   return begin() + pos;
@@ -1386,19 +2020,19 @@ ustring::iterator ustring::erase(const_iterator first, const_iterator last)
 ustring &ustring::erase(size_type pos, size_type n)
 {
 #ifdef _DEBUG
-  if (pos > _size) {
+  if (pos > size()) {
     throw std::out_of_range("ustring::erase: position out of range");
   }
 #endif
 
-  if (pos < _size) {
-    if (n == npos || pos + n > _size) {
-      n = _size - pos;
+  if (pos < size()) {
+    if (n == npos || pos + n > size()) {
+      n = size() - pos;
     }
 
     if (n > 0) {
-      std::copy(data() + pos + n, data() + _size, data() + pos);
-      _size -= n;
+      std::copy(data() + pos + n, data() + size(), data() + pos);
+      set_size(size() - n);
     }
   }
 
@@ -1414,10 +2048,10 @@ void ustring::resize(size_type n)
 #endif
 
   if (n > capacity()) {
-    reserve(n);
+    reserve(next_capacity(n));
   }
 
-  _size = n;
+  set_size(n);
 }
 
 void ustring::resize(size_type n, value_type c)
@@ -1428,56 +2062,33 @@ void ustring::resize(size_type n, value_type c)
   }
 #endif
 
-  if (n > _size) {
+  if (n > size()) {
     // Need to grow and fill new elements with c
     if (n > capacity()) {
-      reserve(n);
+      reserve(next_capacity(n));
     }
-    std::fill_n(data() + _size, n - _size, c);
+    std::fill_n(data() + size(), n - size(), c);
   }
-  _size = n;
+  set_size(n);
 }
 
-void ustring::swap(ustring &other) noexcept
+void ustring::swap(ustring &other)
 {
-  if (is_using_buffer() && other.is_using_buffer()) {
-    // Both using buffer, swap buffers
-    std::swap_ranges(_buf, _buf + default_size, other._buf);
-  }
-  else if (!is_using_buffer() && !other.is_using_buffer()) {
-    // Both using heap, swap pointers
-    std::swap(_ptr, other._ptr);
-  }
-  else {
-    // One buffer, one heap - need to do a full swap
-    value_type temp_buf[default_size];
-    if (is_using_buffer()) {
-      // this is buffer, other is heap
-      std::copy_n(_buf, default_size, temp_buf);
-      _ptr = other._ptr;
-      std::copy_n(temp_buf, default_size, other._buf);
-    }
-    else {
-      // this is heap, other is buffer
-      std::copy_n(other._buf, default_size, temp_buf);
-      other._ptr = _ptr;
-      std::copy_n(temp_buf, default_size, _buf);
-    }
+  if (resource() != other.resource()) {
+    // each string keeps its resource, so the contents are copied into each one's resource
+    // first; if that throws, neither string has changed
+    ustring mine(other.to_view(), resource());
+    ustring theirs(to_view(), other.resource());
+    swap(mine);
+    other.swap(theirs);
+    return;
   }
 
-  // Swap metadata using temporary variables since we can't swap bit fields
-  // directly
-  bool temp_using_buffer = _using_buffer;
-  size_type temp_capacity = _capacity;
-  size_type temp_size = _size;
-
-  _using_buffer = other._using_buffer;
-  _capacity = other._capacity;
-  _size = other._size;
-
-  other._using_buffer = temp_using_buffer;
-  other._capacity = temp_capacity;
-  other._size = temp_size;
+  // either layout is just bytes, so swapping them swaps the strings
+  value_type temp[sizeof(_buf)];
+  std::memcpy(temp, _buf, sizeof(_buf));
+  std::memcpy(_buf, other._buf, sizeof(_buf));
+  std::memcpy(other._buf, temp, sizeof(_buf));
 }
 
 ustring ustring::copy() const
@@ -1487,10 +2098,10 @@ ustring ustring::copy() const
 
 ustring::size_type ustring::copy(value_type *dest, size_type n, size_type pos) const
 {
-  if (pos >= _size)
+  if (pos >= size())
     return 0;
 
-  const size_type len = std::min(n == npos ? max_pos : n, _size - pos);
+  const size_type len = std::min(n == npos ? max_pos : n, size() - pos);
   std::copy_n(data() + pos, len, dest);
   return len;
 }
@@ -1516,42 +2127,12 @@ ustring ustring::view::substr(size_type pos, size_type n) const
 
 ustring ustring::substr(size_type pos, size_type n) const
 {
-  return to_view().substr(pos, n);
+  return ustring(substr_view(pos, n), resource());
 }
 
 ustring::size_type ustring::view::find(const ustring &str, size_type pos) const noexcept
 {
-  if (pos >= _size || str._size > _size - pos)
-    return npos;
-  if (str.empty())
-    return pos;
-
-  // Simple implementation of Boyer-Moore-Horspool algorithm
-  const value_type *const pat = str.data();
-  const size_type pat_len = str._size;
-  const value_type *const text = data();
-  const size_type text_len = _size;
-
-  // Build bad character table
-  size_type skip[256];
-  for (size_type i = 0; i < 256; i++)
-    skip[i] = pat_len;
-  for (size_type i = 0; i < pat_len - 1; i++) {
-    skip[static_cast<unsigned char>(pat[i])] = pat_len - 1 - i;
-  }
-
-  // Search
-  size_type i = pos;
-  while (i <= text_len - pat_len) {
-    size_type j = pat_len - 1;
-    while (j != npos && pat[j] == text[i + j])
-      --j;
-    if (j == npos)
-      return i;
-    i += skip[static_cast<unsigned char>(text[i + pat_len - 1])];
-  }
-
-  return npos;
+  return find(str.data(), pos, str.size());
 }
 
 ustring::size_type ustring::find(const ustring &str, size_type pos) const noexcept
@@ -1559,11 +2140,25 @@ ustring::size_type ustring::find(const ustring &str, size_type pos) const noexce
   return to_view().find(str, pos);
 }
 
+ustring::size_type ustring::view::find(const searcher &s, size_type pos) const noexcept
+{
+  return s.find(*this, pos);
+}
+
+ustring::size_type ustring::find(const searcher &s, size_type pos) const noexcept
+{
+  return s.find(to_view(), pos);
+}
+
 ustring::size_type ustring::view::find(const value_type *s, size_type pos, size_type n) const
 {
-  if (!s || pos >= _size)
+  if (!s || pos >= _size || n > _size - pos)
     return npos;
-  return find(ustring(s, n), pos);
+  if (n == 0)
+    return pos;
+
+  const size_t offset = ustring_simd::find(data() + pos, _size - pos, s, n);
+  return offset == ustring_simd::not_found ? npos : pos + static_cast<size_type>(offset);
 }
 
 ustring::size_type ustring::find(const value_type *s, size_type pos, size_type n) const
@@ -1588,14 +2183,8 @@ ustring::size_type ustring::view::find(value_type c, size_type pos) const noexce
   if (pos >= _size)
     return npos;
 
-  const value_type *p = data() + pos;
-  const value_type *const end = data() + _size;
-  while (p != end) {
-    if (*p == c)
-      return p - data();
-    ++p;
-  }
-  return npos;
+  const void *p = std::memchr(data() + pos, c, _size - pos);
+  return p ? static_cast<size_type>(static_cast<const value_type *>(p) - data()) : npos;
 }
 
 ustring::size_type ustring::find(value_type c, size_type pos) const noexcept
@@ -1605,19 +2194,7 @@ ustring::size_type ustring::find(value_type c, size_type pos) const noexcept
 
 ustring::size_type ustring::view::rfind(const ustring &str, size_type pos) const noexcept
 {
-  if (str.empty())
-    return std::min(pos == npos ? max_pos : pos, _size);
-  if (str._size > _size)
-    return npos;
-
-  pos = std::min(pos == npos ? max_pos : pos, _size - str._size);
-  const value_type *const data_ptr = data();
-  for (auto i = pos + 1; i-- > 0;) {
-    if (std::equal(str.data(), str.data() + str._size, data_ptr + i)) {
-      return i;
-    }
-  }
-  return npos;
+  return rfind(str.data(), pos, str.size());
 }
 
 ustring::size_type ustring::rfind(const ustring &str, size_type pos) const noexcept
@@ -1625,11 +2202,29 @@ ustring::size_type ustring::rfind(const ustring &str, size_type pos) const noexc
   return to_view().rfind(str, pos);
 }
 
+ustring::size_type ustring::view::rfind(const searcher &s, size_type pos) const noexcept
+{
+  return s.rfind(*this, pos);
+}
+
+ustring::size_type ustring::rfind(const searcher &s, size_type pos) const noexcept
+{
+  return s.rfind(to_view(), pos);
+}
+
 ustring::size_type ustring::view::rfind(const value_type *s, size_type pos, size_type n) const
 {
   if (!s)
     return npos;
-  return rfind(ustring(s, n), pos);
+  if (n == 0)
+    return std::min(pos == npos ? max_pos : pos, _size);
+  if (n > _size)
+    return npos;
+
+  // only matches starting at or before pos count
+  pos = std::min(pos == npos ? max_pos : pos, _size - n);
+  const size_t offset = ustring_simd::rfind(data(), pos + n, s, n);
+  return offset == ustring_simd::not_found ? npos : static_cast<size_type>(offset);
 }
 
 ustring::size_type ustring::rfind(const value_type *s, size_type pos, size_type n) const
@@ -1655,15 +2250,8 @@ ustring::size_type ustring::view::rfind(value_type c, size_type pos) const noexc
     return npos;
 
   pos = std::min(pos == npos ? max_pos : pos, _size - 1);
-  const value_type *p = data() + pos;
-  while (true) {
-    if (*p == c)
-      return p - data();
-    if (p == data())
-      break;
-    --p;
-  }
-  return npos;
+  const size_t offset = ustring_simd::rfind(data(), pos + 1, &c, 1);
+  return offset == ustring_simd::not_found ? npos : static_cast<size_type>(offset);
 }
 
 ustring::size_type ustring::rfind(value_type c, size_type pos) const noexcept
@@ -1671,24 +2259,54 @@ ustring::size_type ustring::rfind(value_type c, size_type pos) const noexcept
   return to_view().rfind(c, pos);
 }
 
-ustring::size_type ustring::view::find_first_of(const ustring &str, size_type pos) const noexcept
+ustring::searcher::searcher(const view &needle)
+    : _needle(needle.data(), needle.size()),
+      _plan(ustring_simd::make_needle_plan(_needle.data(), _needle.size()))
+{
+}
+
+ustring::searcher::searcher(const ustring &needle) : searcher(needle.to_view()) {}
+
+ustring::size_type ustring::searcher::find(const view &text, size_type pos) const noexcept
 {
-  if (pos >= _size || str.empty())
+  const size_type n = size();
+  if (pos >= text.size() || n > text.size() - pos)
     return npos;
+  if (n == 0)
+    return pos;
 
-  const value_type *const chars = str.data();
-  const size_type chars_len = str._size;
-  const value_type *p = data() + pos;
-  const value_type *const end = data() + _size;
+  const size_t offset = ustring_simd::find(
+      text.data() + pos, text.size() - pos, _needle.data(), n, _plan);
+  return offset == ustring_simd::not_found ? npos : pos + static_cast<size_type>(offset);
+}
 
-  while (p != end) {
-    for (size_type i = 0; i < chars_len; ++i) {
-      if (*p == chars[i])
-        return p - data();
-    }
-    ++p;
+ustring::size_type ustring::searcher::rfind(const view &text, size_type pos) const noexcept
+{
+  const size_type n = size();
+  if (n == 0)
+    return std::min(pos == npos ? max_pos : pos, text.size());
+  if (n > text.size())
+    return npos;
+
+  pos = std::min(pos == npos ? max_pos : pos, text.size() - n);
+  const size_t offset = ustring_simd::rfind(text.data(), pos + n, _needle.data(), n, _plan);
+  return offset == ustring_simd::not_found ? npos : static_cast<size_type>(offset);
+}
+
+std::pair<const ustring::value_type *, const ustring::value_type *> ustring::searcher::operator()(
+    const value_type *first, const value_type *last) const noexcept
+{
+  const size_t offset = ustring_simd::find(
+      first, static_cast<size_t>(last - first), _needle.data(), _needle.size(), _plan);
+  if (offset == ustring_simd::not_found) {
+    return {last, last};
   }
-  return npos;
+  return {first + offset, first + offset + _needle.size()};
+}
+
+ustring::size_type ustring::view::find_first_of(const ustring &str, size_type pos) const noexcept
+{
+  return find_first_of(str.data(), pos, str.size());
 }
 
 ustring::size_type ustring::find_first_of(const ustring &str, size_type pos) const noexcept
@@ -1700,9 +2318,12 @@ ustring::size_type ustring::view::find_first_of(const value_type *s,
                                                 size_type pos,
                                                 size_type n) const
 {
-  if (!s || pos >= _size)
+  if (!s || pos >= _size || n == 0)
     return npos;
-  return find_first_of(ustring(s, n), pos);
+
+  const size_t offset = ustring_simd::find_first_of(
+      data() + pos, _size - pos, ustring_simd::byte_set(s, n));
+  return offset == ustring_simd::not_found ? npos : pos + static_cast<size_type>(offset);
 }
 
 ustring::size_type ustring::find_first_of(const value_type *s, size_type pos, size_type n) const
@@ -1734,24 +2355,7 @@ ustring::size_type ustring::find_first_of(value_type c, size_type pos) const noe
 
 ustring::size_type ustring::view::find_last_of(const ustring &str, size_type pos) const noexcept
 {
-  if (str.empty() || _size == 0)
-    return npos;
-
-  pos = std::min(pos == npos ? max_pos : pos, _size - 1);
-  const value_type *const chars = str.data();
-  const size_type chars_len = str._size;
-  const value_type *p = data() + pos;
-
-  while (true) {
-    for (size_type i = 0; i < chars_len; ++i) {
-      if (*p == chars[i])
-        return p - data();
-    }
-    if (p == data())
-      break;
-    --p;
-  }
-  return npos;
+  return find_last_of(str.data(), pos, str.size());
 }
 
 ustring::size_type ustring::find_last_of(const ustring &str, size_type pos) const noexcept
@@ -1763,9 +2367,12 @@ ustring::size_type ustring::view::find_last_of(const value_type *s,
                                                size_type pos,
                                                size_type n) const
 {
-  if (!s)
+  if (!s || n == 0 || _size == 0)
     return npos;
-  return find_last_of(ustring(s, n), pos);
+
+  pos = std::min(pos == npos ? max_pos : pos, _size - 1);
+  const size_t offset = ustring_simd::find_last_of(data(), pos + 1, ustring_simd::byte_set(s, n));
+  return offset == ustring_simd::not_found ? npos : static_cast<size_type>(offset);
 }
 
 ustring::size_type ustring::find_last_of(const value_type *s, size_type pos, size_type n) const
@@ -1798,27 +2405,7 @@ ustring::size_type ustring::find_last_of(value_type c, size_type pos) const noex
 ustring::size_type ustring::view::find_first_not_of(const ustring &str,
                                                     size_type pos) const noexcept
 {
-  if (pos >= _size)
-    return npos;
-  if (str.empty())
-    return pos;
-
-  const value_type *const chars = str.data();
-  const size_type chars_len = str._size;
-  const value_type *p = data() + pos;
-  const value_type *const end = data() + _size;
-
-  while (p != end) {
-    bool found = false;
-    for (size_type i = 0; i < chars_len && !found; ++i) {
-      if (*p == chars[i])
-        found = true;
-    }
-    if (!found)
-      return p - data();
-    ++p;
-  }
-  return npos;
+  return find_first_not_of(str.data(), pos, str.size());
 }
 
 ustring::size_type ustring::find_first_not_of(const ustring &str, size_type pos) const noexcept
@@ -1832,7 +2419,14 @@ ustring::size_type ustring::view::find_first_not_of(const value_type *s,
 {
   if (!s)
     return pos;
-  return find_first_not_of(ustring(s, n), pos);
+  if (pos >= _size)
+    return npos;
+  if (n == 0)
+    return pos;
+
+  const size_t offset = ustring_simd::find_first_not_of(
+      data() + pos, _size - pos, ustring_simd::byte_set(s, n));
+  return offset == ustring_simd::not_found ? npos : pos + static_cast<size_type>(offset);
 }
 
 ustring::size_type ustring::find_first_not_of(const value_type *s,
@@ -1856,17 +2450,7 @@ ustring::size_type ustring::find_first_not_of(const value_type *s, size_type pos
 
 ustring::size_type ustring::view::find_first_not_of(value_type c, size_type pos) const noexcept
 {
-  if (pos >= _size)
-    return npos;
-
-  const value_type *p = data() + pos;
-  const value_type *const end = data() + _size;
-  while (p != end) {
-    if (*p != c)
-      return p - data();
-    ++p;
-  }
-  return npos;
+  return find_first_not_of(&c, pos, 1);
 }
 
 ustring::size_type ustring::find_first_not_of(value_type c, size_type pos) const noexcept
@@ -1874,32 +2458,43 @@ ustring::size_type ustring::find_first_not_of(value_type c, size_type pos) const
   return to_view().find_first_not_of(c, pos);
 }
 
+ustring::size_type ustring::view::find_first_property(CharProperty property,
+                                                      size_type pos) const noexcept
+{
+  return _find_property<true>(*this, pos, static_cast<uint32_t>(property));
+}
+
+ustring::size_type ustring::find_first_property(CharProperty property, size_type pos) const noexcept
+{
+  return to_view().find_first_property(property, pos);
+}
+
+ustring::size_type ustring::view::find_first_not_property(CharProperty property,
+                                                          size_type pos) const noexcept
+{
+  return _find_property<false>(*this, pos, static_cast<uint32_t>(property));
+}
+
+ustring::size_type ustring::find_first_not_property(CharProperty property,
+                                                     size_type pos) const noexcept
+{
+  return to_view().find_first_not_property(property, pos);
+}
+
+size_t ustring::view::count_property(CharProperty property) const noexcept
+{
+  return _count_property(*this, static_cast<uint32_t>(property));
+}
+
+size_t ustring::count_property(CharProperty property) const noexcept
+{
+  return to_view().count_property(property);
+}
+
 ustring::size_type ustring::view::find_last_not_of(const ustring &str,
                                                    size_type pos) const noexcept
 {
-  if (_size == 0)
-    return npos;
-  if (str.empty())
-    return std::min(pos == npos ? max_pos : pos, _size - 1);
-
-  pos = std::min(pos == npos ? max_pos : pos, _size - 1);
-  const value_type *const chars = str.data();
-  const size_type chars_len = str._size;
-  const value_type *p = data() + pos;
-
-  while (true) {
-    bool found = false;
-    for (size_type i = 0; i < chars_len && !found; ++i) {
-      if (*p == chars[i])
-        found = true;
-    }
-    if (!found)
-      return p - data();
-    if (p == data())
-      break;
-    --p;
-  }
-  return npos;
+  return find_last_not_of(str.data(), pos, str.size());
 }
 
 ustring::size_type ustring::find_last_not_of(const ustring &str, size_type pos) const noexcept
@@ -1913,7 +2508,16 @@ ustring::size_type ustring::view::find_last_not_of(const value_type *s,
 {
   if (!s)
     return pos;
-  return find_last_not_of(ustring(s, n), pos);
+  if (_size == 0)
+    return npos;
+
+  pos = std::min(pos == npos ? max_pos : pos, _size - 1);
+  if (n == 0)
+    return pos;
+
+  const size_t offset = ustring_simd::find_last_not_of(
+      data(), pos + 1, ustring_simd::byte_set(s, n));
+  return offset == ustring_simd::not_found ? npos : static_cast<size_type>(offset);
 }
 
 ustring::size_type ustring::find_last_not_of(const value_type *s, size_type pos, size_type n) const
@@ -1935,19 +2539,7 @@ ustring::size_type ustring::find_last_not_of(const value_type *s, size_type pos)
 
 ustring::size_type ustring::view::find_last_not_of(value_type c, size_type pos) const noexcept
 {
-  if (_size == 0)
-    return npos;
-
-  pos = std::min(pos == npos ? max_pos : pos, _size - 1);
-  const value_type *p = data() + pos;
-  while (true) {
-    if (*p != c)
-      return p - data();
-    if (p == data())
-      break;
-    --p;
-  }
-  return npos;
+  return find_last_not_of(&c, pos, 1);
 }
 
 ustring::size_type ustring::find_last_not_of(value_type c, size_type pos) const noexcept
@@ -1955,61 +2547,65 @@ ustring::size_type ustring::find_last_not_of(value_type c, size_type pos) const
   return to_view().find_last_not_of(c, pos);
 }
 
-size_t ustring::view::count(const ustring &str) const noexcept
+size_t ustring::view::count(const ustring &str) const noexcept
+{
+  return count(str.data(), str.size());
+}
+
+size_t ustring::count(const ustring &str) const noexcept
+{
+  return to_view().count(str);
+}
+
+size_t ustring::view::count(const searcher &s) const noexcept
 {
-  // todo:
-  if (size() < str.size()) {
+  if (s.size() == 0) {
     return 0;
   }
 
+  // overlapping occurrences are counted
   size_t count = 0;
-  size_t pos = 0;
-  while (pos < size() - str.size() + 1) {
-    for (size_t i = 0; i < str.size(); i++) {
-      if (data()[pos + i] != str.data()[i]) {
-        break;
-      }
-      if (i == str.size() - 1) {
-        count++;
-      }
-    }
-    pos++;
+  for (size_type pos = s.find(*this); pos != npos; pos = s.find(*this, pos + 1)) {
+    count++;
   }
-
   return count;
 }
 
-size_t ustring::count(const ustring &str) const noexcept
+size_t ustring::count(const searcher &s) const noexcept
 {
-  return to_view().count(str);
+  return to_view().count(s);
 }
 
 size_t ustring::view::count(const value_type *s) const
 {
-  if (empty()) {
+  if (!s) {
     return 0;
   }
+  return count(s, strlen(reinterpret_cast<const char *>(s)));
+}
 
-  size_t count = 0, str_len = strlen(reinterpret_cast<const char *>(s));
-  size_t pos = 0;
-  while (pos < size() - str_len + 1) {
-    for (size_t i = 0; i < str_len; i++) {
-      if (data()[pos + i] != s[i]) {
-        break;
-      }
-      if (i == str_len - 1) {
-        count++;
-      }
-    }
-    pos++;
+size_t ustring::count(const value_type *s) const
+{
+  return to_view().count(s);
+}
+
+size_t ustring::view::count(const value_type *s, size_type n) const noexcept
+{
+  if (!s || n == 0) {
+    return 0;
   }
 
+  // overlapping occurrences are counted
+  size_t count = 0;
+  for (size_type pos = find(s, 0, n); pos != npos; pos = find(s, pos + 1, n)) {
+    count++;
+  }
   return count;
 }
 
-size_t ustring::count(const value_type *s) const
+size_t ustring::count(const value_type *s, size_type n) const noexcept
 {
-  return to_view().count(s);
+  return to_view().count(s, n);
 }
 
 size_t ustring::view::count(char32_t c) const
@@ -2031,14 +2627,7 @@ size_t ustring::count(char32_t c) const
 
 size_t ustring::view::count(std::function<bool(char32_t)> f) const
 {
-  size_t count = 0;
-  for (const auto &it : code_points()) {
-    if (f(it)) {
-      count++;
-    }
-  }
-
-  return count;
+  return count<std::function<bool(char32_t)> &>(f);
 }
 
 size_t ustring::count(std::function<bool(char32_t)> f) const
@@ -2093,12 +2682,7 @@ bool ustring::contains(value_type c) const noexcept
 
 bool ustring::view::contains(std::function<bool(char32_t)> f) const
 {
-  for (const auto &it : code_points()) {
-    if (f(it)) {
-      return true;
-    }
-  }
-  return false;
+  return contains<std::function<bool(char32_t)> &>(f);
 }
 
 bool ustring::contains(std::function<bool(char32_t)> f) const
@@ -2108,13 +2692,13 @@ bool ustring::contains(std::function<bool(char32_t)> f) const
 
 int ustring::view::compare(const ustring &str) const noexcept
 {
-  const size_type len = std::min(_size, str._size);
+  const size_type len = std::min(_size, str.size());
   int result = std::memcmp(data(), str.data(), len * sizeof(value_type));
   if (result != 0)
     return result;
-  if (_size < str._size)
+  if (_size < str.size())
     return -1;
-  if (_size > str._size)
+  if (_size > str.size())
     return 1;
   return 0;
 }
@@ -2131,7 +2715,7 @@ int ustring::view::compare(size_type pos1, size_type n1, const ustring &str) con
     throw std::out_of_range("ustring::compare: position out of range");
   }
 #endif
-  return compare(pos1, n1, str.data(), str._size);
+  return compare(pos1, n1, str.data(), str.size());
 }
 
 int ustring::compare(size_type pos1, size_type n1, const ustring &str) const
@@ -2143,13 +2727,13 @@ int ustring::view::compare(
     size_type pos1, size_type n1, const ustring &str, size_type pos2, size_type n2) const
 {
 #ifdef _DEBUG
-  if (pos1 > _size || pos2 > str._size) {
+  if (pos1 > _size || pos2 > str.size()) {
     throw std::out_of_range("ustring::compare: position out of range");
   }
 #endif
 
   n1 = std::min(n1, _size - pos1);
-  n2 = std::min(n2, str._size - pos2);
+  n2 = std::min(n2, str.size() - pos2);
   const size_type len = std::min(n1, n2);
   int result = std::memcmp(data() + pos1, str.data() + pos2, len * sizeof(value_type));
   if (result != 0)
@@ -2313,7 +2897,7 @@ bool ustring::view::operator==(const char8_t *rhs) const noexcept
 bool ustring::operator==(const char8_t *rhs) const noexcept
 {
   if (!rhs)
-    return _size == 0;
+    return size() == 0;
   return compare(reinterpret_cast<const value_type *>(rhs)) == 0;
 }
 
@@ -2339,7 +2923,7 @@ bool ustring::view::operator==(const char16_t *rhs) const noexcept
 bool ustring::operator==(const char16_t *rhs) const noexcept
 {
   if (!rhs)
-    return _size == 0;
+    return size() == 0;
   return compare(ustring(rhs)) == 0;
 }
 
@@ -2365,7 +2949,7 @@ bool ustring::view::operator==(const char32_t *rhs) const noexcept
 bool ustring::operator==(const char32_t *rhs) const noexcept
 {
   if (!rhs)
-    return _size == 0;
+    return size() == 0;
   return compare(ustring(rhs)) == 0;
 }
 
@@ -2381,6 +2965,46 @@ std::strong_ordering ustring::operator<=>(const char32_t *rhs) const noexcept
   return to_view() <=> rhs;
 }
 
+bool ustring::view::operator==(std::string_view rhs) const noexcept
+{
+  return *this == view(rhs);
+}
+
+bool ustring::operator==(std::string_view rhs) const noexcept
+{
+  return to_view() == view(rhs);
+}
+
+std::strong_ordering ustring::view::operator<=>(std::string_view rhs) const noexcept
+{
+  return *this <=> view(rhs);
+}
+
+std::strong_ordering ustring::operator<=>(std::string_view rhs) const noexcept
+{
+  return to_view() <=> view(rhs);
+}
+
+bool ustring::view::operator==(std::u8string_view rhs) const noexcept
+{
+  return *this == view(rhs);
+}
+
+bool ustring::operator==(std::u8string_view rhs) const noexcept
+{
+  return to_view() == view(rhs);
+}
+
+std::strong_ordering ustring::view::operator<=>(std::u8string_view rhs) const noexcept
+{
+  return *this <=> view(rhs);
+}
+
+std::strong_ordering ustring::operator<=>(std::u8string_view rhs) const noexcept
+{
+  return to_view() <=> view(rhs);
+}
+
 bool operator==(const ustring::view &lhs, const ustring::view &rhs) noexcept
 {
   if (lhs.size() != rhs.size()) {
@@ -2448,7 +3072,7 @@ ustring operator+(const ustring &lhs, const ustring::value_type *rhs)
     return lhs;
   const auto rhs_len = strlen(reinterpret_cast<const char *>(rhs));
   ustring result = lhs;
-  result.reserve(lhs._size + rhs_len);
+  result.reserve(lhs.size() + rhs_len);
   result.append(rhs);
   return result;
 }
@@ -2459,108 +3083,74 @@ ustring operator+(const ustring::value_type *lhs, const ustring &rhs)
     return rhs;
   const auto lhs_len = strlen(reinterpret_cast<const char *>(lhs));
   ustring result{lhs};
-  result.reserve(lhs_len + rhs._size);
+  result.reserve(lhs_len + rhs.size());
   result.append(rhs);
   return result;
 }
 
-bool ustring::is_alpha() const noexcept
+ustring operator+(ustring &&lhs, const ustring &rhs)
 {
-  if (empty())
-    return false;
+  lhs.append(rhs);
+  return std::move(lhs);
+}
 
-  //  for (auto c : code_points()) {
-  //    if (!u_isalpha(c))
-  //      return false;
-  //  }
-  //
-  //  return true;
-  //}
+ustring operator+(ustring &&lhs, ustring::value_type rhs)
+{
+  lhs.push_back(rhs);
+  return std::move(lhs);
+}
 
-  UErrorCode status = U_ZERO_ERROR;
-  UChar32 c;
-  int32_t i = 0;
-  while (i < _size) {
-    U8_NEXT(data(), i, _size, c);
-    if (status != U_ZERO_ERROR || !u_isalpha(c))
-      return false;
+ustring operator+(ustring &&lhs, const ustring::value_type *rhs)
+{
+  if (rhs) {
+    lhs.append(rhs);
   }
-  return true;
+  return std::move(lhs);
 }
 
-bool ustring::is_digit() const noexcept
+ustring ustring::concat_views(std::span<const view> pieces)
 {
-  if (empty())
-    return false;
-  UErrorCode status = U_ZERO_ERROR;
-  UChar32 c;
-  int32_t i = 0;
-  while (i < _size) {
-    U8_NEXT(data(), i, _size, c);
-    if (status != U_ZERO_ERROR || !u_isdigit(c))
-      return false;
+  size_type total = 0;
+  for (const view &piece : pieces) {
+    total += piece.size();
   }
-  return true;
+  ustring result;
+  result.reserve(total);
+  for (const view &piece : pieces) {
+    result.append(piece.data(), piece.size());
+  }
+  return result;
+}
+
+bool ustring::is_alpha() const noexcept
+{
+  return _all_have_property(to_view(), static_cast<uint32_t>(CharProperty::ALPHABETIC));
+}
+
+bool ustring::is_digit() const noexcept
+{
+  return _all_have_property(to_view(), static_cast<uint32_t>(CharProperty::DIGIT));
 }
 
 bool ustring::is_alnum() const noexcept
 {
-  if (empty())
-    return false;
-  UErrorCode status = U_ZERO_ERROR;
-  UChar32 c;
-  int32_t i = 0;
-  while (i < _size) {
-    U8_NEXT(data(), i, _size, c);
-    if (status != U_ZERO_ERROR || !u_isalnum(c))
-      return false;
-  }
-  return true;
+  return _all_have_property(to_view(),
+                            static_cast<uint32_t>(CharProperty::ALPHABETIC | CharProperty::DIGIT));
 }
 
 bool ustring::is_space() const noexcept
 {
-  if (empty())
-    return false;
-  UErrorCode status = U_ZERO_ERROR;
-  UChar32 c;
-  int32_t i = 0;
-  while (i < _size) {
-    U8_NEXT(data(), i, _size, c);
-    if (status != U_ZERO_ERROR || !u_isspace(c))
-      return false;
-  }
-  return true;
+  return _all_have_property(to_view(), static_cast<uint32_t>(CharProperty::WHITESPACE));
 }
 
 bool ustring::is_lower() const noexcept
 {
-  if (empty())
-    return false;
-  UErrorCode status = U_ZERO_ERROR;
-  UChar32 c;
-  int32_t i = 0;
-  while (i < _size) {
-    U8_NEXT(data(), i, _size, c);
-    if (status != U_ZERO_ERROR || !u_islower(c))
-      return false;
-  }
-  return true;
+  return _all_have_property(to_view(), static_cast<uint32_t>(CharProperty::LOWERCASE));
 }
 
 bool ustring::is_upper() const noexcept
 {
-  if (empty())
-    return false;
-  UErrorCode status = U_ZERO_ERROR;
-  UChar32 c;
-  int32_t i = 0;
-  while (i < _size) {
-    U8_NEXT(data(), i, _size, c);
-    if (status != U_ZERO_ERROR || !u_isupper(c))
-      return false;
-  }
-  return true;
+  return _all_have_property(to_view(), static_cast<uint32_t>(CharProperty::UPPERCASE));
 }
 
 bool ustring::is_title() const noexcept
@@ -2573,8 +3163,11 @@ bool ustring::is_title() const noexcept
     return false;
 
   UErrorCode status = U_ZERO_ERROR;
-  UBreakIterator *bi = ubrk_open(
-      UBRK_WORD, nullptr, icu_str.getBuffer(), icu_str.length(), &status);
+  borrowed_break_iterator borrowed(UBRK_WORD, nullptr, status);
+  UBreakIterator *bi = borrowed.get();
+  if (!bi)
+    return false;
+  ubrk_setText(bi, icu_str.getBuffer(), icu_str.length(), &status);
   if (U_FAILURE(status))
     return false;
 
@@ -2606,141 +3199,127 @@ bool ustring::is_title() const noexcept
     end = ubrk_next(bi);
   }
 
-  ubrk_close(bi);
   return is_title;
 }
 
 bool ustring::is_normalized(const NormalizationConfig &config) const
 {
-  const char *data_file = _get_normalization_data_file(config);
-
-  UErrorCode status = U_ZERO_ERROR;
-  const UNormalizer2 *normalizer = unorm2_getInstance(
-      nullptr, data_file, static_cast<UNormalization2Mode>(config.mode), &status);
-
-  if (U_FAILURE(status)) {
+  const size_t start = _normalization_start(config, *this);
+  if (start == static_cast<size_t>(size())) {
+    return true;
+  }
+  const icu::Normalizer2 *normalizer = _get_normalizer(config);
+  if (!normalizer) {
     return false;
   }
 
-  std::u16string utf16_data = to_u16string();
-  UBool result = unorm2_isNormalized(normalizer, utf16_data.data(), utf16_data.size(), &status);
-
+  UErrorCode status = U_ZERO_ERROR;
+  const icu::StringPiece rest(reinterpret_cast<const char *>(data()) + start, size() - start);
+  const UBool result = normalizer->isNormalizedUTF8(rest, status);
   return U_SUCCESS(status) && result;
 }
 
 ustring &ustring::filter(std::function<bool(char32_t, size_type)> &&codepoint_filter)
 {
-  if (empty())
-    return *this;
-
-  UErrorCode status = U_ZERO_ERROR;
-
-  auto src = data();
-  int32_t srcLength = _size;
-  int32_t i = 0, dest_i = 0;
-  size_type count = 0;
-  UChar32 c;
-
-  while (i < srcLength) {
-    U8_NEXT(src, i, srcLength, c);
-
-    if (codepoint_filter(c, count) && i != dest_i) {
-      U8_APPEND_UNSAFE(src, dest_i, c);
-    }
-
-    count++;
-  }
-
-  _size = dest_i;
-  return *this;
+  return filter<std::function<bool(char32_t, size_type)> &>(codepoint_filter);
 }
 
 ustring &ustring::transform(std::function<char32_t(char32_t, size_type)> &&codepoint_transformer)
 {
-  if (empty())
+  return transform<std::function<char32_t(char32_t, size_type)> &>(codepoint_transformer);
+}
+
+ustring &ustring::map_case(bool upper, bool full)
+{
+  char8_t *s = data();
+  const int32_t n = size();
+  const size_t ascii = upper ? ustring_simd::ascii_to_upper(s, n) : ustring_simd::ascii_to_lower(s, n);
+  if (ascii == static_cast<size_t>(n)) {
     return *this;
+  }
 
+  if (!full) {
+    int32_t r = static_cast<int32_t>(ascii), w = r;
+    if (map_simple_case(upper, s, r, n, s, w)) {
+      set_size(w);
+      return *this;
+    }
+    // No simple mapping grows a code point by more than half its length (2 to 3 bytes)
+    ustring out(resource());
+    out.reserve(w + (n - r) + (n - r) / 2);
+    std::memcpy(out.data(), s, w);
+    map_simple_case(upper, s, r, n, out.data(), w);
+    out.set_size(w);
+    return *this = std::move(out);
+  }
+
+  // Full mappings need the context around each code point (final sigma), so ICU sees the whole
+  // string but only hands back the changed spans, and the edits say where they go. ASCII maps
+  // the same without context, so with it done above the edits stay short.
+  icu::Edits edits;
   UErrorCode status = U_ZERO_ERROR;
-  auto utf8Buffer = new char8_t[_size * 4];
-
-  const char8_t *src = data();
-  int32_t srcLength = _size;
-  int32_t i = 0, dest_i = 0;
-  size_t count = 0;
-  UChar32 c;
-
-  while (i < srcLength) {
-    U8_NEXT(src, i, srcLength, c);
-    if (c < 0)
-      break;  // Invalid UTF-8 sequence
-    c = codepoint_transformer(c, count);
-
-    U8_APPEND_UNSAFE(utf8Buffer, dest_i, c);
-    count++;
+  char stack_changes[256];
+  std::unique_ptr<char[]> heap_changes;
+  char *changes = stack_changes;
+  int32_t capacity = sizeof(stack_changes);
+  auto map = [&] {
+    const char *src = reinterpret_cast<const char *>(s);
+    return upper ? icu::CaseMap::utf8ToUpper(
+                       "", U_OMIT_UNCHANGED_TEXT, src, n, changes, capacity, &edits, status)
+                 : icu::CaseMap::utf8ToLower(
+                       "", U_OMIT_UNCHANGED_TEXT, src, n, changes, capacity, &edits, status);
+  };
+  const int32_t needed = map();
+  if (status == U_BUFFER_OVERFLOW_ERROR) {
+    heap_changes = std::make_unique<char[]>(needed);
+    changes = heap_changes.get();
+    capacity = needed;
+    status = U_ZERO_ERROR;
+    edits.reset();
+    map();
   }
-  // #ifdef _DEBUG
-  //   if (dest_i < _size * 4 - 1) {
-  //     utf8Buffer[dest_i] = '\0';
-  //   }
-  // #endif
-
-  if (U_SUCCESS(status)) {
-    assign(utf8Buffer, dest_i);
+  if (U_FAILURE(status) || !edits.hasChanges()) {
+    return *this;
   }
 
-  delete[] utf8Buffer;
-  return *this;
+  // In place, unless some change would run into bytes that have not been moved yet
+  bool in_place = true;
+  auto it = edits.getCoarseChangesIterator();
+  while (in_place && it.next(status)) {
+    in_place = it.destinationIndex() + it.newLength() <= it.sourceIndex() + it.oldLength();
+  }
+  const int32_t new_size = n + edits.lengthDelta();
+  ustring out(resource());
+  char8_t *d = s;
+  if (!in_place) {
+    out.reserve(new_size);
+    d = out.data();
+  }
+  it = edits.getCoarseIterator();
+  while (it.next(status)) {
+    if (it.hasChange()) {
+      std::memcpy(d + it.destinationIndex(), changes + it.replacementIndex(), it.newLength());
+    }
+    else if (d != s || it.destinationIndex() != it.sourceIndex()) {
+      std::memmove(d + it.destinationIndex(), s + it.sourceIndex(), it.oldLength());
+    }
+  }
+  if (in_place) {
+    set_size(new_size);
+    return *this;
+  }
+  out.set_size(new_size);
+  return *this = std::move(out);
 }
 
 ustring &ustring::to_lower(bool any_lower)
 {
-  if (!any_lower)
-    return transform(_to_lower);
-
-  icu::ErrorCode icu_status;
-  ustring out;
-  out.resize(size() * 2);
-  auto real_size = icu::CaseMap::utf8ToLower("" /* root locale */,
-                                             0 /* default options */,
-                                             reinterpret_cast<const char *>(data()),
-                                             size(),
-                                             reinterpret_cast<char *>(out.data()),
-                                             out.size(),
-                                             nullptr /* edits - unused */,
-                                             icu_status);
-  out.resize(real_size);
-  if (icu_status.isFailure()) {
-    std::cout << icu_status.errorName();
-    icu_status.reset();
-    return *this;
-  }
-
-  return *this = std::move(out);
+  return map_case(false, any_lower);
 }
 
 ustring &ustring::to_upper(bool any_upper)
 {
-  if (!any_upper)
-    return transform(_to_upper);
-
-  icu::ErrorCode icu_status;
-  ustring out;
-  out.resize(size() * 2);
-  auto real_size = icu::CaseMap::utf8ToUpper("" /* root locale */,
-                                             0 /* default options */,
-                                             reinterpret_cast<const char *>(data()),
-                                             size(),
-                                             reinterpret_cast<char *>(out.data()),
-                                             out.size(),
-                                             nullptr /* edits - unused */,
-                                             icu_status);
-  out.resize(real_size);
-  if (icu_status.isFailure()) {
-    std::cout << icu_status.errorName();
-    icu_status.reset();
-    return *this;
-  }
-  return *this = std::move(out);
+  return map_case(true, any_upper);
 }
 
 ustring &ustring::capitalize(const char *locale)
@@ -2748,20 +3327,23 @@ ustring &ustring::capitalize(const char *locale)
   if (empty())
     return *this;
 
-  icu::Locale icuLocale(locale ? locale : std::locale().name().c_str());
+  const std::string locale_name = locale ? locale : std::locale().name();
 
   UErrorCode status = U_ZERO_ERROR;
-  icu::BreakIterator *bi = icu::BreakIterator::createSentenceInstance(icuLocale, status);
-  if (U_FAILURE(status) && status != U_USING_DEFAULT_WARNING)
+  borrowed_break_iterator borrowed(UBRK_SENTENCE, locale_name.c_str(), status);
+  UBreakIterator *bi = borrowed.get();
+  if (!bi)
     return *this;
 
   icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
       icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-  bi->setText(ustr);
+  ubrk_setText(bi, ustr.getBuffer(), ustr.length(), &status);
+  if (U_FAILURE(status))
+    return *this;
 
-  int32_t start = bi->first();
-  int32_t end = bi->next();
-  while (end != icu::BreakIterator::DONE) {
+  int32_t start = ubrk_first(bi);
+  int32_t end = ubrk_next(bi);
+  while (end != UBRK_DONE) {
     if (start < ustr.length()) {
       ustr.setCharAt(start, u_toupper(ustr.char32At(start)));
       for (int32_t i = start + 1; i < end; ++i) {
@@ -2769,14 +3351,13 @@ ustring &ustring::capitalize(const char *locale)
       }
     }
     start = end;
-    end = bi->next();
+    end = ubrk_next(bi);
   }
 
   std::string utf8;
   ustr.toUTF8String(utf8);
   assign(reinterpret_cast<const char8_t *>(utf8.c_str()), utf8.length());
 
-  delete bi;
   return *this;
 }
 
@@ -2788,125 +3369,65 @@ ustring &ustring::swap_case()
 ustring &ustring::title(const char *locale, ToTitleOptions options)
 {
   icu::ErrorCode icu_status;
-  ustring out;
+  UCaseMap *case_map =
+      icu_service_cache::local().title_case_map("", static_cast<uint32_t>(options), icu_status);
+  if (!case_map)
+    return *this;
+
+  ustring out(resource());
   out.resize(size() * 2);
-  auto real_size = icu::CaseMap::utf8ToTitle("",
-                                             static_cast<uint32_t>(options),
-                                             nullptr,
-                                             reinterpret_cast<const char *>(data()),
-                                             size(),
-                                             reinterpret_cast<char *>(out.data()),
-                                             out.capacity(),
-                                             nullptr,
-                                             icu_status);
+  auto real_size = ucasemap_utf8ToTitle(case_map,
+                                        reinterpret_cast<char *>(out.data()),
+                                        out.capacity(),
+                                        reinterpret_cast<const char *>(data()),
+                                        size(),
+                                        icu_status);
   out.resize(real_size);
   if (icu_status.isFailure()) {
     std::cout << icu_status.errorName();
     icu_status.reset();
-    return *this;
-  }
-
-  return *this = std::move(out);
-}
-
-ustring &ustring::trim()
-{
-  UErrorCode status = U_ZERO_ERROR;
-  auto unicodeStr = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-  unicodeStr.trim();
-
-  std::string utf8TitleStr;
-  unicodeStr.toUTF8String(utf8TitleStr);
-
-  assign(reinterpret_cast<const value_type *>(utf8TitleStr.data()), utf8TitleStr.size());
-
-  return *this;
-}
-
-ustring &ustring::strip(const value_type *ch)
-{
-  if (empty() || !ch)
-    return *this;
-
-  std::unordered_set<UChar32> chars;
-
-  const char8_t *p = ch;
-  int32_t i = 0;
-  while (*(p + i)) {
-    UChar32 c;
-    U8_NEXT(p, i, -1, c);
-    if (c < 0)
-      break;
-    chars.insert(c);
-  }
-
-  const char8_t *src = data();
-  int32_t srcLength = _size;
-  int32_t start = 0, end = srcLength;
-  UChar32 c;
-
-  while (start < srcLength) {
-    auto old_start = start;
-    U8_NEXT(src, start, srcLength, c);
-    if (c < 0 || !chars.contains(c)) {
-      start = old_start;
-      break;
-    }
-  }
-
-  while (end > start) {
-    auto old_end = end;
-    U8_PREV(src, 0, end, c);
-    if (c < 0 || !chars.contains(c)) {
-      end = old_end;
-      break;
-    }
-  }
-
-  if (start > 0 || end < srcLength) {
-    assign(src + start, end - start);
+    return *this;
   }
 
-  return *this;
+  return *this = std::move(out);
 }
 
-ustring &ustring::strip(const ustring &ch)
+ustring &ustring::trim()
 {
-  if (empty() || !ch.size())
-    return *this;
+  UErrorCode status = U_ZERO_ERROR;
+  auto unicodeStr = icu::UnicodeString::fromUTF8(
+      icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
+  unicodeStr.trim();
 
-  std::unordered_set<UChar32> chars;
+  std::string utf8TitleStr;
+  unicodeStr.toUTF8String(utf8TitleStr);
 
-  const char8_t *p = ch.data();
-  int32_t i = 0;
-  while (i < size()) {
-    UChar32 c;
-    U8_NEXT(p, i, -1, c);
-    if (c < 0)
-      break;
-    chars.insert(c);
-  }
+  assign(reinterpret_cast<const value_type *>(utf8TitleStr.data()), utf8TitleStr.size());
 
-  const char8_t *src = data();
-  int32_t srcLength = _size;
-  int32_t start = 0, end = srcLength;
-  UChar32 c;
+  return *this;
+}
 
-  while (start < srcLength) {
-    U8_NEXT(src, start, srcLength, c);
-    if (c < 0 || !chars.contains(c))
-      break;
-  }
+ustring &ustring::strip(const value_type *ch)
+{
+  if (empty() || !ch)
+    return *this;
+  return strip(view(ch, std::char_traits<value_type>::length(ch)));
+}
 
-  while (end > start) {
-    U8_PREV(src, 0, end, c);
-    if (c < 0 || !chars.contains(c))
-      break;
-  }
+ustring &ustring::strip(const ustring &ch)
+{
+  return strip(ch.to_view());
+}
 
-  if (start > 0 || end < srcLength) {
-    assign(src + start, end - start);
+ustring &ustring::strip(const view &ch)
+{
+  if (empty() || ch.empty())
+    return *this;
+
+  const code_point_set chars(ch);
+  const auto [start, end] = chars.strip_bounds(data(), size());
+  if (start > 0 || end < size()) {
+    assign(data() + start, end - start);
   }
 
   return *this;
@@ -2914,37 +3435,38 @@ ustring &ustring::strip(const ustring &ch)
 
 ustring &ustring::normalize(const NormalizationConfig &config)
 {
-  const char *data_file = _get_normalization_data_file(config);
-
-  UErrorCode status = U_ZERO_ERROR;
-  const UNormalizer2 *normalizer = unorm2_getInstance(
-      nullptr, data_file, static_cast<UNormalization2Mode>(config.mode), &status);
-
-  if (U_FAILURE(status)) {
+  // Nearly all input is normalized already: skip the ASCII prefix, quick check the rest on
+  // UTF-8, and only normalize (still on UTF-8) when the check fails
+  const size_t start = _normalization_start(config, *this);
+  if (start == static_cast<size_t>(size())) {
+    return *this;
+  }
+  const icu::Normalizer2 *normalizer = _get_normalizer(config);
+  if (!normalizer) {
     return *this;
   }
 
-  std::u16string utf16_data = to_u16string();
-  std::vector<UChar> buffer(utf16_data.size() * 2);
-  int32_t length = unorm2_normalize(
-      normalizer, utf16_data.data(), utf16_data.size(), buffer.data(), buffer.size(), &status);
-
-  if (status == U_BUFFER_OVERFLOW_ERROR) {
-    status = U_ZERO_ERROR;
-    buffer.resize(length);
-    length = unorm2_normalize(
-        normalizer, utf16_data.data(), utf16_data.size(), buffer.data(), buffer.size(), &status);
+  UErrorCode status = U_ZERO_ERROR;
+  const icu::StringPiece rest(reinterpret_cast<const char *>(data()) + start, size() - start);
+  if (normalizer->isNormalizedUTF8(rest, status) && U_SUCCESS(status)) {
+    return *this;
   }
 
+  status = U_ZERO_ERROR;
+  ustring out(resource());
+  out.reserve(size() + size() / 4);
+  out.append(data(), static_cast<size_type>(start));
+  ustring_sink sink(out);
+  normalizer->normalizeUTF8(0, rest, sink, nullptr, status);
   if (U_SUCCESS(status)) {
-    *this = from_utf16(buffer.data(), length);
+    *this = std::move(out);
   }
   return *this;
 }
 
 ustring ustring::filtered(std::function<bool(char32_t, size_type)> &&codepoint_filter) const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.filter(std::forward<std::function<bool(char32_t, size_type)>>(codepoint_filter));
   return ret;
 }
@@ -2952,96 +3474,102 @@ ustring ustring::filtered(std::function<bool(char32_t, size_type)> &&codepoint_f
 ustring ustring::transformed(
     std::function<char32_t(char32_t, size_type)> &&codepoint_transformer) const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.transform(std::forward<std::function<char32_t(char32_t, size_type)>>(codepoint_transformer));
   return ret;
 }
 
 ustring ustring::lowered(bool any_lower) const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.to_lower(any_lower);
   return ret;
 }
 
 ustring ustring::uppered(bool any_upper) const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.to_upper(any_upper);
   return ret;
 }
 
 ustring ustring::capitalized() const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.capitalize();
   return ret;
 }
 
 ustring ustring::case_swapped() const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.swap_case();
   return ret;
 }
 
 ustring ustring::trimmed() const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.trim();
   return ret;
 }
 
 ustring ustring::titled(const char *locale, ToTitleOptions options) const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.title(locale, options);
   return ret;
 }
 
 ustring ustring::stripped(const value_type *ch) const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.strip(ch);
   return ret;
 }
 
 ustring ustring::normalized(const NormalizationConfig &config) const
 {
-  ustring ret{*this};
+  ustring ret(*this, resource());
   ret.normalize(config);
   return ret;
 }
 
-ustring &ustring::to_halfwidth()
+ustring &ustring::replace(const searcher &pattern, const view &replacement)
 {
-  UErrorCode status = U_ZERO_ERROR;
-  icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-  auto trans = std::unique_ptr<icu::Transliterator>(
-      icu::Transliterator::createInstance("Fullwidth-Halfwidth", UTRANS_FORWARD, status));
-  if (U_SUCCESS(status)) {
-    trans->transliterate(ustr);
-    std::string utf8;
-    ustr.toUTF8String(utf8);
-    assign(reinterpret_cast<const value_type *>(utf8.data()), utf8.length());
+  const size_type n = pattern.size();
+  size_type pos = n == 0 ? npos : pattern.find(to_view());
+  if (pos == npos) {
+    return *this;
+  }
+
+  ustring result(resource());
+  result.reserve(size());
+  size_type start = 0;
+  for (; pos != npos; pos = pattern.find(to_view(), start)) {
+    result.append(data() + start, pos - start);
+    result.append(replacement.data(), replacement.size());
+    start = pos + n;
   }
+  result.append(data() + start, size() - start);
+  swap(result);
+  return *this;
+}
+
+ustring &ustring::replace(const ustring &pattern, const view &replacement)
+{
+  return replace(searcher(pattern), replacement);
+}
+
+ustring &ustring::to_halfwidth()
+{
+  _transliterate(*this, "Fullwidth-Halfwidth");
   return *this;
 }
 
 ustring &ustring::to_fullwidth()
 {
-  UErrorCode status = U_ZERO_ERROR;
-  icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-  auto trans = std::unique_ptr<icu::Transliterator>(
-      icu::Transliterator::createInstance("Halfwidth-Fullwidth", UTRANS_FORWARD, status));
-  if (U_SUCCESS(status)) {
-    trans->transliterate(ustr);
-    std::string utf8;
-    ustr.toUTF8String(utf8);
-    assign(reinterpret_cast<const value_type *>(utf8.data()), utf8.length());
-  }
+  _transliterate(*this, "Halfwidth-Fullwidth");
   return *this;
 }
 
@@ -3053,7 +3581,7 @@ ustring &ustring::normalize_whitespace(bool including_zero_width)
   UErrorCode status = U_ZERO_ERROR;
 
   auto src = data();
-  int32_t srcLength = _size;
+  int32_t srcLength = size();
   int32_t i = 0, dest_i = 0;
   UChar32 c = 0, last_c;
 
@@ -3080,7 +3608,7 @@ ustring &ustring::normalize_whitespace(bool including_zero_width)
     }
   }
 
-  _size = last_is_space ? dest_i - 1 : dest_i /* minus last space */;
+  set_size(last_is_space ? dest_i - 1 : dest_i /* minus last space */);
   return *this;
 }
 
@@ -3137,33 +3665,13 @@ ustring &ustring::normalize_dashes()
 
 ustring &ustring::simplify()
 {
-  UErrorCode status = U_ZERO_ERROR;
-  icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-  auto trans = std::unique_ptr<icu::Transliterator>(
-      icu::Transliterator::createInstance("Traditional-Simplified", UTRANS_FORWARD, status));
-  if (U_SUCCESS(status)) {
-    trans->transliterate(ustr);
-    std::string utf8;
-    ustr.toUTF8String(utf8);
-    assign(reinterpret_cast<const value_type *>(utf8.data()), utf8.length());
-  }
+  _transliterate(*this, "Traditional-Simplified");
   return *this;
 }
 
 ustring &ustring::traditionalize()
 {
-  UErrorCode status = U_ZERO_ERROR;
-  icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-  auto trans = std::unique_ptr<icu::Transliterator>(
-      icu::Transliterator::createInstance("Simplified-Traditional", UTRANS_FORWARD, status));
-  if (U_SUCCESS(status)) {
-    trans->transliterate(ustr);
-    std::string utf8;
-    ustr.toUTF8String(utf8);
-    assign(reinterpret_cast<const value_type *>(utf8.data()), utf8.length());
-  }
+  _transliterate(*this, "Simplified-Traditional");
   return *this;
 }
 
@@ -3183,7 +3691,7 @@ ustring ustring::unique() const
   UErrorCode status = U_ZERO_ERROR;
 
   auto src = ret.data();
-  int32_t srcLength = _size;
+  int32_t srcLength = size();
   int32_t i = 0, dest_i = 0;
   UChar32 c;
 
@@ -3197,13 +3705,17 @@ ustring ustring::unique() const
     }
   }
 
-  ret._size = dest_i;
+  ret.set_size(dest_i);
   return *this;
 }
 
 std::vector<ustring::view> ustring::view::split(char32_t delimiter) const
 {
-  return split(std::unordered_set<char32_t>{delimiter});
+  std::vector<view> result;
+  for (const view &piece : lazy_split(delimiter)) {
+    result.push_back(piece);
+  }
+  return result;
 }
 
 std::vector<ustring::view> ustring::split(char32_t delimiters) const
@@ -3215,22 +3727,19 @@ std::vector<ustring::view> ustring::view::split(std::unordered_set<char32_t> &&d
 {
   std::vector<view> result;
 
-  UErrorCode status = U_ZERO_ERROR;
-  icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-
-  icu::StringCharacterIterator iter(ustr);
+  const int32_t length = static_cast<int32_t>(size());
   int32_t start = 0;
-  UChar32 c;
-  while ((c = iter.next32()) != icu::StringCharacterIterator::DONE) {
-    if (delimiter.contains(c)) {
-      int32_t end = iter.getIndex() - 1;
-      result.emplace_back(data() + start, end - start);
-      start = iter.getIndex();
+  for (int32_t i = 0; i < length;) {
+    const int32_t begin = i;
+    UChar32 c;
+    U8_NEXT(data(), i, length, c);
+    if (c >= 0 && delimiter.contains(static_cast<char32_t>(c))) {
+      result.emplace_back(data() + start, begin - start);
+      start = i;
     }
   }
-  if (start < ustr.length()) {
-    result.emplace_back(data() + start, ustr.length() - start);
+  if (start < length) {
+    result.emplace_back(data() + start, length - start);
   }
 
   return result;
@@ -3243,35 +3752,167 @@ std::vector<ustring::view> ustring::split(std::unordered_set<char32_t> &&delimit
 
 std::vector<ustring::view> ustring::view::split(const ustring &delimiter) const
 {
-  if (delimiter.empty()) {
+  return split(searcher(delimiter));
+}
+
+std::vector<ustring::view> ustring::split(const ustring &delimiter) const
+{
+  return to_view().split(delimiter);
+}
+
+std::vector<ustring::view> ustring::view::split(const searcher &delimiter) const
+{
+  if (delimiter.size() == 0) {
     return {};
   }
 
   std::vector<view> result;
-
-  icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-  icu::UnicodeString delimStr = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(reinterpret_cast<const char *>(delimiter.data()), delimiter.size()));
-
-  int32_t start = 0;
-  int32_t pos;
-  while ((pos = ustr.indexOf(delimStr, start)) != -1) {
+  size_type start = 0;
+  for (size_type pos = delimiter.find(*this); pos != npos; pos = delimiter.find(*this, start)) {
     result.emplace_back(data() + start, pos - start);
-    start = pos + delimStr.length();
+    start = pos + delimiter.size();
   }
-  if (start < ustr.length()) {
-    result.emplace_back(data() + start, ustr.length() - start);
+  if (start < size()) {
+    result.emplace_back(data() + start, size() - start);
   }
 
   return result;
 }
 
-std::vector<ustring::view> ustring::split(const ustring &delimiter) const
+std::vector<ustring::view> ustring::split(const searcher &delimiter) const
 {
   return to_view().split(delimiter);
 }
 
+ustring::split_view ustring::view::lazy_split(char32_t delimiter) const noexcept
+{
+  split_view result(*this, split_view::Kind::CODE_POINT);
+  // A value that is not a code point never matches, which leaves the delimiter empty
+  int32_t length = 0;
+  UBool error = false;
+  U8_APPEND(result._encoded, length, 4, static_cast<UChar32>(delimiter), error);
+  result._delimiter = view(nullptr, error ? 0 : static_cast<size_type>(length));
+  return result;
+}
+
+ustring::split_view ustring::lazy_split(char32_t delimiter) const & noexcept
+{
+  return to_view().lazy_split(delimiter);
+}
+
+ustring::split_view ustring::view::lazy_split(const view &delimiter) const noexcept
+{
+  split_view result(*this, split_view::Kind::DELIMITER);
+  result._delimiter = delimiter;
+  return result;
+}
+
+ustring::split_view ustring::lazy_split(const view &delimiter) const & noexcept
+{
+  return to_view().lazy_split(delimiter);
+}
+
+ustring::split_view ustring::view::lines() const noexcept
+{
+  return split_view(*this, split_view::Kind::LINES);
+}
+
+ustring::split_view ustring::lines() const & noexcept
+{
+  return to_view().lines();
+}
+
+ustring::split_view ustring::view::chunks(size_type n) const noexcept
+{
+  split_view result(*this, split_view::Kind::CHUNKS);
+  result._chunk_size = n;
+  return result;
+}
+
+ustring::split_view ustring::chunks(size_type n) const & noexcept
+{
+  return to_view().chunks(n);
+}
+
+bool ustring::split_view::next_piece(size_type start, view &piece, size_type &next) const noexcept
+{
+  const size_type size = _text.size();
+  if (start >= size) {
+    return false;
+  }
+
+  const value_type *text = _text.data() + start;
+  const size_type rest = size - start;
+  size_type length = rest;
+  size_type skip = 0;
+  switch (_kind) {
+    case Kind::CODE_POINT:
+    case Kind::DELIMITER: {
+      const value_type *delimiter = _kind == Kind::CODE_POINT ? _encoded : _delimiter.data();
+      if (_delimiter.empty()) {
+        if (_kind == Kind::DELIMITER) {
+          return false;
+        }
+        break;
+      }
+      const size_t offset = ustring_simd::find(text, rest, delimiter, _delimiter.size());
+      if (offset != ustring_simd::not_found) {
+        length = static_cast<size_type>(offset);
+        skip = _delimiter.size();
+      }
+      break;
+    }
+    case Kind::LINES: {
+      static const ustring_simd::byte_set line_breaks(u8"\n\r", 2);
+      const size_t offset = ustring_simd::find_first_of(text, rest, line_breaks);
+      if (offset != ustring_simd::not_found) {
+        length = static_cast<size_type>(offset);
+        skip = text[offset] == u8'\r' && length + 1 < rest && text[offset + 1] == u8'\n' ? 2 : 1;
+      }
+      break;
+    }
+    case Kind::CHUNKS: {
+      if (_chunk_size == 0) {
+        return false;
+      }
+      length = 0;
+      for (size_type n = 0; n < _chunk_size && length < rest; ++n) {
+        ++length;
+        while (length < rest && (text[length] & 0xC0) == 0x80) {
+          ++length;
+        }
+      }
+      break;
+    }
+  }
+
+  piece = view(text, length);
+  next = start + length + skip;
+  return true;
+}
+
+ustring::split_view::iterator::iterator(const split_view *parent, size_type start)
+{
+  if (parent->next_piece(start, _piece, _next)) {
+    _parent = parent;
+  }
+}
+
+ustring::split_view::iterator &ustring::split_view::iterator::operator++()
+{
+  if (!_parent->next_piece(_next, _piece, _next)) {
+    *this = iterator();
+  }
+  return *this;
+}
+
+ustring::split_view::iterator ustring::split_view::iterator::operator++(int)
+{
+  iterator tmp(*this);
+  ++*this;
+  return tmp;
+}
+
 std::vector<ustring::view> ustring::view::split_words(const char *locale) const
 {
   if (!locale) {
@@ -3281,18 +3922,22 @@ std::vector<ustring::view> ustring::view::split_words(const char *locale) const
   std::vector<view> result;
 
   UErrorCode status = U_ZERO_ERROR;
-  icu::BreakIterator *bi = icu::BreakIterator::createWordInstance(
-      icu::Locale::getUS() /* todo: other according to locale */, status);
+  borrowed_break_iterator borrowed(UBRK_WORD, locale, status);
+  UBreakIterator *bi = borrowed.get();
+  if (!bi)
+    return result;
+
+  // boundaries of UTF-8 text are byte offsets
+  UText text = UTEXT_INITIALIZER;
+  utext_openUTF8(&text, reinterpret_cast<const char *>(data()), size(), &status);
+  ubrk_setUText(bi, &text, &status);
   if (U_SUCCESS(status)) {
-    icu::UnicodeString ustr = icu::UnicodeString::fromUTF8(
-        icu::StringPiece(reinterpret_cast<const char *>(data()), size()));
-    bi->setText(ustr);
-    int32_t start = bi->first();
-    for (int32_t end = bi->next(); end != icu::BreakIterator::DONE; start = end, end = bi->next())
-    {
+    int32_t start = ubrk_first(bi);
+    for (int32_t end = ubrk_next(bi); end != UBRK_DONE; start = end, end = ubrk_next(bi)) {
       result.emplace_back(data() + start, end - start);
     }
   }
+  utext_close(&text);
 
   return result;
 }
@@ -3449,6 +4094,11 @@ ustring::code_point_iterator ustring::code_point_iterator::operator-(size_t step
 ustring::grapheme_iterator::grapheme_iterator(const ustring &str,
                                               size_type pos,
                                               const char *locale)
+    : grapheme_iterator(str.to_view(), pos, locale)
+{
+}
+
+ustring::grapheme_iterator::grapheme_iterator(const view &str, size_type pos, const char *locale)
     : _view(str.data() + pos, 0),
       _end(str.data() + str.size()),
       _start(str.data()),
@@ -3456,7 +4106,7 @@ ustring::grapheme_iterator::grapheme_iterator(const ustring &str,
       _text(nullptr)
 {
   UErrorCode status = U_ZERO_ERROR;
-  _break_iterator = ubrk_open(UBRK_CHARACTER, locale, nullptr, 0, &status);
+  _break_iterator = _open_break_iterator(UBRK_CHARACTER, locale, status);
   if (!U_SUCCESS(status)) {
     throw "Failed to create grapheme iterator";
   }
@@ -3727,6 +4377,14 @@ ustring::word_iterator::word_iterator(const ustring &str,
                                       size_type pos,
                                       const char *locale,
                                       WordBreak break_type)
+    : word_iterator(str.to_view(), pos, locale, break_type)
+{
+}
+
+ustring::word_iterator::word_iterator(const view &str,
+                                      size_type pos,
+                                      const char *locale,
+                                      WordBreak break_type)
     : _view(str.data() + pos, 0),
       _end(str.data() + str.size()),
       _start(str.data()),
@@ -3734,7 +4392,7 @@ ustring::word_iterator::word_iterator(const ustring &str,
       _text(nullptr)
 {
   UErrorCode status = U_ZERO_ERROR;
-  _break_iterator = ubrk_open(UBRK_WORD, locale, nullptr, 0, &status);
+  _break_iterator = _open_break_iterator(UBRK_WORD, locale, status);
   if (!U_SUCCESS(status)) {
     throw "Failed to create word iterator";
   }
@@ -4023,6 +4681,11 @@ ustring::word_iterator ustring::word_iterator::operator--(int)
 ustring::sentence_iterator::sentence_iterator(const ustring &str,
                                               size_type pos,
                                               const char *locale)
+    : sentence_iterator(str.to_view(), pos, locale)
+{
+}
+
+ustring::sentence_iterator::sentence_iterator(const view &str, size_type pos, const char *locale)
     : _view(str.data() + pos, 0),
       _end(str.data() + str.size()),
       _start(str.data()),
@@ -4030,7 +4693,7 @@ ustring::sentence_iterator::sentence_iterator(const ustring &str,
       _text(nullptr)
 {
   UErrorCode status = U_ZERO_ERROR;
-  _break_iterator = ubrk_open(UBRK_SENTENCE, locale, nullptr, 0, &status);
+  _break_iterator = _open_break_iterator(UBRK_SENTENCE, locale, status);
   if (!U_SUCCESS(status)) {
     throw "Failed to create sentence iterator";
   }
@@ -4439,78 +5102,6 @@ ustring::code_point_iterator ustring::sentence_iterator::code_points_end() const
   return code_point_iterator(_view, _view.size());
 }
 
-// Add view constructor for grapheme_iterator
-ustring::grapheme_iterator::grapheme_iterator(const view &v, size_type pos, const char *locale)
-{
-  _start = v.data();
-  _end = v.data() + v.size();
-  _break_iterator = nullptr;
-  _text = nullptr;
-
-  UErrorCode status = U_ZERO_ERROR;
-  _break_iterator = ubrk_open(UBRK_CHARACTER,
-                              locale ? locale : "en",
-                              reinterpret_cast<const UChar *>(_start),
-                              static_cast<int32_t>(_end - _start),
-                              &status);
-
-  if (U_SUCCESS(status)) {
-    if (pos > 0) {
-      ubrk_following(static_cast<UBreakIterator *>(_break_iterator), static_cast<int32_t>(pos));
-    }
-    _view = view(_start + pos, 0);
-  }
-}
-
-// Add view constructor for word_iterator
-ustring::word_iterator::word_iterator(const view &v,
-                                      size_type pos,
-                                      const char *locale,
-                                      WordBreak break_type)
-{
-  _start = v.data();
-  _end = v.data() + v.size();
-  _break_iterator = nullptr;
-  _text = nullptr;
-
-  UErrorCode status = U_ZERO_ERROR;
-  _break_iterator = ubrk_open(UBRK_WORD,
-                              locale ? locale : "en",
-                              reinterpret_cast<const UChar *>(_start),
-                              static_cast<int32_t>(_end - _start),
-                              &status);
-
-  if (U_SUCCESS(status)) {
-    if (pos > 0) {
-      ubrk_following(static_cast<UBreakIterator *>(_break_iterator), static_cast<int32_t>(pos));
-    }
-    _view = view(_start + pos, 0);
-  }
-}
-
-// Add view constructor for sentence_iterator
-ustring::sentence_iterator::sentence_iterator(const view &v, size_type pos, const char *locale)
-{
-  _start = v.data();
-  _end = v.data() + v.size();
-  _break_iterator = nullptr;
-  _text = nullptr;
-
-  UErrorCode status = U_ZERO_ERROR;
-  _break_iterator = ubrk_open(UBRK_SENTENCE,
-                              locale ? locale : "en",
-                              reinterpret_cast<const UChar *>(_start),
-                              static_cast<int32_t>(_end - _start),
-                              &status);
-
-  if (U_SUCCESS(status)) {
-    if (pos > 0) {
-      ubrk_following(static_cast<UBreakIterator *>(_break_iterator), static_cast<int32_t>(pos));
-    }
-    _view = view(_start + pos, 0);
-  }
-}
-
 // Grapheme iterator arithmetic operators
 ustring::grapheme_iterator &ustring::grapheme_iterator::operator+=(difference_type n) {
   if (n > 0) {
@@ -4663,3 +5254,124 @@ ustring::sentence_iterator::operator-(const sentence_iterator &other) const {
 std::strong_ordering ustring::sentence_iterator::operator<=>(const sentence_iterator &other) const {
   return _view.data() <=> other._view.data();
 }
+
+namespace {
+
+// Appends the grapheme boundaries after 0 of the text `bi` is set to. Two ASCII characters in a
+// row are always in different graphemes unless they are CR LF, so ICU only sees the rest.
+void _grapheme_breaks(UBreakIterator *bi,
+                      const ustring::value_type *data,
+                      int32_t size,
+                      std::vector<uint32_t> &out)
+{
+  int32_t pos = 0;
+  while (pos < size) {
+    if (data[pos] < 0x80 && pos + 1 < size && data[pos + 1] < 0x80) {
+      pos += data[pos] == '\r' && data[pos + 1] == '\n' ? 2 : 1;
+    }
+    else {
+      pos = ubrk_following(bi, pos);
+    }
+    out.push_back(static_cast<uint32_t>(pos));
+  }
+}
+
+void _next_breaks(UBreakIterator *bi, std::vector<uint32_t> &out)
+{
+  for (int32_t pos = ubrk_next(bi); pos != UBRK_DONE; pos = ubrk_next(bi)) {
+    out.push_back(static_cast<uint32_t>(pos));
+  }
+}
+
+}  // namespace
+
+ustring::breaks_index::breaks_index(const view &text, BreakType types, const char *locale)
+    : _text(text)
+{
+  // boundaries of UTF-8 text are byte offsets
+  UErrorCode status = U_ZERO_ERROR;
+  UText utext = UTEXT_INITIALIZER;
+  utext_openUTF8(&utext, reinterpret_cast<const char *>(text.data()), text.size(), &status);
+  if (U_FAILURE(status)) {
+    throw "Failed to open utf-8 string";
+  }
+
+  const auto wanted = [types](BreakType type) {
+    return (static_cast<uint8_t>(types) & static_cast<uint8_t>(type)) != 0;
+  };
+  const std::pair<BreakType, UBreakIteratorType> passes[] = {
+      {BreakType::GRAPHEME, UBRK_CHARACTER},
+      {BreakType::WORD, UBRK_WORD},
+      {BreakType::SENTENCE, UBRK_SENTENCE},
+  };
+  for (const auto &[type, icu_type] : passes) {
+    if (!wanted(type))
+      continue;
+
+    borrowed_break_iterator borrowed(icu_type, locale, status);
+    UBreakIterator *bi = borrowed.get();
+    if (bi) {
+      ubrk_setUText(bi, &utext, &status);
+    }
+    if (!bi || U_FAILURE(status)) {
+      utext_close(&utext);
+      throw "Failed to create break iterator";
+    }
+
+    std::vector<uint32_t> &out = type == BreakType::GRAPHEME ? _graphemes
+                                 : type == BreakType::WORD   ? _words
+                                                             : _sentences;
+    out.push_back(0);
+    if (type == BreakType::GRAPHEME) {
+      out.reserve(ustring_simd::count_code_points(text.data(), text.size()) + 1);
+      _grapheme_breaks(bi, text.data(), text.size(), out);
+    }
+    else {
+      _next_breaks(bi, out);
+      out.shrink_to_fit();
+    }
+  }
+  utext_close(&utext);
+}
+
+std::span<const uint32_t> ustring::breaks_index::boundaries(BreakType type) const noexcept
+{
+  switch (type) {
+    case BreakType::GRAPHEME:
+      return _graphemes;
+    case BreakType::WORD:
+      return _words;
+    case BreakType::SENTENCE:
+      return _sentences;
+    default:
+      return {};
+  }
+}
+
+ustring::breaks_index::iterator ustring::breaks_index::segment_at(BreakType type,
+                                                                  size_type pos) const noexcept
+{
+  std::span<const uint32_t> b = boundaries(type);
+  if (pos < 0 || pos >= _text.size() || b.empty()) {
+    return end(type);
+  }
+  // the last boundary not after `pos`
+  auto next = std::upper_bound(b.begin(), b.end(), static_cast<uint32_t>(pos));
+  return iterator(_text.data(), b.data() + (next - b.begin()) - 1);
+}
+
+bool ustring::breaks_index::is_boundary(BreakType type, size_type pos) const noexcept
+{
+  std::span<const uint32_t> b = boundaries(type);
+  return pos >= 0 && std::binary_search(b.begin(), b.end(), static_cast<uint32_t>(pos));
+}
+
+ustring::breaks_index ustring::view::breaks(BreakType types, const char *locale) const
+{
+  return breaks_index(*this, types, locale);
+}
+
+ustring::breaks_index ustring::breaks(BreakType types, const char *locale) const &
+{
+  return breaks_index(to_view(), types, locale);
+}
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstring>
 #include <filesystem>
 #include <format>
 #include <functional>
+#include <memory_resource>
 #include <numeric>
 #include <optional>
 #include <ranges>
@@ -18,6 +20,7 @@
 #include <vector>
 
 #include "compiler_features.h"
+#include "ustring_simd_types.h"
 
 enum class CharProperty : uint32_t {
   NONE = 0,
@@ -57,6 +60,11 @@ enum class CharProperty : uint32_t {
   // PRIVATE_USE = 1 << 31
 };
 
+constexpr CharProperty operator|(CharProperty a, CharProperty b)
+{
+  return static_cast<CharProperty>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+}
+
 bool has_property(std::u8string_view str, CharProperty property);
 bool has_property(const char8_t *str, CharProperty property);
 bool has_property(char32_t codepoint, CharProperty property);
@@ -141,6 +149,19 @@ enum class WordBreak {
   UBRK_WORD_IDEO_LIMIT = 500
 };
 
+// Segmentations a ustring::breaks_index can hold, combined with |
+enum class BreakType : uint8_t {
+  GRAPHEME = 1 << 0,
+  WORD = 1 << 1,
+  SENTENCE = 1 << 2,
+  ALL = GRAPHEME | WORD | SENTENCE
+};
+
+constexpr BreakType operator|(BreakType a, BreakType b)
+{
+  return static_cast<BreakType>(static_cast<uint8_t>(a) | static_cast<uint8_t>(b));
+}
+
 std::string to_utf8(char32_t codepoint);
 std::string to_utf16(char32_t codepoint);
 std::string to_utf32(char32_t codepoint);
@@ -209,6 +230,8 @@ enum class ToTitleOptions : uint32_t {
   ADJUST_TO_CASED = 0x400
 };
 
+class shared_ustring;
+
 class ustring {
  public:
   using value_type = char8_t;
@@ -227,6 +250,10 @@ class ustring {
   class grapheme_iterator;
   class word_iterator;
   class sentence_iterator;
+  class searcher;
+  class hasher;
+  class split_view;
+  class breaks_index;
 
   class view {
    public:
@@ -245,6 +272,36 @@ class ustring {
     view() noexcept : _data(nullptr), _size(0) {}
     view(const ustring &str) noexcept : _data(str.data()), _size(str.size()) {}
     view(const value_type *str, size_type len) noexcept : _data(str), _size(len) {}
+    explicit view(std::string_view str) noexcept
+        : _data(reinterpret_cast<const value_type *>(str.data())),
+          _size(static_cast<size_type>(str.size()))
+    {
+    }
+    explicit view(std::u8string_view str) noexcept
+        : _data(str.data()), _size(static_cast<size_type>(str.size()))
+    {
+    }
+
+    // Types whose UTF-8 bytes can be viewed without a copy: ustring and anything convertible to
+    // std::string_view or std::u8string_view
+    template<typename T>
+    static constexpr bool is_byte_source = std::convertible_to<T, view> ||
+                                           std::convertible_to<T, std::string_view> ||
+                                           std::convertible_to<T, std::u8string_view>;
+    template<typename T>
+      requires is_byte_source<T>
+    [[nodiscard]] static view of(const T &str) noexcept
+    {
+      if constexpr (std::convertible_to<const T &, view>) {
+        return str;
+      }
+      else if constexpr (std::convertible_to<const T &, std::u8string_view>) {
+        return view(std::u8string_view(str));
+      }
+      else {
+        return view(std::string_view(str));
+      }
+    }
 
     bool operator==(const char *rhs) const noexcept;
     std::strong_ordering operator<=>(const char *rhs) const noexcept;
@@ -254,19 +311,25 @@ class ustring {
     std::strong_ordering operator<=>(const char16_t *rhs) const noexcept;
     bool operator==(const char32_t *rhs) const noexcept;
     std::strong_ordering operator<=>(const char32_t *rhs) const noexcept;
+    bool operator==(std::string_view rhs) const noexcept;
+    std::strong_ordering operator<=>(std::string_view rhs) const noexcept;
+    bool operator==(std::u8string_view rhs) const noexcept;
+    std::strong_ordering operator<=>(std::u8string_view rhs) const noexcept;
     friend bool operator==(const view &lhs, const view &rhs) noexcept;
     friend std::strong_ordering operator<=>(const view &lhs, const view &rhs) noexcept;
+    // Byte sources (ustring, std::string, ...) are compared in place. A view itself must not match
+    // here, or comparing with a temporary view would pick this overload again and recurse.
     template<typename T>
-      requires std::convertible_to<T, view>
+      requires(!std::same_as<std::remove_cvref_t<T>, view> && is_byte_source<T>)
     friend bool operator==(const view &lhs, T &&rhs) noexcept
     {
-      return lhs == view(std::forward<T>(rhs));
+      return lhs == static_cast<const view &>(of(rhs));
     }
     template<typename T>
-      requires std::convertible_to<T, view>
-    friend std::strong_ordering operator<=>(const view &lhs, const T *rhs) noexcept
+      requires(!std::same_as<std::remove_cvref_t<T>, view> && is_byte_source<T>)
+    friend std::strong_ordering operator<=>(const view &lhs, T &&rhs) noexcept
     {
-      return lhs <=> view(std::forward<T>(rhs));
+      return lhs <=> static_cast<const view &>(of(rhs));
     }
 
     friend ustring operator+(const ustring &lhs, const ustring &rhs);
@@ -348,10 +411,16 @@ class ustring {
 
     [[nodiscard]] size_type length() const noexcept;
 
+    // Seeded 64-bit hash of the bytes, the same on every platform. hash() is hash64(0).
+    [[nodiscard]] uint64_t hash64(uint64_t seed = 0) const noexcept;
     [[nodiscard]] size_t hash() const noexcept
     {
-      return std::hash<std::u8string_view>{}(std::u8string_view(data(), size()));
+      return static_cast<size_t>(hash64());
     }
+    // Hash of the NFKC_Casefold form, equal for strings that equals_folded() considers equal
+    [[nodiscard]] uint64_t hash64_folded(uint64_t seed = 0) const;
+    // Equality ignoring case and compatibility differences (NFKC_Casefold)
+    [[nodiscard]] bool equals_folded(const view &other) const;
 
     [[nodiscard]] ustring copy() const;
     [[nodiscard]] size_type copy(value_type *dest, size_type n, size_type pos = 0) const;
@@ -359,15 +428,18 @@ class ustring {
     [[nodiscard]] view substr_view(size_type pos = 0, size_type n = npos) const;
 
     [[nodiscard]] size_type find(const ustring &str, size_type pos = 0) const noexcept;
+    [[nodiscard]] size_type find(const searcher &s, size_type pos = 0) const noexcept;
     [[nodiscard]] size_type find(const value_type *s, size_type pos, size_type n) const;
     [[nodiscard]] size_type find(const value_type *s, size_type pos = 0) const;
     [[nodiscard]] size_type find(value_type c, size_type pos = 0) const noexcept;
 
     [[nodiscard]] size_type rfind(const ustring &str, size_type pos = npos) const noexcept;
+    [[nodiscard]] size_type rfind(const searcher &s, size_type pos = npos) const noexcept;
     [[nodiscard]] size_type rfind(const value_type *s, size_type pos, size_type n) const;
     [[nodiscard]] size_type rfind(const value_type *s, size_type pos = npos) const;
     [[nodiscard]] size_type rfind(value_type c, size_type pos = npos) const noexcept;
 
+    // Like std::basic_string, the *_of searches match single bytes of the set
     [[nodiscard]] size_type find_first_of(const ustring &str, size_type pos = 0) const noexcept;
     [[nodiscard]] size_type find_first_of(const value_type *s, size_type pos, size_type n) const;
     [[nodiscard]] size_type find_first_of(const value_type *s, size_type pos = 0) const;
@@ -394,16 +466,50 @@ class ustring {
     [[nodiscard]] size_type find_last_not_of(const value_type *s, size_type pos = npos) const;
     [[nodiscard]] size_type find_last_not_of(value_type c, size_type pos = npos) const noexcept;
 
+    // Offset of the first code point at or after `pos` that has any of the properties in
+    // `property`, or none of them, or npos. Ill-formed bytes have no properties.
+    [[nodiscard]] size_type find_first_property(CharProperty property,
+                                                size_type pos = 0) const noexcept;
+    [[nodiscard]] size_type find_first_not_property(CharProperty property,
+                                                    size_type pos = 0) const noexcept;
+    // Code points that have any of the properties in `property`
+    [[nodiscard]] size_t count_property(CharProperty property) const noexcept;
+
     [[nodiscard]] size_t count(const ustring &str) const noexcept;
+    [[nodiscard]] size_t count(const searcher &s) const noexcept;
     [[nodiscard]] size_t count(const value_type *s) const;
+    [[nodiscard]] size_t count(const value_type *s, size_type n) const noexcept;
     [[nodiscard]] size_t count(char32_t c) const;
     [[nodiscard]] size_t count(std::function<bool(char32_t)> f) const;
+    // Code points for which `pred` holds. Unlike the std::function overload, the predicate is
+    // called directly from the decode loop and can be inlined into it.
+    template<typename Pred>
+      requires std::predicate<Pred &, char32_t>
+    [[nodiscard]] size_t count(Pred &&pred) const
+    {
+      size_t n = 0;
+      for (size_t pos = 0; pos < static_cast<size_t>(_size);) {
+        n += static_cast<bool>(pred(ustring_simd::next_code_point(_data, pos, _size)));
+      }
+      return n;
+    }
 
     [[nodiscard]] bool contains(const ustring &str) const noexcept;
     [[nodiscard]] bool contains(const value_type *s) const;
     [[nodiscard]] bool contains(char32_t c) const noexcept;
     [[nodiscard]] bool contains(value_type c) const noexcept;
     [[nodiscard]] bool contains(std::function<bool(char32_t)> f) const;
+    template<typename Pred>
+      requires std::predicate<Pred &, char32_t>
+    [[nodiscard]] bool contains(Pred &&pred) const
+    {
+      for (size_t pos = 0; pos < static_cast<size_t>(_size);) {
+        if (pred(ustring_simd::next_code_point(_data, pos, _size))) {
+          return true;
+        }
+      }
+      return false;
+    }
 
     [[nodiscard]] int compare(const ustring &str) const noexcept;
     [[nodiscard]] int compare(size_type pos1, size_type n1, const ustring &str) const;
@@ -472,8 +578,21 @@ class ustring {
     [[nodiscard]] std::vector<view> split(char32_t delimiter) const;
     [[nodiscard]] std::vector<view> split(std::unordered_set<char32_t> &&delimiter) const;
     [[nodiscard]] std::vector<view> split(const ustring &delimiter) const;
+    [[nodiscard]] std::vector<view> split(const searcher &delimiter) const;
     [[nodiscard]] std::vector<view> split_words(const char *locale) const;
 
+    // Lazy counterparts of split(). The delimiter view must outlive the returned range.
+    [[nodiscard]] split_view lazy_split(char32_t delimiter) const noexcept;
+    [[nodiscard]] split_view lazy_split(const view &delimiter) const noexcept;
+    // Lines ended by "\n", "\r\n" or "\r", without their line break
+    [[nodiscard]] split_view lines() const noexcept;
+    // Consecutive pieces of `n` code points, the last one possibly shorter
+    [[nodiscard]] split_view chunks(size_type n) const noexcept;
+
+    // Boundaries of the given segmentations, found once for random access and offset lookup
+    [[nodiscard]] breaks_index breaks(BreakType types = BreakType::ALL,
+                                      const char *locale = nullptr) const;
+
    private:
     const value_type *_data;
     size_type _size;
@@ -786,9 +905,277 @@ class ustring {
     void *_text;            // UText*
   };
 
+  // A needle compiled once for repeated searches, in the spirit of
+  // std::boyer_moore_horspool_searcher. It keeps its own copy of the needle and is never
+  // modified after construction, so one instance can be shared between threads.
+  class searcher {
+   public:
+    explicit searcher(const view &needle);
+    explicit searcher(const ustring &needle);
+
+    [[nodiscard]] view needle() const noexcept
+    {
+      return view(_needle.data(), static_cast<size_type>(_needle.size()));
+    }
+    [[nodiscard]] size_type size() const noexcept
+    {
+      return static_cast<size_type>(_needle.size());
+    }
+
+    [[nodiscard]] size_type find(const view &text, size_type pos = 0) const noexcept;
+    [[nodiscard]] size_type rfind(const view &text, size_type pos = npos) const noexcept;
+
+    // For std::search
+    [[nodiscard]] std::pair<const value_type *, const value_type *> operator()(
+        const value_type *first, const value_type *last) const noexcept;
+
+   private:
+    std::u8string _needle;
+    ustring_simd::needle_plan _plan;
+  };
+
+  // Incremental hash64(): feeding the same bytes in any number of pieces gives the same digest,
+  // e.g. to hash a composite key without concatenating it.
+  class hasher {
+   public:
+    explicit hasher(uint64_t seed = 0) noexcept;
+
+    hasher &update(const view &piece) noexcept;
+    [[nodiscard]] uint64_t digest() const noexcept;
+
+   private:
+    ustring_simd::hash_state _state;
+  };
+
+  // Forward range of the pieces of a view, found one at a time as the range is iterated. The
+  // pieces point into the original text, so iterating never allocates. Like split(), a leading
+  // empty piece is kept and a trailing one is dropped.
+  class split_view : public std::ranges::view_interface<split_view> {
+   public:
+    class iterator {
+     public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = view;
+      using difference_type = ptrdiff_t;
+      using pointer = const view *;
+      using reference = const view &;
+
+      iterator() = default;
+
+      reference operator*() const
+      {
+        return _piece;
+      }
+      pointer operator->() const
+      {
+        return &_piece;
+      }
+      iterator &operator++();
+      iterator operator++(int);
+      bool operator==(const iterator &other) const
+      {
+        return _piece.data() == other._piece.data() && _next == other._next;
+      }
+      bool operator==(std::default_sentinel_t) const
+      {
+        return _parent == nullptr;
+      }
+
+     private:
+      friend class split_view;
+      iterator(const split_view *parent, size_type start);
+
+      const split_view *_parent = nullptr;
+      view _piece;
+      size_type _next = 0;  // where the piece after this one starts
+    };
+
+    split_view() = default;
+
+    [[nodiscard]] iterator begin() const
+    {
+      return iterator(this, 0);
+    }
+    [[nodiscard]] std::default_sentinel_t end() const noexcept
+    {
+      return {};
+    }
+
+   private:
+    friend class view;
+
+    enum class Kind : uint8_t { CODE_POINT, DELIMITER, LINES, CHUNKS };
+
+    split_view(const view &text, Kind kind) noexcept : _text(text), _kind(kind) {}
+    // Finds the piece starting at `start`, or returns false past the end of the text
+    bool next_piece(size_type start, view &piece, size_type &next) const noexcept;
+
+    view _text;
+    view _delimiter;
+    value_type _encoded[4] = {};  // a CODE_POINT delimiter in UTF-8, not in _delimiter so copies stay valid
+    size_type _chunk_size = 0;
+    Kind _kind = Kind::DELIMITER;
+  };
+
+  // Grapheme, word and sentence boundaries of a text, found with one pass of the break iterator
+  // per segmentation and kept as byte offsets. Walking, indexing and looking up segments by
+  // offset then never goes back to ICU. The text must outlive the index.
+  class breaks_index {
+   public:
+    // The segments of one segmentation. Only a pointer to the text and one to the boundary the
+    // segment starts at, so all of the random access operations are constant time.
+    class iterator {
+     public:
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type = view;
+      using difference_type = ptrdiff_t;
+      using pointer = void;
+      using reference = view;
+
+      iterator() = default;
+
+      reference operator*() const noexcept
+      {
+        return view(_text + _boundary[0], static_cast<size_type>(_boundary[1] - _boundary[0]));
+      }
+      reference operator[](difference_type n) const noexcept
+      {
+        return *(*this + n);
+      }
+      // Byte offset of the segment in the text
+      [[nodiscard]] size_type position() const noexcept
+      {
+        return static_cast<size_type>(_boundary[0]);
+      }
+
+      iterator &operator++() noexcept
+      {
+        ++_boundary;
+        return *this;
+      }
+      iterator operator++(int) noexcept
+      {
+        return iterator(_text, _boundary++);
+      }
+      iterator &operator--() noexcept
+      {
+        --_boundary;
+        return *this;
+      }
+      iterator operator--(int) noexcept
+      {
+        return iterator(_text, _boundary--);
+      }
+      iterator &operator+=(difference_type n) noexcept
+      {
+        _boundary += n;
+        return *this;
+      }
+      iterator &operator-=(difference_type n) noexcept
+      {
+        _boundary -= n;
+        return *this;
+      }
+      friend iterator operator+(iterator it, difference_type n) noexcept
+      {
+        return it += n;
+      }
+      friend iterator operator+(difference_type n, iterator it) noexcept
+      {
+        return it += n;
+      }
+      friend iterator operator-(iterator it, difference_type n) noexcept
+      {
+        return it -= n;
+      }
+      friend difference_type operator-(const iterator &a, const iterator &b) noexcept
+      {
+        return a._boundary - b._boundary;
+      }
+      bool operator==(const iterator &other) const noexcept
+      {
+        return _boundary == other._boundary;
+      }
+      std::strong_ordering operator<=>(const iterator &other) const noexcept
+      {
+        return _boundary <=> other._boundary;
+      }
+
+     private:
+      friend class breaks_index;
+      iterator(const ustring::value_type *text, const uint32_t *boundary) noexcept
+          : _text(text), _boundary(boundary)
+      {
+      }
+
+      const ustring::value_type *_text = nullptr;
+      const uint32_t *_boundary = nullptr;
+    };
+
+    breaks_index() = default;
+    explicit breaks_index(const view &text,
+                          BreakType types = BreakType::ALL,
+                          const char *locale = nullptr);
+
+    [[nodiscard]] view text() const noexcept
+    {
+      return _text;
+    }
+    // Whether the index was built for `type`. The segmentations it was not built for are empty.
+    [[nodiscard]] bool has(BreakType type) const noexcept
+    {
+      return !boundaries(type).empty();
+    }
+    // Byte offsets of the boundaries of `type`, from 0 up to the size of the text
+    [[nodiscard]] std::span<const uint32_t> boundaries(BreakType type) const noexcept;
+
+    [[nodiscard]] iterator begin(BreakType type) const noexcept
+    {
+      return iterator(_text.data(), boundaries(type).data());
+    }
+    [[nodiscard]] iterator end(BreakType type) const noexcept
+    {
+      std::span<const uint32_t> b = boundaries(type);
+      return iterator(_text.data(), b.empty() ? b.data() : b.data() + b.size() - 1);
+    }
+    [[nodiscard]] auto segments(BreakType type) const noexcept
+    {
+      return std::ranges::subrange<iterator>(begin(type), end(type));
+    }
+    [[nodiscard]] size_type count(BreakType type) const noexcept
+    {
+      return static_cast<size_type>(end(type) - begin(type));
+    }
+
+    // The segment that contains byte `pos`, or end(type) if `pos` is outside the text
+    [[nodiscard]] iterator segment_at(BreakType type, size_type pos) const noexcept;
+    [[nodiscard]] bool is_boundary(BreakType type, size_type pos) const noexcept;
+
+   private:
+    view _text;
+    std::vector<uint32_t> _graphemes;
+    std::vector<uint32_t> _words;
+    std::vector<uint32_t> _sentences;
+  };
+
   static constexpr size_type npos = -1;
   static constexpr size_type max_pos = std::numeric_limits<size_type>::max();
-  static constexpr size_type default_size = static_cast<size_type>(12);
+  static constexpr size_type default_size = static_cast<size_type>(23);  // inline capacity
+
+  // How the buffer grows when append, insert, push_back or resize outgrow it. reserve() and
+  // shrink_to_fit() are not affected and allocate exactly what they are asked for.
+  struct growth_policy {
+    enum class Factor : uint8_t { ONE_AND_A_HALF, DOUBLE };
+
+    Factor factor = Factor::ONE_AND_A_HALF;
+    // Round capacities up to the allocator's size classes (those of mimalloc: 8 byte steps up
+    // to 64, then four per power of two), so bytes the allocator would waste become capacity
+    bool size_classes = true;
+  };
+
+  // Process-wide, read once per reallocation
+  static void set_growth_policy(growth_policy policy) noexcept;
+  [[nodiscard]] static growth_policy get_growth_policy() noexcept;
 
   ustring();
   ustring(const ustring &other);
@@ -825,6 +1212,16 @@ class ustring {
   explicit ustring(size_type n, const char8_t *base_str);
   explicit ustring(size_type n, const ustring &base_str);
 
+  // Strings built with a memory resource take every buffer from it and never use the inline
+  // storage, e.g. to free all strings of a request with one std::pmr::monotonic_buffer_resource.
+  // As with std::pmr containers, the copy constructor goes back to new[], while assignment and
+  // swap keep each string's own resource. Moving takes the resource along and leaves an empty
+  // string using new[] behind. A null resource means new[].
+  explicit ustring(std::pmr::memory_resource *resource);
+  ustring(view other, std::pmr::memory_resource *resource);
+  ustring(const char *s, std::pmr::memory_resource *resource);
+  ustring(const char8_t *s, std::pmr::memory_resource *resource);
+
   ~ustring();
 
   template<class T> ustring &operator=(T &&other)
@@ -853,6 +1250,9 @@ class ustring {
   ustring &from_utf16(const char16_t *str, size_t size);
   ustring &from_utf32(const char32_t *str, size_t size);
 
+  // Returns the byte offset of the first ill-formed UTF-8 sequence in `str`, or npos if it is valid.
+  [[nodiscard]] static size_type validate_utf8(std::u8string_view str) noexcept;
+
   [[nodiscard]] view to_view() const &;
   [[nodiscard]] view to_view(size_type left) const &;
   [[nodiscard]] view to_view(size_type left, size_type size) const &;
@@ -900,6 +1300,8 @@ class ustring {
   void clear() noexcept;
 
   [[nodiscard]] size_type length() const noexcept;
+  // The resource the string allocates from, null for new[]
+  [[nodiscard]] std::pmr::memory_resource *resource() const noexcept;
 
   [[nodiscard]] reference operator[](size_type pos);
   [[nodiscard]] const_reference operator[](size_type pos) const;
@@ -952,7 +1354,7 @@ class ustring {
   {
     size_type offset = pos - cbegin();
 #ifdef _DEBUG
-    if (offset > _size) {
+    if (offset > size()) {
       throw std::out_of_range("insert position out of range");
     }
 #endif
@@ -973,19 +1375,25 @@ class ustring {
 
   void resize(size_type n);
   void resize(size_type n, value_type c);
-  void swap(ustring &other) noexcept;
+  // Allocates, and so may throw, only when the two strings use different memory resources
+  void swap(ustring &other);
 
   [[nodiscard]] ustring copy() const;
   [[nodiscard]] size_type copy(value_type *dest, size_type n, size_type pos = 0) const;
+  // An immutable, reference counted copy that is cheap to copy further, see shared_ustring.h
+  [[nodiscard]] shared_ustring shared() const &;
+  [[nodiscard]] shared_ustring shared() &&;
   [[nodiscard]] ustring substr(size_type pos = 0, size_type n = npos) const;
   [[nodiscard]] view substr_view(size_type pos = 0, size_type n = npos) const;
 
   [[nodiscard]] size_type find(const ustring &str, size_type pos = 0) const noexcept;
+  [[nodiscard]] size_type find(const searcher &s, size_type pos = 0) const noexcept;
   [[nodiscard]] size_type find(const value_type *s, size_type pos, size_type n) const;
   [[nodiscard]] size_type find(const value_type *s, size_type pos = 0) const;
   [[nodiscard]] size_type find(value_type c, size_type pos = 0) const noexcept;
 
   [[nodiscard]] size_type rfind(const ustring &str, size_type pos = npos) const noexcept;
+  [[nodiscard]] size_type rfind(const searcher &s, size_type pos = npos) const noexcept;
   [[nodiscard]] size_type rfind(const value_type *s, size_type pos, size_type n) const;
   [[nodiscard]] size_type rfind(const value_type *s, size_type pos = npos) const;
   [[nodiscard]] size_type rfind(value_type c, size_type pos = npos) const noexcept;
@@ -1011,16 +1419,36 @@ class ustring {
   [[nodiscard]] size_type find_last_not_of(const value_type *s, size_type pos = npos) const;
   [[nodiscard]] size_type find_last_not_of(value_type c, size_type pos = npos) const noexcept;
 
+  [[nodiscard]] size_type find_first_property(CharProperty property,
+                                              size_type pos = 0) const noexcept;
+  [[nodiscard]] size_type find_first_not_property(CharProperty property,
+                                                  size_type pos = 0) const noexcept;
+  [[nodiscard]] size_t count_property(CharProperty property) const noexcept;
+
   [[nodiscard]] size_t count(const ustring &str) const noexcept;
+  [[nodiscard]] size_t count(const searcher &s) const noexcept;
   [[nodiscard]] size_t count(const value_type *s) const;
+  [[nodiscard]] size_t count(const value_type *s, size_type n) const noexcept;
   [[nodiscard]] size_t count(char32_t c) const;
   [[nodiscard]] size_t count(std::function<bool(char32_t)> f) const;
+  template<typename Pred>
+    requires std::predicate<Pred &, char32_t>
+  [[nodiscard]] size_t count(Pred &&pred) const
+  {
+    return to_view().count(pred);
+  }
 
   [[nodiscard]] bool contains(const ustring &str) const noexcept;
   [[nodiscard]] bool contains(const value_type *s) const;
   [[nodiscard]] bool contains(char32_t c) const noexcept;
   [[nodiscard]] bool contains(value_type c) const noexcept;
   [[nodiscard]] bool contains(std::function<bool(char32_t)> f) const;
+  template<typename Pred>
+    requires std::predicate<Pred &, char32_t>
+  [[nodiscard]] bool contains(Pred &&pred) const
+  {
+    return to_view().contains(pred);
+  }
 
   [[nodiscard]] int compare(const ustring &str) const noexcept;
   [[nodiscard]] int compare(size_type pos1, size_type n1, const ustring &str) const;
@@ -1038,19 +1466,36 @@ class ustring {
   std::strong_ordering operator<=>(const char16_t *rhs) const noexcept;
   bool operator==(const char32_t *rhs) const noexcept;
   std::strong_ordering operator<=>(const char32_t *rhs) const noexcept;
+  bool operator==(std::string_view rhs) const noexcept;
+  std::strong_ordering operator<=>(std::string_view rhs) const noexcept;
+  bool operator==(std::u8string_view rhs) const noexcept;
+  std::strong_ordering operator<=>(std::u8string_view rhs) const noexcept;
   friend bool operator==(const ustring &lhs, const ustring &rhs) noexcept;
   friend std::strong_ordering operator<=>(const ustring &lhs, const ustring &rhs) noexcept;
+  // Byte sources are compared through a view; only other encodings are converted first
   template<typename T>
-    requires std::convertible_to<T, ustring>
+    requires(!std::same_as<std::remove_cvref_t<T>, view> &&
+             (std::convertible_to<T, ustring> || view::is_byte_source<T>))
   friend bool operator==(const ustring &lhs, T &&rhs) noexcept
   {
-    return lhs == ustring(std::forward<T>(rhs));
+    if constexpr (view::is_byte_source<T>) {
+      return lhs.to_view() == view::of(rhs);
+    }
+    else {
+      return lhs.to_view() == ustring(std::forward<T>(rhs)).to_view();
+    }
   }
   template<typename T>
-    requires std::convertible_to<T, ustring>
-  friend auto operator<=>(const ustring &lhs, const T *rhs) noexcept
+    requires(!std::same_as<std::remove_cvref_t<T>, view> &&
+             (std::convertible_to<T, ustring> || view::is_byte_source<T>))
+  friend std::strong_ordering operator<=>(const ustring &lhs, T &&rhs) noexcept
   {
-    return lhs <=> ustring(std::forward<T>(rhs));
+    if constexpr (view::is_byte_source<T>) {
+      return lhs.to_view() <=> view::of(rhs);
+    }
+    else {
+      return lhs.to_view() <=> ustring(std::forward<T>(rhs)).to_view();
+    }
   }
 
   friend ustring operator+(const ustring &lhs, const ustring &rhs);
@@ -1058,6 +1503,10 @@ class ustring {
   friend ustring operator+(value_type lhs, const ustring &rhs);
   friend ustring operator+(const value_type *lhs, const ustring &rhs);
   friend ustring operator+(const ustring &lhs, const value_type *rhs);
+  // A temporary left operand is appended to in place, so a + b + c + ... reuses one buffer
+  friend ustring operator+(ustring &&lhs, const ustring &rhs);
+  friend ustring operator+(ustring &&lhs, value_type rhs);
+  friend ustring operator+(ustring &&lhs, const value_type *rhs);
 
   [[nodiscard]] bool is_alpha() const noexcept;
   [[nodiscard]] bool is_digit() const noexcept;
@@ -1070,18 +1519,89 @@ class ustring {
 
   ustring &filter(std::function<bool(char32_t, size_type)> &&codepoint_filter);
   ustring &transform(std::function<char32_t(char32_t, size_type)> &&codepoint_transformer);
+  // Template counterparts of the two above, which call the callable from the decode loop instead
+  // of through std::function. Both work in place; transform() moves to a new buffer only once a
+  // result no longer fits in the bytes already read. Ill-formed sequences are passed as U+FFFD.
+  template<typename Pred>
+    requires std::predicate<Pred &, char32_t, size_type>
+  ustring &filter(Pred &&codepoint_filter)
+  {
+    value_type *s = data();
+    const size_t n = size();
+    size_t r = 0, w = 0;
+    for (size_type index = 0; r < n; ++index) {
+      size_t start = r;
+      if (codepoint_filter(ustring_simd::next_code_point(s, r, n), index)) {
+        // at most 4 bytes, and never overlapping backwards
+        while (start < r) {
+          s[w++] = s[start++];
+        }
+      }
+    }
+    set_size(static_cast<size_type>(w));
+    return *this;
+  }
+  template<typename F>
+    requires std::regular_invocable<F &, char32_t, size_type> &&
+             std::convertible_to<std::invoke_result_t<F &, char32_t, size_type>, char32_t>
+  ustring &transform(F &&codepoint_transformer)
+  {
+    value_type *s = data();
+    const size_t n = size();
+    size_t r = 0, w = 0;
+    size_type index = 0;
+    while (r < n) {
+      const char32_t c = codepoint_transformer(ustring_simd::next_code_point(s, r, n), index++);
+      if (w + ustring_simd::code_point_size(c) > r) {
+        // The rest goes to a new buffer, starting with `c`
+        ustring out(resource());
+        out.reserve(static_cast<size_type>(n + (n - r) / 2 + 4));
+        out.append(s, static_cast<size_type>(w));
+        value_type encoded[4];
+        out.append(encoded, static_cast<size_type>(ustring_simd::put_code_point(c, encoded)));
+        while (r < n) {
+          const char32_t next =
+              codepoint_transformer(ustring_simd::next_code_point(s, r, n), index++);
+          out.append(encoded, static_cast<size_type>(ustring_simd::put_code_point(next, encoded)));
+        }
+        return *this = std::move(out);
+      }
+      w += ustring_simd::put_code_point(c, s + w);
+    }
+    set_size(static_cast<size_type>(w));
+    return *this;
+  }
   ustring &to_lower(bool any_lower = false);
   ustring &to_upper(bool any_upper = false);
   ustring &capitalize(const char *locale = nullptr);
   ustring &swap_case();
   ustring &trim();
   ustring &title(const char *locale = nullptr, ToTitleOptions options = ToTitleOptions::DEFAULT);
+  // Removes leading and trailing code points that occur in `ch`
   ustring &strip(const value_type *ch = u8" ");
   ustring &strip(const ustring &ch);
+  ustring &strip(const view &ch);
   ustring &normalize(const NormalizationConfig &config);
 
   ustring filtered(std::function<bool(char32_t, size_type)> &&codepoint_filter) const;
   ustring transformed(std::function<char32_t(char32_t, size_type)> &&codepoint_transformer) const;
+  template<typename Pred>
+    requires std::predicate<Pred &, char32_t, size_type>
+  ustring filtered(Pred &&codepoint_filter) const
+  {
+    ustring ret(*this, resource());
+    ret.filter(codepoint_filter);
+    return ret;
+  }
+  template<typename F>
+    requires std::regular_invocable<F &, char32_t, size_type> &&
+             std::convertible_to<std::invoke_result_t<F &, char32_t, size_type>, char32_t>
+  ustring transformed(F &&codepoint_transformer) const
+  {
+    ustring ret(*this, resource());
+    ret.transform(codepoint_transformer);
+    return ret;
+  }
   ustring lowered(bool any_lower = false) const;
   ustring uppered(bool any_upper = false) const;
   ustring capitalized() const;
@@ -1173,17 +1693,52 @@ class ustring {
   [[nodiscard]] std::vector<view> split(char32_t delimiter) const;
   [[nodiscard]] std::vector<view> split(std::unordered_set<char32_t> &&delimiter) const;
   [[nodiscard]] std::vector<view> split(const ustring &delimiter) const;
+  [[nodiscard]] std::vector<view> split(const searcher &delimiter) const;
   [[nodiscard]] std::vector<view> split_words(const char *locale) const;
 
   // ranges 支持
+  // Pieces that are byte sources are appended without a temporary ustring, and a forward range of
+  // them is measured first, so the result is allocated exactly once
   template<std::ranges::range R>
   [[nodiscard]] static ustring join(R &&range, const ustring &delimiter = ustring())
   {
-    return std::accumulate(
-        std::next(std::begin(range)),
-        std::end(range),
-        *std::begin(range),
-        [&delimiter](ustring a, const auto &b) { return std::move(a) + delimiter + ustring(b); });
+    constexpr bool bytes = view::is_byte_source<std::ranges::range_reference_t<R>>;
+    ustring result;
+    if constexpr (bytes && std::ranges::forward_range<R>) {
+      size_type total = 0;
+      size_type count = 0;
+      for (const auto &piece : range) {
+        total += view::of(piece).size();
+        ++count;
+      }
+      if (count > 1) {
+        total += (count - 1) * delimiter.size();
+      }
+      result.reserve(total);
+    }
+    bool first = true;
+    for (const auto &piece : range) {
+      if (!first) {
+        result.append(delimiter.data(), delimiter.size());
+      }
+      first = false;
+      if constexpr (bytes) {
+        const view v = view::of(piece);
+        result.append(v.data(), v.size());
+      }
+      else {
+        result.append(ustring(piece));
+      }
+    }
+    return result;
+  }
+
+  // Concatenates byte sources (ustrings, views, std::string(_view)s, literals) and single code
+  // units into one allocation sized for the whole result: concat(dir, u8'/', name, ".txt")
+  template<typename... Parts> [[nodiscard]] static ustring concat(const Parts &...parts)
+  {
+    const std::array<view, sizeof...(Parts)> pieces = {concat_piece(parts)...};
+    return concat_views(pieces);
   }
 
   //   template <typename Pred> [[nodiscard]] auto split_if(Pred pred) const {
@@ -1192,21 +1747,20 @@ class ustring {
   //                [](auto &&r) { return ustring(std::string_view(r)); });
   //   }
 
-  //   [[nodiscard]] auto lines() const {
-  //     return split_if([](char32_t c) { return c == '\n' || c == '\r'; });
-  //   }
-
-  //   [[nodiscard]] auto chunks(size_type n) const {
-  //     return std::views::chunk(*this, n) | std::views::transform([](auto &&r)
-  //     {
-  //              return ustring(std::string_view(r));
-  //            });
-  //   }
+  [[nodiscard]] split_view lazy_split(char32_t delimiter) const & noexcept;
+  [[nodiscard]] split_view lazy_split(const view &delimiter) const & noexcept;
+  [[nodiscard]] split_view lines() const & noexcept;
+  [[nodiscard]] split_view chunks(size_type n) const & noexcept;
+  [[nodiscard]] breaks_index breaks(BreakType types = BreakType::ALL,
+                                    const char *locale = nullptr) const &;
 
+  [[nodiscard]] uint64_t hash64(uint64_t seed = 0) const noexcept;
   [[nodiscard]] size_t hash() const noexcept
   {
-    return std::hash<std::u8string_view>{}(std::u8string_view(data(), size()));
+    return static_cast<size_t>(hash64());
   }
+  [[nodiscard]] uint64_t hash64_folded(uint64_t seed = 0) const;
+  [[nodiscard]] bool equals_folded(const view &other) const;
 
   //[[nodiscard]] bool matches(const ustring &pattern,
   //                           const pattern_options &options = {}) const;
@@ -1217,6 +1771,10 @@ class ustring {
   // replace_all_matches(const ustring &pattern, const ustring &replacement,
   //                    const pattern_options &options = {}) const;
 
+  // Replaces every non-overlapping occurrence, scanning left to right.
+  ustring &replace(const searcher &pattern, const view &replacement);
+  ustring &replace(const ustring &pattern, const view &replacement);
+
   [[nodiscard]] ustring &to_halfwidth();  // 全角转半角
   [[nodiscard]] ustring &to_fullwidth();  // 半角转全角
   [[nodiscard]] ustring &normalize_whitespace(bool including_zero_width = true);  // 规范化空白字符
@@ -1236,25 +1794,148 @@ class ustring {
   [[nodiscard]] const_pointer data() const noexcept;
 
  private:
-  bool is_using_buffer() const
+  // The object is 24 bytes and its last byte tells the two layouts apart. Short strings keep
+  // up to default_size bytes inline, followed by `default_size - size`, which is 0 when the
+  // buffer is full. Longer ones set heap_flag in that byte and keep the pointer, size,
+  // capacity and cached code point count in front of it.
+  static constexpr uint8_t heap_flag = 0x80;
+  // Set with heap_flag when the block came from a memory resource. The block then starts with
+  // the resource pointer, resource_header bytes before _ptr.
+  static constexpr uint8_t resource_flag = 0x40;
+  static constexpr size_t resource_header = sizeof(std::pmr::memory_resource *);
+
+  uint8_t tag() const noexcept
   {
-    return _using_buffer;
+    return reinterpret_cast<const uint8_t *>(_buf)[default_size];
   }
-  void preallocate(size_type size = 0);
-  union {
-    value_type _buf[default_size];
-    value_type *_ptr;
-  };
+  bool is_using_buffer() const noexcept
+  {
+    return (tag() & heap_flag) == 0;
+  }
+  void set_size(size_type n) noexcept
+  {
+    if (is_using_buffer()) {
+      _buf[default_size] = static_cast<value_type>(default_size - n);
+    }
+    else {
+      _heap_size = n;
+      _length = npos;
+    }
+  }
+  void set_heap(value_type *ptr,
+                size_type size,
+                size_type capacity,
+                std::pmr::memory_resource *resource) noexcept
+  {
+    _ptr = ptr;
+    _heap_size = size;
+    _capacity = capacity;
+    _length = npos;
+    _heap_tag = resource ? heap_flag | resource_flag : heap_flag;
+  }
+  // Capacity to move to when `required` bytes do not fit, following the growth policy
+  size_type next_capacity(size_type required) const noexcept;
+  // A heap block of `capacity` bytes, from `resource` or new[] when it is null
+  static value_type *allocate(size_type capacity, std::pmr::memory_resource *resource);
+  // Frees the heap block, if any, leaving the storage uninitialized
+  void release() noexcept;
+  // Initializes the storage for `size` bytes, inline when they fit and no resource is given
+  void preallocate(size_type size = 0, std::pmr::memory_resource *resource = nullptr);
+  // A concat() argument as bytes: byte sources as they are, a single code unit as itself
+  template<typename T> static view concat_piece(const T &part) noexcept
+  {
+    if constexpr (std::same_as<T, value_type> || std::same_as<T, char>) {
+      return view(reinterpret_cast<const value_type *>(&part), 1);
+    }
+    else {
+      return view::of(part);
+    }
+  }
+  static ustring concat_views(std::span<const view> pieces);
+  // to_lower (upper false) and to_upper, with the simple or the full (ICU) mappings
+  ustring &map_case(bool upper, bool full);
 
-  struct {
-    bool _using_buffer : 1;
-    size_type _capacity : sizeof(size_type) * 8 - 1;
+  union {
+    struct {
+      value_type *_ptr;
+      size_type _heap_size;
+      size_type _capacity;
+      // code point count, npos until length() is called after a modification. length() reads
+      // and fills it through std::atomic_ref, since it does so from const calls.
+      mutable size_type _length;
+      uint8_t _reserved[sizeof(value_type *) == 8 ? 3 : 7];
+      uint8_t _heap_tag;
+    };
+    value_type _buf[default_size + 1];
   };
-  size_type _size;
 };
 
+static_assert(sizeof(ustring) == 24);
+
 using ustring_view = ustring::view;
 
+// Both accept either type, so unordered containers keyed by ustring can look up views (with
+// std::equal_to<>) without building a temporary ustring
+template<> struct std::hash<ustring::view> {
+  using is_transparent = void;
+
+  size_t operator()(const ustring::view &str) const noexcept
+  {
+    return str.hash();
+  }
+};
+
+template<> struct std::hash<ustring> : std::hash<ustring::view> {};
+
+// Hash and equality for unordered containers keyed by ustring. Both are transparent, so find(),
+// count() and contains() take views, std::string_view, std::u8string_view and string literals
+// directly instead of building a temporary ustring.
+struct ustring_hash {
+  using is_transparent = void;
+
+  size_t operator()(const ustring::view &str) const noexcept
+  {
+    return str.hash();
+  }
+  size_t operator()(std::string_view str) const noexcept
+  {
+    return ustring::view(str).hash();
+  }
+  size_t operator()(std::u8string_view str) const noexcept
+  {
+    return ustring::view(str).hash();
+  }
+};
+
+struct ustring_equal {
+  using is_transparent = void;
+
+  template<typename L, typename R>
+  bool operator()(const L &lhs, const R &rhs) const noexcept
+  {
+    return lhs == rhs;
+  }
+};
+
+// Hash and equality for containers that ignore case and compatibility differences
+struct ustring_folded_hash {
+  using is_transparent = void;
+
+  size_t operator()(const ustring::view &str) const
+  {
+    return static_cast<size_t>(str.hash64_folded());
+  }
+};
+
+struct ustring_folded_equal {
+  using is_transparent = void;
+
+  bool operator()(const ustring::view &lhs, const ustring::view &rhs) const
+  {
+    return lhs.equals_folded(rhs);
+  }
+};
+
 template<> struct std::formatter<ustring> : std::formatter<std::string_view> {
   auto format(const ustring &str, format_context &ctx) const
   {
@@ -0,0 +1,148 @@
+#include "ustring_builder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <unicode/utf8.h>
+
+ustring_builder::ustring_builder(size_type chunk_size, std::pmr::memory_resource *resource)
+    : _resource(resource), _chunk_size(std::max<size_type>(chunk_size, 16))
+{
+}
+
+ustring_builder::ustring_builder(ustring_builder &&other) noexcept
+    : _resource(other._resource),
+      _chunk_size(other._chunk_size),
+      _chunks(std::move(other._chunks)),
+      _filled(std::move(other._filled)),
+      _closed_size(std::exchange(other._closed_size, 0)),
+      _cursor(std::exchange(other._cursor, nullptr)),
+      _limit(std::exchange(other._limit, nullptr))
+{
+  other._chunks.clear();
+  other._filled.clear();
+}
+
+ustring_builder &ustring_builder::operator=(ustring_builder &&other) noexcept
+{
+  if (this != &other) {
+    release();
+    _resource = other._resource;
+    _chunk_size = other._chunk_size;
+    _chunks = std::move(other._chunks);
+    _filled = std::move(other._filled);
+    _closed_size = std::exchange(other._closed_size, 0);
+    _cursor = std::exchange(other._cursor, nullptr);
+    _limit = std::exchange(other._limit, nullptr);
+    other._chunks.clear();
+    other._filled.clear();
+  }
+  return *this;
+}
+
+ustring_builder::~ustring_builder()
+{
+  release();
+}
+
+ustring_builder &ustring_builder::append(ustring::view str)
+{
+  const value_type *src = str.data();
+  size_type n = str.size();
+  while (n > 0) {
+    if (_cursor == _limit) {
+      grow(n);
+    }
+    const size_type k = std::min<size_type>(n, _limit - _cursor);
+    std::memcpy(_cursor, src, k);
+    _cursor += k;
+    close_filled();
+    src += k;
+    n -= k;
+  }
+  return *this;
+}
+
+ustring_builder &ustring_builder::append_codepoint(char32_t c)
+{
+  if (c < 0x80) {
+    push_back(static_cast<value_type>(c));
+    return *this;
+  }
+  if (c > 0x10FFFF || U_IS_SURROGATE(c)) {
+    c = 0xFFFD;
+  }
+  value_type encoded[U8_MAX_LENGTH];
+  int32_t length = 0;
+  U8_APPEND_UNSAFE(encoded, length, c);
+  return append(ustring::view(encoded, length));
+}
+
+void ustring_builder::clear() noexcept
+{
+  if (_chunks.empty()) {
+    return;
+  }
+  for (size_t i = 1; i < _chunks.size(); ++i) {
+    _resource->deallocate(_chunks[i].data(), _chunks[i].size(), 1);
+  }
+  _chunks.resize(1);
+  _filled.resize(1);
+  _closed_size = 0;
+  _cursor = _chunks.front().data();
+  _filled.front() = {_cursor, _cursor};
+  _limit = _cursor + _chunks.front().size();
+}
+
+ustring ustring_builder::build() const
+{
+  const size_type total = size();
+  if (total > static_cast<size_type>(ustring().max_size())) {
+    throw std::length_error("ustring_builder::build: result would exceed ustring::max_size()");
+  }
+  ustring result;
+  result.reserve(static_cast<ustring::size_type>(total));
+  for (const chunk &c : chunks()) {
+    result.append(c.data(), static_cast<ustring::size_type>(c.size()));
+  }
+  return result;
+}
+
+std::span<const ustring_builder::chunk> ustring_builder::chunks() const noexcept
+{
+  return _filled;
+}
+
+void ustring_builder::grow(size_type n)
+{
+  // Everything that can throw comes first, so a failed grow leaves the builder writing into
+  // the current block as if it had not been called
+  if (_chunks.size() == _chunks.capacity()) {
+    _chunks.reserve(std::max<size_t>(_chunks.size() * 2, 4));
+  }
+  _filled.reserve(_chunks.capacity());
+  const size_type capacity = std::max(_chunk_size, n);
+  auto *block = static_cast<value_type *>(_resource->allocate(capacity, 1));
+
+  if (!_chunks.empty()) {
+    _closed_size += _filled.back().size();
+  }
+  _chunks.emplace_back(block, capacity);
+  _filled.emplace_back(block, 0);
+  _cursor = block;
+  _limit = block + capacity;
+}
+
+void ustring_builder::release() noexcept
+{
+  for (const auto &block : _chunks) {
+    _resource->deallocate(block.data(), block.size(), 1);
+  }
+  _chunks.clear();
+  _filled.clear();
+  _closed_size = 0;
+  _cursor = nullptr;
+  _limit = nullptr;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <format>
+#include <iterator>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+#include "ustring.h"
+
+// Accumulates long UTF-8 output in fixed size chunks. Unlike ustring::append, running out of room
+// starts a new chunk instead of moving everything written so far, so every byte is copied once
+// while building and once more by build(). chunks() hands the filled parts out as they are, ready
+// for writev() or any other gather write, without building a string at all.
+class ustring_builder {
+ public:
+  using value_type = ustring::value_type;
+  using size_type = size_t;
+  using chunk = std::span<const value_type>;
+
+  static constexpr size_type default_chunk_size = 64 * 1024;
+
+  explicit ustring_builder(size_type chunk_size = default_chunk_size,
+                           std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+  ustring_builder(ustring_builder &&other) noexcept;
+  ustring_builder &operator=(ustring_builder &&other) noexcept;
+  ustring_builder(const ustring_builder &) = delete;
+  ustring_builder &operator=(const ustring_builder &) = delete;
+  ~ustring_builder();
+
+  ustring_builder &append(ustring::view str);
+  template<typename T>
+    requires ustring::view::is_byte_source<T>
+  ustring_builder &append(const T &str)
+  {
+    return append(ustring::view::of(str));
+  }
+  // Encodes the code point as UTF-8, U+FFFD when it is not a Unicode scalar value
+  ustring_builder &append_codepoint(char32_t c);
+  // Formats straight into the chunks, without an intermediate std::string
+  template<typename... Args>
+  ustring_builder &format(std::format_string<Args...> fmt, Args &&...args)
+  {
+    std::format_to(std::back_inserter(*this), fmt, std::forward<Args>(args)...);
+    return *this;
+  }
+
+  // Also what std::back_inserter and so std::format_to(std::back_inserter(builder), ...) use
+  void push_back(value_type c)
+  {
+    if (_cursor == _limit) {
+      grow(1);
+    }
+    *_cursor++ = c;
+    close_filled();
+  }
+
+  [[nodiscard]] size_type size() const noexcept
+  {
+    return _closed_size + (_chunks.empty() ? 0 : _cursor - _chunks.back().data());
+  }
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return size() == 0;
+  }
+  // Forgets the contents but keeps the first chunk for reuse
+  void clear() noexcept;
+
+  // The contents as one string, allocated once
+  [[nodiscard]] ustring build() const;
+  // The filled part of every chunk, in order. Valid until the builder is next changed.
+  [[nodiscard]] std::span<const chunk> chunks() const noexcept;
+
+ private:
+  // Closes the current chunk and starts one with room for at least `n` bytes
+  void grow(size_type n);
+  // Brings the filled part of the current chunk up to _cursor
+  void close_filled() noexcept
+  {
+    _filled.back() = {_filled.back().data(), _cursor};
+  }
+  void release() noexcept;
+
+  std::pmr::memory_resource *_resource;
+  size_type _chunk_size;
+  // Allocated blocks, whole
+  std::vector<std::span<value_type>> _chunks;
+  // Filled part of each block, kept up to date as _cursor moves so const calls only read it
+  std::vector<chunk> _filled;
+  // Bytes in all but the current block
+  size_type _closed_size = 0;
+  value_type *_cursor = nullptr;
+  value_type *_limit = nullptr;
+};
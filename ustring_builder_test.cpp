@@ -0,0 +1,163 @@
+#include "ustring_builder.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(UstringBuilderTest, AppendAcrossChunks)
+{
+  ustring_builder builder(16);
+  EXPECT_TRUE(builder.empty());
+  EXPECT_TRUE(builder.build().empty());
+  EXPECT_TRUE(builder.chunks().empty());
+
+  std::string expected;
+  for (int i = 0; i < 100; ++i) {
+    const std::string piece = "line " + std::to_string(i) + ", ";
+    builder.append(piece);
+    expected += piece;
+  }
+  builder.append(ustring(u8"你好"));
+  builder.append(std::u8string_view(u8" end"));
+  expected += "你好 end";
+
+  EXPECT_EQ(builder.size(), expected.size());
+  EXPECT_EQ(builder.build(), ustring(expected));
+
+  // the chunks are the output in order, with nothing written twice
+  std::string gathered;
+  size_t total = 0;
+  for (const auto &chunk : builder.chunks()) {
+    EXPECT_LE(chunk.size(), 16u);
+    gathered.append(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+    total += chunk.size();
+  }
+  EXPECT_GT(builder.chunks().size(), 1u);
+  EXPECT_EQ(total, builder.size());
+  EXPECT_EQ(gathered, expected);
+}
+
+TEST(UstringBuilderTest, LargeAppendGetsItsOwnChunk)
+{
+  ustring_builder builder(16);
+  builder.append(std::string_view("head"));
+  const std::string big(1000, 'x');
+  builder.append(big);
+  builder.push_back(u8'!');
+  EXPECT_EQ(builder.size(), 1005u);
+  EXPECT_EQ(builder.build(), ustring("head" + big + "!"));
+  EXPECT_LE(builder.chunks().size(), 3u);
+}
+
+TEST(UstringBuilderTest, AppendCodepoint)
+{
+  ustring_builder builder(16);
+  for (char32_t c : {U'a', U'é', U'中', U'🌍'}) {
+    builder.append_codepoint(c);
+  }
+  EXPECT_EQ(builder.build(), ustring(u8"aé中🌍"));
+
+  builder.clear();
+  EXPECT_TRUE(builder.empty());
+  builder.append_codepoint(0xD800).append_codepoint(0x110000);
+  EXPECT_EQ(builder.build(), ustring(u8"��"));
+}
+
+TEST(UstringBuilderTest, Format)
+{
+  ustring_builder builder(8);
+  builder.append(std::string_view("values: "));
+  for (int i = 0; i < 5; ++i) {
+    builder.format("{}={:.1f};", i, i * 0.5);
+  }
+  EXPECT_EQ(builder.build(), ustring("values: 0=0.0;1=0.5;2=1.0;3=1.5;4=2.0;"));
+
+  ustring_builder direct;
+  std::format_to(std::back_inserter(direct), "{}-{}", "a", 42);
+  EXPECT_EQ(direct.build(), ustring("a-42"));
+}
+
+TEST(UstringBuilderTest, MemoryResourceAndMove)
+{
+  std::pmr::unsynchronized_pool_resource pool;
+  ustring_builder builder(32, &pool);
+  for (int i = 0; i < 50; ++i) {
+    builder.append(std::string_view("0123456789"));
+  }
+
+  ustring_builder moved = std::move(builder);
+  EXPECT_TRUE(builder.empty());
+  EXPECT_EQ(moved.size(), 500u);
+
+  builder = std::move(moved);
+  EXPECT_EQ(builder.size(), 500u);
+  builder.clear();
+  builder.append(std::string_view("reused"));
+  EXPECT_EQ(builder.chunks().size(), 1u);
+  EXPECT_EQ(builder.build(), ustring("reused"));
+}
+
+// A failed allocation leaves the builder as it was, and it keeps working afterwards
+TEST(UstringBuilderTest, FailedGrowKeepsContents)
+{
+  class failing_resource : public std::pmr::memory_resource {
+   public:
+    bool fail = false;
+
+   private:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+      if (fail) {
+        throw std::bad_alloc();
+      }
+      return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override
+    {
+      std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+      return this == &other;
+    }
+  } resource;
+
+  ustring_builder builder(16, &resource);
+  builder.append(std::string_view("0123456789abcdef"));
+  resource.fail = true;
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_THROW(builder.append(std::string_view("x")), std::bad_alloc);
+    EXPECT_EQ(builder.size(), 16u);
+  }
+  resource.fail = false;
+  builder.append(std::string_view("x"));
+  EXPECT_EQ(builder.size(), 17u);
+  EXPECT_EQ(builder.build(), ustring("0123456789abcdefx"));
+}
+
+// build() and chunks() only read, so threads can share a const builder
+TEST(UstringBuilderTest, ConcurrentBuild)
+{
+  ustring_builder builder(16);
+  for (int i = 0; i < 20; ++i) {
+    builder.append(std::string_view("0123456789"));
+  }
+  builder.push_back('!');
+  const ustring_builder &shared = builder;
+
+  std::vector<std::thread> threads;
+  std::atomic<int> mismatches = 0;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 100; ++i) {
+        mismatches += shared.build().size() != 201 || shared.chunks().back().back() != u8'!';
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(mismatches, 0);
+}
@@ -626,4 +626,97 @@ BENCHMARK_TEMPLATE(BM_Concatenation, ustring)->Range(8, 8<<10);
 BENCHMARK_TEMPLATE(BM_Concatenation, icu::UnicodeString)->Range(8, 8<<10);
 BENCHMARK_TEMPLATE(BM_Concatenation, std::u8string)->Range(8, 8<<10);
 
+// Transcoding Operations
+// range(0) is the UTF-8 size in bytes, range(1) selects ASCII (0) or mixed script (1) text
+static std::u8string transcoding_text(const benchmark::State& state) {
+    const size_t size = state.range(0);
+    std::u8string text;
+    if (state.range(1) == 0) {
+        const std::string ascii = test_data::generate_ascii(size);
+        text.assign(ascii.begin(), ascii.end());
+    } else {
+        while (text.size() < size) {
+            text += test_data::large_mixed_text;
+        }
+    }
+    return text;
+}
+
+template<typename T>
+static void BM_Transcode_UTF8_To_UTF16(benchmark::State& state) {
+    const std::u8string text = transcoding_text(state);
+    ustring str(text);
+    for (auto _ : state) {
+        if constexpr (std::is_same_v<T, ustring>) {
+            benchmark::DoNotOptimize(str.to_u16string());
+        } else {
+            benchmark::DoNotOptimize(icu::UnicodeString::fromUTF8(
+                icu::StringPiece(reinterpret_cast<const char*>(text.data()), text.size())));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_TEMPLATE(BM_Transcode_UTF8_To_UTF16, ustring)->ArgsProduct({{64, 4<<10, 256<<10}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_Transcode_UTF8_To_UTF16, icu::UnicodeString)->ArgsProduct({{64, 4<<10, 256<<10}, {0, 1}});
+
+template<typename T>
+static void BM_Transcode_UTF16_To_UTF8(benchmark::State& state) {
+    const std::u8string text = transcoding_text(state);
+    const std::u16string utf16 = ustring(text).to_u16string();
+    const icu::UnicodeString icu_str(utf16.data(), static_cast<int32_t>(utf16.size()));
+    for (auto _ : state) {
+        if constexpr (std::is_same_v<T, ustring>) {
+            benchmark::DoNotOptimize(ustring(utf16));
+        } else {
+            std::string result;
+            icu_str.toUTF8String(result);
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_TEMPLATE(BM_Transcode_UTF16_To_UTF8, ustring)->ArgsProduct({{64, 4<<10, 256<<10}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_Transcode_UTF16_To_UTF8, icu::UnicodeString)->ArgsProduct({{64, 4<<10, 256<<10}, {0, 1}});
+
+template<typename T>
+static void BM_Transcode_UTF8_To_UTF32(benchmark::State& state) {
+    const std::u8string text = transcoding_text(state);
+    ustring str(text);
+    for (auto _ : state) {
+        if constexpr (std::is_same_v<T, ustring>) {
+            benchmark::DoNotOptimize(str.to_u32string());
+        } else {
+            const icu::UnicodeString icu_str = icu::UnicodeString::fromUTF8(
+                icu::StringPiece(reinterpret_cast<const char*>(text.data()), text.size()));
+            std::u32string result(icu_str.countChar32(), U'\0');
+            UErrorCode status = U_ZERO_ERROR;
+            icu_str.toUTF32(reinterpret_cast<UChar32*>(result.data()), result.size(), status);
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_TEMPLATE(BM_Transcode_UTF8_To_UTF32, ustring)->ArgsProduct({{64, 4<<10, 256<<10}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_Transcode_UTF8_To_UTF32, icu::UnicodeString)->ArgsProduct({{64, 4<<10, 256<<10}, {0, 1}});
+
+template<typename T>
+static void BM_Transcode_UTF32_To_UTF8(benchmark::State& state) {
+    const std::u8string text = transcoding_text(state);
+    const std::u32string utf32 = ustring(text).to_u32string();
+    for (auto _ : state) {
+        if constexpr (std::is_same_v<T, ustring>) {
+            benchmark::DoNotOptimize(ustring(utf32));
+        } else {
+            std::string result;
+            icu::UnicodeString::fromUTF32(reinterpret_cast<const UChar32*>(utf32.data()),
+                                          static_cast<int32_t>(utf32.size()))
+                .toUTF8String(result);
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_TEMPLATE(BM_Transcode_UTF32_To_UTF8, ustring)->ArgsProduct({{64, 4<<10, 256<<10}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_Transcode_UTF32_To_UTF8, icu::UnicodeString)->ArgsProduct({{64, 4<<10, 256<<10}, {0, 1}});
+
 BENCHMARK_MAIN();
@@ -1,6 +1,7 @@
 #include "ustring.h"
 
 #include <gtest/gtest.h>
+#include <memory_resource>
 #include <string>
 
 TEST(UstringConstructionTest, DefaultConstructor) {
@@ -87,6 +88,36 @@ TEST(UstringConstructionTest, DifferentEncodings) {
   EXPECT_EQ(utf32_str.to_string(), utf8_str.to_string());
 }
 
+TEST(UstringConstructionTest, EncodingRoundTrip) {
+  std::u8string text;
+  for (int i = 0; i < 50; ++i) {
+    text += u8"plain ascii run, 你好世界 😀🌍 é\n";
+  }
+  ustring str(text);
+
+  const std::u16string utf16 = str.to_u16string();
+  EXPECT_EQ(utf16.size(), 50 * 29);
+  EXPECT_EQ(ustring(utf16), str);
+
+  const std::u32string utf32 = str.to_u32string();
+  EXPECT_EQ(utf32.size(), str.length());
+  EXPECT_EQ(ustring(utf32), str);
+
+  EXPECT_EQ(ustring(str.to_wstring()), str);
+  EXPECT_EQ(ustring(U"abc"), ustring("abc"));
+  EXPECT_EQ(ustring(u"abc"), ustring("abc"));
+
+  // unpaired surrogates and ill-formed UTF-8 cannot be converted
+  const char16_t lone[] = {u'a', 0xD800, u'b'};
+  EXPECT_THROW(ustring(lone, 3), std::runtime_error);
+  EXPECT_THROW(ustring("a\xC0\x80").to_u16string(), std::runtime_error);
+  EXPECT_THROW(ustring("a\xFF").to_u32string(), std::runtime_error);
+
+  // lengths whose worst case UTF-8 size does not fit are refused before anything is read
+  EXPECT_THROW(ustring(lone, size_t{1} << 30), std::length_error);
+  EXPECT_THROW(ustring(U"a", size_t{1} << 29), std::length_error);
+}
+
 TEST(UstringConstructionTest, SpecialCharacters) {
   ustring null_str("\0", size_t(1));
   EXPECT_EQ(null_str.length(), 1);
@@ -106,6 +137,50 @@ TEST(UstringConstructionTest, InvalidUTF8) {
   });
 }
 
+TEST(UstringConstructionTest, ValidateUTF8) {
+  EXPECT_EQ(ustring::validate_utf8(u8""), ustring::npos);
+  EXPECT_EQ(ustring::validate_utf8(u8"Hello 你好 😀"), ustring::npos);
+
+  // long enough to cover the vector paths and their tails
+  std::u8string text;
+  for (int i = 0; i < 20; ++i) {
+    text += u8"abc你好😀é";
+  }
+  EXPECT_EQ(ustring::validate_utf8(text), ustring::npos);
+
+  auto check = [](const std::string &prefix, const std::string &bad) {
+    std::string s = prefix + bad + "tail";
+    return ustring::validate_utf8({reinterpret_cast<const char8_t *>(s.data()), s.size()});
+  };
+  const std::string ascii(45, 'a');
+  EXPECT_EQ(check("", "\xC0\x80"), 0);          // overlong NUL
+  EXPECT_EQ(check(ascii, "\xE0\x80\x80"), 45);  // overlong 3-byte
+  EXPECT_EQ(check(ascii, "\xED\xA0\x80"), 45);  // surrogate
+  EXPECT_EQ(check(ascii, "\xF4\x90\x80\x80"), 45);  // > U+10FFFF
+  EXPECT_EQ(check(ascii, "\x80"), 45);          // stray continuation
+  EXPECT_EQ(check(ascii, "\xFF"), 45);
+  EXPECT_EQ(check(ascii, "\xE4\xBD"), 45);      // truncated before ASCII
+
+  // sequences straddling 16 and 32 byte blocks
+  for (size_t n = 10; n < 70; ++n) {
+    const std::string pad(n, 'x');
+    EXPECT_EQ(check(pad, "\xF0\x9F\x98\x80"), ustring::npos) << n;
+    EXPECT_EQ(check(pad, "\xF0\x9F\x98"), n) << n;
+    EXPECT_EQ(check(pad + "\xE4\xBD\xA0", "\xBD"), n + 3) << n;
+  }
+
+  // truncated at the very end
+  for (size_t n = 0; n < 70; ++n) {
+    std::string s(n, 'x');
+    s += "\xE4\xBD";
+    EXPECT_EQ(ustring::validate_utf8({reinterpret_cast<const char8_t *>(s.data()), s.size()}), n);
+  }
+
+  const char invalid[] = "abc\xED\xA0\x80";
+  EXPECT_TRUE(ustring(invalid, true).empty());
+  EXPECT_EQ(ustring("abc\xE4\xBD\xA0", true).size(), 6);
+}
+
 TEST(UstringConstructionTest, LargeString) {
   std::string large_text(1000000, 'a'); 
   EXPECT_NO_THROW({
@@ -137,3 +212,124 @@ TEST(UstringConstructionTest, StringLength) {
   ustring mixed(u8"Hello你好😀");  // 5(ASCII) + 2(中文) + 1(emoji) = 8个code points
   EXPECT_EQ(mixed.length(), 8);
 }
+
+TEST(UstringConstructionTest, InlineStorage) {
+  EXPECT_EQ(sizeof(ustring), 24);
+
+  const ustring small(std::string(23, 'a'));
+  EXPECT_EQ(small.size(), 23);
+  EXPECT_EQ(small.capacity(), ustring::default_size);
+  EXPECT_EQ(small.data()[23], u8'\0');
+
+  const ustring large(std::string(24, 'b'));
+  EXPECT_EQ(large.size(), 24);
+  EXPECT_GE(large.capacity(), 24);
+
+  // copies and moves across both representations
+  ustring a = small;
+  ustring b = large;
+  EXPECT_EQ(a, small);
+  EXPECT_EQ(b, large);
+  a = large;
+  b = small;
+  EXPECT_EQ(a, large);
+  EXPECT_EQ(b, small);
+  ustring c = std::move(a);
+  EXPECT_EQ(c, large);
+  EXPECT_TRUE(a.empty());
+  a.swap(b);
+  EXPECT_EQ(a, small);
+  EXPECT_TRUE(b.empty());
+  a.swap(c);
+  EXPECT_EQ(a, large);
+  EXPECT_EQ(c, small);
+
+  // crossing the inline capacity
+  ustring grow(std::string(22, 'x'));
+  grow.push_back(u8'y');
+  EXPECT_EQ(grow.size(), 23);
+  EXPECT_EQ(grow.capacity(), ustring::default_size);
+  grow.push_back(u8'z');
+  EXPECT_EQ(grow.size(), 24);
+  EXPECT_EQ(ustring(grow.to_view().substr(21)), ustring("xyz"));
+  grow.pop_back();
+  grow.shrink_to_fit();
+  EXPECT_EQ(grow.capacity(), ustring::default_size);
+  EXPECT_EQ(ustring(grow.to_view().substr(21)), ustring("xy"));
+
+  // code point counts in both representations
+  ustring cjk(u8"你好世界你好世");
+  EXPECT_EQ(cjk.size(), 21);
+  EXPECT_EQ(cjk.length(), 7);
+  cjk.append(ustring(u8"界"));
+  EXPECT_EQ(cjk.size(), 24);
+  EXPECT_EQ(cjk.length(), 8);
+  cjk.clear();
+  EXPECT_EQ(cjk.length(), 0);
+}
+
+TEST(UstringConstructionTest, MemoryResource) {
+  struct counting_resource : std::pmr::memory_resource {
+    std::pmr::monotonic_buffer_resource arena;
+    int allocations = 0;
+    int deallocations = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+      ++allocations;
+      return arena.allocate(bytes, alignment);
+    }
+    void do_deallocate(void *, size_t, size_t) override
+    {
+      ++deallocations;
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+      return this == &other;
+    }
+  } resource;
+
+  {
+    ustring a("hello", &resource);
+    EXPECT_EQ(a.resource(), &resource);
+    EXPECT_EQ(a, ustring("hello"));
+    EXPECT_EQ(a.capacity(), 5);  // never inline
+    for (int i = 0; i < 100; ++i) {
+      a.push_back(u8'!');
+    }
+    a.insert(0, u8"abc");
+    a.shrink_to_fit();
+    EXPECT_EQ(a.resource(), &resource);
+    EXPECT_EQ(a.size(), 108);
+
+    // derived strings stay in the resource, copies do not
+    EXPECT_EQ(a.substr(3, 5).resource(), &resource);
+    EXPECT_EQ(ustring(a.substr(3, 5)), ustring("hello"));
+    EXPECT_EQ(ustring(u8"ÀB", &resource).lowered().resource(), &resource);
+    EXPECT_EQ(ustring(u8"ÀB", &resource).lowered(true), ustring(u8"àb"));
+    EXPECT_EQ(ustring(u8"À", &resource).normalized({}).resource(), &resource);
+    EXPECT_EQ(ustring(a).resource(), nullptr);
+    EXPECT_EQ(ustring().resource(), nullptr);
+
+    // assignment keeps the target's resource, moves take it along
+    ustring b(&resource);
+    b = ustring("a string longer than the inline buffer");
+    EXPECT_EQ(b.resource(), &resource);
+    EXPECT_EQ(b, ustring("a string longer than the inline buffer"));
+    ustring c;
+    c = b;
+    EXPECT_EQ(c.resource(), nullptr);
+    ustring d(std::move(a));
+    EXPECT_EQ(d.resource(), &resource);
+    EXPECT_EQ(a.resource(), nullptr);
+    EXPECT_TRUE(a.empty());
+
+    c.swap(d);
+    EXPECT_EQ(c.resource(), nullptr);
+    EXPECT_EQ(d.resource(), &resource);
+    EXPECT_EQ(c.size(), 108);
+    EXPECT_EQ(d, ustring("a string longer than the inline buffer"));
+  }
+  EXPECT_GT(resource.allocations, 0);
+  EXPECT_EQ(resource.allocations, resource.deallocations);
+}
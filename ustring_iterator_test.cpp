@@ -1,6 +1,8 @@
 #include "ustring.h"
 #include <gtest/gtest.h>
 
+#include <unicode/uchar.h>
+
 class UStringIteratorTest : public ::testing::Test {
  protected:
   void SetUp() override
@@ -235,6 +237,41 @@ TEST_F(UStringViewTest, ViewComparisons)
   EXPECT_LT(view3, view1);
 }
 
+TEST_F(UStringViewTest, MixedComparisons)
+{
+  const ustring str("Hello World, long enough to live on the heap");
+  const auto view = str.to_view();
+  const std::string same(str.to_string_view());
+  const std::string_view bytes = same;
+  const std::u8string_view u8bytes = str.to_u8string_view();
+
+  // view against ustring used to recurse through the forwarding overload
+  EXPECT_TRUE(view == str);
+  EXPECT_TRUE(str == view);
+  EXPECT_TRUE(view == ustring(str));
+  EXPECT_EQ(view <=> ustring("Hello"), std::strong_ordering::greater);
+
+  EXPECT_TRUE(str == bytes);
+  EXPECT_TRUE(bytes == str);
+  EXPECT_TRUE(view == bytes);
+  EXPECT_TRUE(str == u8bytes);
+  EXPECT_TRUE(view == u8bytes);
+  EXPECT_TRUE(str == same);
+  EXPECT_TRUE(view == same);
+  EXPECT_TRUE(same == view);
+  EXPECT_TRUE(str == same.c_str());
+  EXPECT_FALSE(str == "Hello");
+  EXPECT_FALSE(view == std::string_view("Hello"));
+
+  EXPECT_EQ(str <=> std::string_view("Hello"), std::strong_ordering::greater);
+  EXPECT_EQ(std::string_view("Hello") <=> str, std::strong_ordering::less);
+  EXPECT_EQ(view <=> std::u8string_view(u8"Help"), std::strong_ordering::less);
+  EXPECT_EQ(str <=> same, std::strong_ordering::equal);
+
+  // other encodings still compare by content
+  EXPECT_TRUE(ustring("abc") == std::u16string(u"abc"));
+}
+
 TEST_F(UStringViewTest, ViewWithSpecialCharacters)
 {
   ustring special_str("Tab\there\nNewline\r\nCRLF\\Backslash");
@@ -711,6 +748,68 @@ TEST_F(UStringPropertyTest, GetPropertyComprehensive)
   EXPECT_FALSE(static_cast<int>(prop_emoji) & static_cast<int>(CharProperty::ALPHABETIC));
 }
 
+// get_property reads a precomputed table; it must agree with ICU on every code point
+TEST_F(UStringPropertyTest, GetPropertyMatchesICU)
+{
+  auto bit = [](char32_t c, CharProperty property) {
+    return (static_cast<uint32_t>(get_property(c)) & static_cast<uint32_t>(property)) != 0;
+  };
+  for (UChar32 c = 0; c <= 0x10FFFF; ++c) {
+    ASSERT_EQ(bit(c, CharProperty::ALPHABETIC), static_cast<bool>(u_isalpha(c))) << std::hex << c;
+    ASSERT_EQ(bit(c, CharProperty::WHITESPACE), static_cast<bool>(u_isspace(c))) << std::hex << c;
+    ASSERT_EQ(bit(c, CharProperty::HEXDIGIT), static_cast<bool>(u_isxdigit(c))) << std::hex << c;
+    ASSERT_EQ(bit(c, CharProperty::EMOJI), static_cast<bool>(u_hasBinaryProperty(c, UCHAR_EMOJI)))
+        << std::hex << c;
+    ASSERT_EQ(bit(c, CharProperty::NONCHARACTER_CODE_POINT),
+              static_cast<bool>(u_hasBinaryProperty(c, UCHAR_NONCHARACTER_CODE_POINT)))
+        << std::hex << c;
+  }
+  EXPECT_EQ(get_property(char32_t(0x110000)), CharProperty::NONE);
+  EXPECT_EQ(get_property(char32_t(0xFFFFFFFF)), CharProperty::NONE);
+
+  // the ustring predicates use the same table
+  EXPECT_TRUE(ustring(u8"Ｆｕｌｌ").is_alpha());
+  EXPECT_TRUE(ustring(u8"١٢٣").is_digit());
+  EXPECT_TRUE(ustring(u8"abc١٢٣").is_alnum());
+  EXPECT_TRUE(ustring(u8" \t\u3000").is_space());
+  EXPECT_TRUE(ustring(u8"ßπ").is_lower());
+  EXPECT_FALSE(ustring(u8"ABC\xFF").is_upper());
+}
+
+TEST_F(UStringPropertyTest, FindAndCountProperty)
+{
+  const ustring digits(std::string(100, '7') + "x" + std::string(40, '1'));
+  EXPECT_EQ(digits.find_first_not_property(CharProperty::DIGIT), 100);
+  EXPECT_EQ(digits.find_first_not_property(CharProperty::DIGIT, 101), ustring::npos);
+  EXPECT_EQ(digits.find_first_property(CharProperty::ALPHABETIC), 100);
+  EXPECT_EQ(digits.find_first_property(CharProperty::ALPHABETIC, 101), ustring::npos);
+  EXPECT_EQ(digits.count_property(CharProperty::DIGIT), 140u);
+  EXPECT_EQ(digits.count_property(CharProperty::DIGIT | CharProperty::ALPHABETIC), 141u);
+  EXPECT_FALSE(digits.is_digit());
+  EXPECT_TRUE(ustring(std::string(100, '7')).is_digit());
+
+  // non-ASCII code points between ASCII runs; offsets are in bytes
+  const ustring mixed(u8"The quick brown fox jumps over the lazy dog, 你好 ٣ 😀 again and again.");
+  EXPECT_EQ(mixed.find_first_property(CharProperty::IDEOGRAPHIC), 45);
+  EXPECT_EQ(mixed.find_first_property(CharProperty::DIGIT), 52);
+  EXPECT_EQ(mixed.find_first_property(CharProperty::EMOJI), 55);
+  EXPECT_EQ(mixed.find_first_not_property(CharProperty::ALPHABETIC | CharProperty::SPACE), 43);
+  EXPECT_EQ(mixed.find_first_not_property(CharProperty::ALPHABETIC | CharProperty::SPACE, 44),
+            52);
+  EXPECT_EQ(mixed.count_property(CharProperty::IDEOGRAPHIC), 2u);
+  EXPECT_EQ(mixed.count_property(CharProperty::UPPERCASE), 1u);
+  EXPECT_EQ(mixed.count_property(CharProperty::ALPHABETIC), 50u);
+  EXPECT_EQ(mixed.to_view().count_property(CharProperty::ALPHABETIC),
+            mixed.count([](char32_t c) { return has_property(c, CharProperty::ALPHABETIC); }));
+
+  // ill-formed bytes have no properties
+  const ustring broken(std::string(40, 'a') + "\xC3" + std::string(40, 'b'));
+  EXPECT_EQ(broken.find_first_not_property(CharProperty::ALPHABETIC), 40);
+  EXPECT_EQ(broken.count_property(CharProperty::ALPHABETIC), 80u);
+  EXPECT_EQ(ustring().find_first_property(CharProperty::ALPHABETIC), ustring::npos);
+  EXPECT_EQ(ustring().count_property(CharProperty::ALPHABETIC), 0u);
+}
+
 TEST_F(UStringPropertyTest, CodepointConversion)
 {
   // Test ASCII
@@ -1132,3 +1231,61 @@ TEST(IteratorTest, BoundaryAndErrorCases)
   --sit;
   EXPECT_EQ(sit, text.sentences_begin());
 }
+
+TEST(IteratorTest, BreaksIndex)
+{
+  ustring text("Hi e\u0301! \U0001F468\u200D\U0001F469\u200D\U0001F467 ok.\r\nBye? 你好。");
+  auto index = text.breaks();
+
+  // Each segmentation agrees with the matching iterator
+  std::vector<ustring_view> expected;
+  for (auto it = text.graphemes_begin(); it != text.graphemes_end(); ++it) {
+    expected.push_back(*it);
+  }
+  EXPECT_TRUE(std::ranges::equal(index.segments(BreakType::GRAPHEME), expected));
+  expected.clear();
+  for (auto it = text.words_begin(); it != text.words_end(); ++it) {
+    expected.push_back(*it);
+  }
+  EXPECT_TRUE(std::ranges::equal(index.segments(BreakType::WORD), expected));
+  expected.clear();
+  for (auto it = text.sentences_begin(); it != text.sentences_end(); ++it) {
+    expected.push_back(*it);
+  }
+  EXPECT_TRUE(std::ranges::equal(index.segments(BreakType::SENTENCE), expected));
+
+  // Random access
+  auto graphemes = index.segments(BreakType::GRAPHEME);
+  static_assert(std::ranges::random_access_range<decltype(graphemes)>);
+  ASSERT_EQ(index.count(BreakType::GRAPHEME), 20);
+  EXPECT_EQ(graphemes[3], ustring("e\u0301"));
+  EXPECT_EQ(graphemes[6], ustring("\U0001F468\u200D\U0001F469\u200D\U0001F467"));
+  EXPECT_EQ(graphemes[11], ustring("\r\n"));
+  EXPECT_EQ(graphemes.end() - graphemes.begin(), 20);
+  EXPECT_EQ((graphemes.begin() + 6).position(), 8);
+
+  // Lookup by byte offset
+  auto family = index.segment_at(BreakType::GRAPHEME, 10);
+  EXPECT_EQ(family - graphemes.begin(), 6);
+  EXPECT_EQ(family.position(), 8);
+  EXPECT_EQ(*index.segment_at(BreakType::WORD, 1), ustring("Hi"));
+  EXPECT_EQ((*index.segment_at(BreakType::SENTENCE, 32)).data()[0], u8'B');
+  EXPECT_EQ(index.segment_at(BreakType::WORD, text.size()), index.end(BreakType::WORD));
+  EXPECT_EQ(index.segment_at(BreakType::WORD, -1), index.end(BreakType::WORD));
+  EXPECT_TRUE(index.is_boundary(BreakType::GRAPHEME, 0));
+  EXPECT_TRUE(index.is_boundary(BreakType::GRAPHEME, text.size()));
+  EXPECT_FALSE(index.is_boundary(BreakType::GRAPHEME, 4));
+
+  // Only the requested segmentations are built
+  auto words = text.breaks(BreakType::WORD);
+  EXPECT_TRUE(words.has(BreakType::WORD));
+  EXPECT_FALSE(words.has(BreakType::GRAPHEME));
+  EXPECT_EQ(words.begin(BreakType::GRAPHEME), words.end(BreakType::GRAPHEME));
+  EXPECT_EQ(words.count(BreakType::SENTENCE), 0);
+
+  ustring empty;
+  auto none = empty.breaks();
+  EXPECT_TRUE(none.has(BreakType::GRAPHEME));
+  EXPECT_EQ(none.count(BreakType::GRAPHEME), 0);
+  EXPECT_EQ(none.segment_at(BreakType::WORD, 0), none.end(BreakType::WORD));
+}
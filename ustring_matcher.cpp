@@ -0,0 +1,117 @@
+#include "ustring_matcher.h"
+
+#include <deque>
+
+ustring_matcher::ustring_matcher(std::span<const ustring> patterns, Boundary boundary)
+    : _boundary(boundary)
+{
+  // Byte classes, numbered in byte order from 1
+  std::array<bool, 256> used{};
+  for (const auto &pattern : patterns) {
+    for (const auto c : pattern.to_u8string_view()) {
+      used[static_cast<uint8_t>(c)] = true;
+    }
+  }
+  for (size_t b = 0; b < 256; ++b) {
+    if (used[b]) {
+      _byte_class[b] = static_cast<uint16_t>(_class_count++);
+    }
+  }
+  const uint32_t classes = _class_count;
+
+  // Trie of the patterns. While building, transitions hold state ids and 0 (the root, which
+  // is never a child) marks a missing edge.
+  std::vector<uint32_t> next(classes, 0);
+  _terminal.push_back(none);
+  _pattern_sizes.reserve(patterns.size());
+  _duplicate.assign(patterns.size(), none);
+  for (uint32_t id = 0; id < patterns.size(); ++id) {
+    const auto bytes = patterns[id].to_u8string_view();
+    _pattern_sizes.push_back(static_cast<size_type>(bytes.size()));
+    if (bytes.empty()) {
+      continue;
+    }
+
+    uint32_t state = 0;
+    for (const auto c : bytes) {
+      uint32_t &edge = next[state * classes + _byte_class[static_cast<uint8_t>(c)]];
+      if (edge == 0) {
+        edge = static_cast<uint32_t>(_terminal.size());
+        _terminal.push_back(none);
+        next.resize(next.size() + classes, 0);
+      }
+      state = next[state * classes + _byte_class[static_cast<uint8_t>(c)]];
+    }
+
+    uint32_t *tail = &_terminal[state];
+    while (*tail != none) {
+      tail = &_duplicate[*tail];
+    }
+    *tail = id;
+  }
+
+  // Breadth first, complete the trie into a DFA and link every state to its longest proper
+  // suffix that is also a state (fail) and to the longest one that ends a pattern (dict).
+  const size_t states = _terminal.size();
+  std::vector<uint32_t> fail(states, 0);
+  _dict_link.assign(states, none);
+  std::deque<uint32_t> queue;
+  for (uint32_t c = 0; c < classes; ++c) {
+    if (next[c] != 0) {
+      queue.push_back(next[c]);
+    }
+  }
+  while (!queue.empty()) {
+    const uint32_t state = queue.front();
+    queue.pop_front();
+    const uint32_t suffix = fail[state];
+    _dict_link[state] = _terminal[suffix] != none ? suffix : _dict_link[suffix];
+
+    for (uint32_t c = 0; c < classes; ++c) {
+      uint32_t &edge = next[state * classes + c];
+      if (edge != 0) {
+        fail[edge] = next[suffix * classes + c];
+        queue.push_back(edge);
+      }
+      else {
+        edge = next[suffix * classes + c];
+      }
+    }
+  }
+
+  _next.resize(next.size());
+  for (size_t i = 0; i < next.size(); ++i) {
+    const uint32_t target = next[i];
+    const bool output = _terminal[target] != none || _dict_link[target] != none;
+    _next[i] = target * classes | (output ? output_flag : 0);
+  }
+}
+
+std::vector<ustring_matcher::match> ustring_matcher::find_all(ustring::view text) const
+{
+  std::vector<match> result;
+  scan(text, [&result](const match &m) { result.push_back(m); });
+  return result;
+}
+
+bool ustring_matcher::contains_any(ustring::view text) const
+{
+  bool found = false;
+  scan(text, [&found](const match &) {
+    found = true;
+    return false;
+  });
+  return found;
+}
+
+std::vector<ustring_matcher::size_type> ustring_matcher::grapheme_boundaries(ustring::view text)
+{
+  std::vector<size_type> result{0};
+  for (const auto &grapheme : text.graphemes()) {
+    result.push_back(static_cast<size_type>(grapheme.data() - text.data()) + grapheme.size());
+  }
+  if (result.back() != text.size()) {
+    result.push_back(text.size());
+  }
+  return result;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "ustring.h"
+
+// Aho-Corasick automaton over the UTF-8 bytes of a fixed set of patterns. It finds every
+// occurrence of every pattern in one pass over the text, however many patterns there are.
+// The automaton is never modified after construction, so one instance can be shared between
+// threads.
+class ustring_matcher {
+ public:
+  using size_type = ustring::size_type;
+
+  /**
+   * Where a match may start and end.
+   */
+  enum class Boundary : uint8_t {
+    /** Any byte offset */
+    BYTE,
+    /** Code point boundaries. Only differs from BYTE when text or patterns are ill-formed */
+    CODE_POINT,
+    /** Extended grapheme cluster boundaries, as reported by ustring::grapheme_iterator */
+    GRAPHEME
+  };
+
+  struct match {
+    uint32_t pattern_id;  // index of the pattern in the span the matcher was built from
+    size_type offset;     // byte offset of the first byte of the match
+
+    bool operator==(const match &) const = default;
+  };
+
+  explicit ustring_matcher(std::span<const ustring> patterns, Boundary boundary = Boundary::BYTE);
+
+  // Calls on_match(match) for every match, ordered by end offset and then from the longest
+  // pattern to the shortest. Overlapping matches are all reported. If on_match returns bool,
+  // returning false stops the scan.
+  template<typename F> void scan(ustring::view text, F &&on_match) const;
+
+  [[nodiscard]] std::vector<match> find_all(ustring::view text) const;
+  [[nodiscard]] bool contains_any(ustring::view text) const;
+
+  [[nodiscard]] size_t pattern_count() const noexcept
+  {
+    return _pattern_sizes.size();
+  }
+  [[nodiscard]] size_type pattern_size(uint32_t pattern_id) const noexcept
+  {
+    return _pattern_sizes[pattern_id];
+  }
+  [[nodiscard]] size_t state_count() const noexcept
+  {
+    return _terminal.size();
+  }
+  [[nodiscard]] Boundary boundary() const noexcept
+  {
+    return _boundary;
+  }
+
+ private:
+  static constexpr uint32_t output_flag = 0x80000000u;
+  static constexpr uint32_t none = UINT32_MAX;
+
+  static std::vector<size_type> grapheme_boundaries(ustring::view text);
+
+  // Bytes that occur in no pattern share class 0, so a row only has one column per distinct
+  // pattern byte. Patterns may use all 256 byte values, which takes 257 classes.
+  std::array<uint16_t, 256> _byte_class{};
+  uint32_t _class_count = 1;
+  // Row-major transitions of the complete automaton. Entries hold the row offset
+  // (state * _class_count) of the target, with output_flag set if the target or one of its
+  // suffixes ends a pattern.
+  std::vector<uint32_t> _next;
+  // First pattern ending in each state, further patterns with the same bytes, and the next
+  // shorter suffix state that ends a pattern.
+  std::vector<uint32_t> _terminal;
+  std::vector<uint32_t> _duplicate;
+  std::vector<uint32_t> _dict_link;
+  std::vector<size_type> _pattern_sizes;
+  Boundary _boundary;
+};
+
+template<typename F> void ustring_matcher::scan(ustring::view text, F &&on_match) const
+{
+  const auto *bytes = reinterpret_cast<const uint8_t *>(text.data());
+  const size_type size = text.size();
+  std::vector<size_type> graphemes;
+  bool graphemes_ready = false;
+
+  auto accepts = [&](size_type first, size_type last) {
+    switch (_boundary) {
+      case Boundary::BYTE:
+        return true;
+      case Boundary::CODE_POINT:
+        return (first == 0 || (bytes[first] & 0xC0) != 0x80) &&
+               (last == size || (bytes[last] & 0xC0) != 0x80);
+      case Boundary::GRAPHEME:
+        if (!graphemes_ready) {
+          graphemes = grapheme_boundaries(text);
+          graphemes_ready = true;
+        }
+        return std::binary_search(graphemes.begin(), graphemes.end(), first) &&
+               std::binary_search(graphemes.begin(), graphemes.end(), last);
+    }
+    return false;
+  };
+
+  uint32_t row = 0;
+  for (size_type i = 0; i < size; ++i) {
+    const uint32_t next = _next[row + _byte_class[bytes[i]]];
+    row = next & ~output_flag;
+    if ((next & output_flag) == 0) {
+      continue;
+    }
+
+    for (uint32_t state = row / _class_count; state != none; state = _dict_link[state]) {
+      for (uint32_t id = _terminal[state]; id != none; id = _duplicate[id]) {
+        const size_type first = i + 1 - _pattern_sizes[id];
+        if (!accepts(first, i + 1)) {
+          continue;
+        }
+        if constexpr (std::is_same_v<std::invoke_result_t<F &, match>, bool>) {
+          if (!on_match(match{id, first})) {
+            return;
+          }
+        }
+        else {
+          on_match(match{id, first});
+        }
+      }
+    }
+  }
+}
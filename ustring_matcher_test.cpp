@@ -0,0 +1,87 @@
+#include "ustring_matcher.h"
+#include <gtest/gtest.h>
+
+using match = ustring_matcher::match;
+
+TEST(UstringMatcherTest, OverlappingPatterns)
+{
+  const std::vector<ustring> patterns = {u8"he", u8"she", u8"his", u8"hers"};
+  ustring_matcher matcher(patterns);
+  EXPECT_EQ(matcher.pattern_count(), 4);
+
+  ustring text = u8"ushers";
+  std::vector<match> expected = {{1, 1}, {0, 2}, {3, 2}};
+  EXPECT_EQ(matcher.find_all(text.to_view()), expected);
+
+  EXPECT_TRUE(matcher.contains_any(ustring(u8"this").to_view()));
+  EXPECT_FALSE(matcher.contains_any(ustring(u8"hx sx").to_view()));
+  EXPECT_TRUE(matcher.find_all(ustring().to_view()).empty());
+}
+
+TEST(UstringMatcherTest, DuplicateAndEmptyPatterns)
+{
+  const std::vector<ustring> patterns = {u8"ab", u8"", u8"ab", u8"b"};
+  ustring_matcher matcher(patterns);
+
+  ustring text = u8"abab";
+  std::vector<match> expected = {{0, 0}, {2, 0}, {3, 1}, {0, 2}, {2, 2}, {3, 3}};
+  EXPECT_EQ(matcher.find_all(text.to_view()), expected);
+  EXPECT_EQ(matcher.pattern_size(1), 0);
+}
+
+TEST(UstringMatcherTest, Unicode)
+{
+  const std::vector<ustring> patterns = {u8"世界", u8"界", u8"こんにちは"};
+  ustring_matcher matcher(patterns);
+
+  ustring text = u8"Hello, 世界! こんにちは世界";
+  std::vector<match> expected = {{0, 7}, {1, 10}, {2, 15}, {0, 30}, {1, 33}};
+  EXPECT_EQ(matcher.find_all(text.to_view()), expected);
+
+  // The scan stops as soon as the callback returns false
+  std::vector<match> first;
+  matcher.scan(text.to_view(), [&](const match &m) {
+    first.push_back(m);
+    return false;
+  });
+  ASSERT_EQ(first.size(), 1);
+  EXPECT_EQ(first[0], (match{0, 7}));
+}
+
+// Patterns may use every byte value, which needs one more class than a byte can number
+TEST(UstringMatcherTest, AllByteValues)
+{
+  std::string all;
+  for (int b = 0; b < 256; ++b) {
+    all += static_cast<char>(b);
+  }
+  const std::vector<ustring> patterns = {ustring(all.data(), all.size()), ustring("\xFF")};
+  ustring_matcher matcher(patterns);
+
+  all += '\xFF';
+  ustring text(all.data(), all.size());
+  std::vector<match> expected = {{0, 0}, {1, 255}, {1, 256}};
+  EXPECT_EQ(matcher.find_all(text.to_view()), expected);
+  EXPECT_FALSE(matcher.contains_any(ustring("abc").to_view()));
+}
+
+TEST(UstringMatcherTest, Boundaries)
+{
+  // "\xA9" is the last byte of U+00E9
+  const std::vector<ustring> patterns = {ustring("\xA9"), u8"e"};
+  ustring text = u8"e\u0301t\u00e9";
+
+  ustring_matcher bytes(patterns);
+  std::vector<match> expected = {{1, 0}, {0, 5}};
+  EXPECT_EQ(bytes.find_all(text.to_view()), expected);
+
+  ustring_matcher code_points(patterns, ustring_matcher::Boundary::CODE_POINT);
+  expected = {{1, 0}};
+  EXPECT_EQ(code_points.find_all(text.to_view()), expected);
+
+  // "e" followed by a combining acute accent is a single grapheme
+  ustring_matcher graphemes(patterns, ustring_matcher::Boundary::GRAPHEME);
+  EXPECT_TRUE(graphemes.find_all(text.to_view()).empty());
+  EXPECT_TRUE(graphemes.contains_any(ustring(u8"ae").to_view()));
+}
+
@@ -1,6 +1,10 @@
 #include "ustring.h"
+#include <atomic>
+#include <bit>
 #include <gtest/gtest.h>
 #include <string>
+#include <thread>
+#include <vector>
 
 class UStringModificationTest : public ::testing::Test {
  protected:
@@ -76,6 +80,46 @@ TEST_F(UStringModificationTest, OperatorPlusEqualsChar)
   EXPECT_EQ(str, ustring("Hello!"));
 }
 
+TEST_F(UStringModificationTest, Concat)
+{
+  const ustring dir(u8"/home/用户");
+  const std::string name = "report";
+  const ustring path = ustring::concat(dir, u8'/', name, std::string_view("-2024"), ".txt");
+  EXPECT_EQ(path, ustring(u8"/home/用户/report-2024.txt"));
+  EXPECT_EQ(path.capacity(), path.size());
+  EXPECT_TRUE(ustring::concat().empty());
+  EXPECT_EQ(ustring::concat(dir.to_view()), dir);
+
+  // temporaries on the left are appended to in place
+  ustring chained = ustring(u8"a") + ustring(u8"b") + u8"c" + u8'd';
+  EXPECT_EQ(chained, ustring(u8"abcd"));
+
+  // appending a string to itself survives the reallocation
+  ustring self(std::string(20, 'x'));
+  self.append(self);
+  EXPECT_EQ(self, ustring(std::string(40, 'x')));
+  ustring moved = std::move(self) + self;
+  EXPECT_EQ(moved.size(), 80);
+}
+
+TEST_F(UStringModificationTest, Join)
+{
+  const ustring source(u8"alpha,βeta,gamma,delta");
+  const std::vector<ustring::view> parts = source.split(u8',');
+  ASSERT_EQ(parts.size(), 4);
+  const ustring joined = ustring::join(parts, ustring(u8" | "));
+  EXPECT_EQ(joined, ustring(u8"alpha | βeta | gamma | delta"));
+  // measured up front, so nothing was over-allocated by growth
+  EXPECT_EQ(joined.capacity(), joined.size());
+
+  EXPECT_EQ(ustring::join(std::vector<std::string>{"a", "b"}), ustring("ab"));
+  EXPECT_EQ(ustring::join(std::vector<std::u16string>{u"x", u"y"}, ustring(u8"-")),
+            ustring(u8"x-y"));
+  EXPECT_TRUE(ustring::join(std::vector<ustring>{}, ustring(u8",")).empty());
+  EXPECT_EQ(ustring::join(std::vector<ustring>{ustring(u8"only")}, ustring(u8",")),
+            ustring(u8"only"));
+}
+
 // Test push_back and pop_back
 TEST_F(UStringModificationTest, PushBackPopBack)
 {
@@ -176,6 +220,57 @@ TEST_F(UStringModificationTest, CapacityManagement)
   EXPECT_EQ(str.size(), long_string.length());
 }
 
+// Test growth policy
+TEST_F(UStringModificationTest, GrowthPolicy)
+{
+  const auto saved = ustring::get_growth_policy();
+  auto count_reallocations = [](int n) {
+    ustring str;
+    int reallocations = 0;
+    for (int i = 0; i < n; ++i) {
+      const auto capacity = str.capacity();
+      str.push_back(u8'a' + i % 26);
+      reallocations += str.capacity() != capacity;
+      EXPECT_GE(str.capacity(), str.size());
+    }
+    EXPECT_EQ(str.size(), n);
+    EXPECT_EQ(str[n - 1], u8'a' + (n - 1) % 26);
+    return reallocations;
+  };
+
+  ustring::set_growth_policy({ustring::growth_policy::Factor::DOUBLE, false});
+  ustring str(std::string(24, 'a'));
+  const auto capacity = str.capacity();
+  str.push_back(u8'b');
+  EXPECT_EQ(str.capacity(), capacity * 2);
+  EXPECT_LE(count_reallocations(10000), 10);
+
+  ustring::set_growth_policy({ustring::growth_policy::Factor::ONE_AND_A_HALF, true});
+  EXPECT_LE(count_reallocations(10000), 20);
+
+  // size classes
+  for (int n : {24, 40, 65, 100, 1000, 5000}) {
+    ustring grown;
+    grown.resize(n);
+    const auto cap = static_cast<uint32_t>(grown.capacity());
+    EXPECT_GE(cap, static_cast<uint32_t>(n));
+    EXPECT_TRUE(cap <= 64 ? cap % 8 == 0 : cap % (std::bit_floor(cap - 1) / 4) == 0) << n;
+  }
+
+  // reserve and shrink_to_fit stay exact
+  ustring exact;
+  exact.reserve(1001);
+  EXPECT_EQ(exact.capacity(), 1001);
+  exact.resize(1001, u8'x');
+  EXPECT_EQ(exact.capacity(), 1001);
+  exact.append("yz");
+  EXPECT_GT(exact.capacity(), 1003);
+  exact.shrink_to_fit();
+  EXPECT_EQ(exact.capacity(), 1003);
+
+  ustring::set_growth_policy(saved);
+}
+
 // Test chaining operations
 TEST_F(UStringModificationTest, ChainedOperations)
 {
@@ -388,3 +483,56 @@ TEST_F(UStringModificationTest, SurrogatePairs)
   EXPECT_EQ(str.length(), 4);
   EXPECT_EQ(str.size(), ustring(u8"⭐🌍🌟🎉").size());
 }
+
+// The cached code point count must follow every modification
+TEST_F(UStringModificationTest, LengthAfterModification)
+{
+  ustring str(u8"你好");
+  EXPECT_EQ(str.length(), 2);
+  str.append(u8"世界");
+  EXPECT_EQ(str.length(), 4);
+  str.insert(0, u8"😀");
+  EXPECT_EQ(str.length(), 5);
+  str.erase(0, 4);
+  EXPECT_EQ(str.length(), 4);
+  str.resize(6);
+  EXPECT_EQ(str.length(), 2);
+  str.data()[0] = 'a';
+  str.data()[1] = 'b';
+  str.data()[2] = 'c';
+  EXPECT_EQ(str.length(), 4);
+
+  ustring copy(str);
+  EXPECT_EQ(copy.length(), 4);
+  copy.push_back('d');
+  EXPECT_EQ(copy.length(), 5);
+  EXPECT_EQ(str.length(), 4);
+  copy.swap(str);
+  EXPECT_EQ(copy.length(), 4);
+  EXPECT_EQ(str.length(), 5);
+  str.clear();
+  EXPECT_EQ(str.length(), 0);
+
+  std::u8string long_text;
+  for (int i = 0; i < 1000; ++i) {
+    long_text += u8"aé你😀";
+  }
+  EXPECT_EQ(ustring(long_text).length(), 4000);
+  EXPECT_EQ(ustring::view(ustring(long_text)).length(), 4000);
+
+  // const calls on a shared string fill the cache concurrently
+  const ustring shared(long_text);
+  std::vector<std::thread> threads;
+  std::atomic<int> mismatches = 0;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 100; ++i) {
+        mismatches += shared.length() != 4000 || ustring(shared).length() != 4000;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(mismatches, 0);
+}
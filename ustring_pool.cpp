@@ -0,0 +1,146 @@
+#include "ustring_pool.h"
+
+#include <bit>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+// Where id lives in the segmented id table
+std::pair<size_t, size_t> id_slot(uint32_t id, size_t first_segment_bits)
+{
+  const uint64_t biased = uint64_t{id} + (uint64_t{1} << first_segment_bits);
+  const size_t segment = std::bit_width(biased) - 1 - first_segment_bits;
+  return {segment, static_cast<size_t>(biased - (uint64_t{1} << (segment + first_segment_bits)))};
+}
+
+}  // namespace
+
+ustring_pool::ustring_pool() = default;
+
+ustring_pool::~ustring_pool()
+{
+  for (auto &segment : _segments) {
+    delete[] segment.load(std::memory_order_relaxed);
+  }
+}
+
+const ustring_pool::entry *ustring_pool::probe(const table &t,
+                                               ustring::view str,
+                                               size_t hash) noexcept
+{
+  for (size_t i = hash & t.mask;; i = (i + 1) & t.mask) {
+    const entry *e = t.slots[i].load(std::memory_order_acquire);
+    if (!e) {
+      return nullptr;
+    }
+    if (e->hash == hash && e->size == str.size() &&
+        std::memcmp(e->bytes(), str.data(), str.size()) == 0)
+    {
+      return e;
+    }
+  }
+}
+
+std::optional<interned_ustring> ustring_pool::find(ustring::view str) const noexcept
+{
+  if (str.empty()) {
+    return interned_ustring();
+  }
+  const size_t hash = str.hash();
+  const table *t = shard_of(hash).current.load(std::memory_order_acquire);
+  if (const entry *e = t ? probe(*t, str, hash) : nullptr) {
+    return interned_ustring(e);
+  }
+  return std::nullopt;
+}
+
+interned_ustring ustring_pool::intern(ustring::view str)
+{
+  if (str.empty()) {
+    return interned_ustring();
+  }
+  const size_t hash = str.hash();
+  shard &s = shard_of(hash);
+  if (const table *t = s.current.load(std::memory_order_acquire)) {
+    if (const entry *e = probe(*t, str, hash)) {
+      return interned_ustring(e);
+    }
+  }
+
+  std::lock_guard lock(s.mutex);
+  table *t = s.current.load(std::memory_order_relaxed);
+  if (t) {
+    // another thread may have added it since the lookup above
+    if (const entry *e = probe(*t, str, hash)) {
+      return interned_ustring(e);
+    }
+  }
+
+  if (!t || (s.count + 1) * 2 > t->mask + 1) {
+    auto grown = std::make_unique<table>(t ? (t->mask + 1) * 2 : 64);
+    if (t) {
+      for (size_t i = 0; i <= t->mask; ++i) {
+        if (const entry *e = t->slots[i].load(std::memory_order_relaxed)) {
+          size_t j = e->hash & grown->mask;
+          while (grown->slots[j].load(std::memory_order_relaxed)) {
+            j = (j + 1) & grown->mask;
+          }
+          grown->slots[j].store(e, std::memory_order_relaxed);
+        }
+      }
+    }
+    t = grown.get();
+    s.tables.push_back(std::move(grown));
+    s.current.store(t, std::memory_order_release);
+  }
+
+  // Ids stop at UINT32_MAX - 1: the counter must never wrap back to 0, the empty string
+  uint32_t id = _next_id.load(std::memory_order_relaxed);
+  do {
+    if (id == UINT32_MAX) {
+      throw std::length_error("ustring_pool::intern: out of ids");
+    }
+  } while (!_next_id.compare_exchange_weak(id, id + 1, std::memory_order_relaxed));
+  void *memory = s.arena.allocate(sizeof(entry) + str.size() + 1, alignof(entry));
+  auto *e = ::new (memory) entry{hash, id, str.size()};
+  auto *bytes = reinterpret_cast<ustring::value_type *>(e + 1);
+  std::memcpy(bytes, str.data(), str.size());
+  bytes[str.size()] = 0;
+
+  // The id must resolve before anyone can find the entry and ask for it
+  publish_id(e);
+  size_t i = hash & t->mask;
+  while (t->slots[i].load(std::memory_order_relaxed)) {
+    i = (i + 1) & t->mask;
+  }
+  t->slots[i].store(e, std::memory_order_release);
+  ++s.count;
+  return interned_ustring(e);
+}
+
+interned_ustring ustring_pool::operator[](uint32_t id) const noexcept
+{
+  if (id == 0) {
+    return interned_ustring();
+  }
+  const auto [segment, offset] = id_slot(id, first_segment_bits);
+  return interned_ustring(
+      _segments[segment].load(std::memory_order_acquire)[offset].load(std::memory_order_acquire));
+}
+
+void ustring_pool::publish_id(const entry *e)
+{
+  const auto [segment, offset] = id_slot(e->id, first_segment_bits);
+  std::atomic<const entry *> *slots = _segments[segment].load(std::memory_order_acquire);
+  if (!slots) {
+    std::lock_guard lock(_segment_mutex);
+    slots = _segments[segment].load(std::memory_order_relaxed);
+    if (!slots) {
+      slots = new std::atomic<const entry *>[size_t{1} << (segment + first_segment_bits)]();
+      _segments[segment].store(slots, std::memory_order_release);
+    }
+  }
+  slots[offset].store(e, std::memory_order_release);
+}
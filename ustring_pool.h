@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "ustring.h"
+
+class ustring_pool;
+
+// A string deduplicated by a ustring_pool. It is a pointer to the pool's only copy of the bytes,
+// so handles from the same pool are equal exactly when their contents are, and comparing them is
+// one integer compare. The hash is computed once, when the string is interned, and equals
+// ustring::view::hash() of the contents. A default constructed handle is the empty string, id 0.
+class interned_ustring {
+ public:
+  using value_type = ustring::value_type;
+  using size_type = ustring::size_type;
+
+  interned_ustring() noexcept = default;
+
+  // Dense per-pool id, see ustring_pool::operator[]
+  [[nodiscard]] uint32_t id() const noexcept
+  {
+    return _entry ? _entry->id : 0;
+  }
+  [[nodiscard]] size_t hash() const noexcept
+  {
+    return _entry ? _entry->hash : ustring::view().hash();
+  }
+  [[nodiscard]] const value_type *data() const noexcept
+  {
+    return _entry ? _entry->bytes() : nullptr;
+  }
+  [[nodiscard]] size_type size() const noexcept
+  {
+    return _entry ? _entry->size : 0;
+  }
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return _entry == nullptr;
+  }
+  [[nodiscard]] ustring::view to_view() const noexcept
+  {
+    return {data(), size()};
+  }
+  operator ustring::view() const noexcept
+  {
+    return to_view();
+  }
+
+  // Only meaningful for handles from the same pool
+  friend bool operator==(interned_ustring lhs, interned_ustring rhs) noexcept
+  {
+    return lhs._entry == rhs._entry;
+  }
+
+ private:
+  friend class ustring_pool;
+
+  // Lives in the pool's arena, followed by `size` bytes and a terminating zero
+  struct entry {
+    size_t hash;
+    uint32_t id;
+    size_type size;
+
+    const value_type *bytes() const noexcept
+    {
+      return reinterpret_cast<const value_type *>(this + 1);
+    }
+  };
+
+  explicit interned_ustring(const entry *e) noexcept : _entry(e) {}
+
+  const entry *_entry = nullptr;
+};
+
+template<> struct std::hash<interned_ustring> {
+  size_t operator()(const interned_ustring &str) const noexcept
+  {
+    return str.hash();
+  }
+};
+
+// Thread-safe intern table. Strings are spread over shards by hash. Looking up a string that is
+// already interned takes no lock; adding one locks its shard only. The bytes are copied into
+// per-shard arenas, so interning does not allocate per string, and they stay put until the pool
+// is destroyed: handles and views from it are valid for the pool's whole lifetime.
+class ustring_pool {
+ public:
+  ustring_pool();
+  ~ustring_pool();
+  ustring_pool(const ustring_pool &) = delete;
+  ustring_pool &operator=(const ustring_pool &) = delete;
+
+  // The handle of `str`, adding it to the pool first if needed
+  [[nodiscard]] interned_ustring intern(ustring::view str);
+  // The handle of `str` if it is already in the pool. Never locks.
+  [[nodiscard]] std::optional<interned_ustring> find(ustring::view str) const noexcept;
+  // The string with the given id, which must come from this pool
+  [[nodiscard]] interned_ustring operator[](uint32_t id) const noexcept;
+
+  // Distinct non-empty strings interned so far
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return _next_id.load(std::memory_order_relaxed) - 1;
+  }
+
+ private:
+  using entry = interned_ustring::entry;
+
+  static constexpr size_t shard_bits = 6;
+  static constexpr size_t shard_count = size_t{1} << shard_bits;
+  // Id segment s holds first_segment << s ids, so 23 segments cover every 32-bit id
+  static constexpr size_t first_segment_bits = 10;
+  static constexpr size_t segment_count = 33 - first_segment_bits;
+
+  // Open addressing with linear probing, at most half full. Slots are only ever filled, so
+  // readers can probe without locking.
+  struct table {
+    explicit table(size_t capacity)
+        : mask(capacity - 1), slots(std::make_unique<std::atomic<const entry *>[]>(capacity))
+    {
+    }
+
+    size_t mask;
+    std::unique_ptr<std::atomic<const entry *>[]> slots;
+  };
+
+  struct alignas(64) shard {
+    std::mutex mutex;
+    std::atomic<table *> current{nullptr};
+    // Replaced tables are kept until the pool dies, a reader may still be probing them
+    std::vector<std::unique_ptr<table>> tables;
+    size_t count = 0;
+    std::pmr::monotonic_buffer_resource arena;
+  };
+
+  static const entry *probe(const table &t, ustring::view str, size_t hash) noexcept;
+  shard &shard_of(size_t hash) const noexcept
+  {
+    return _shards[hash >> (sizeof(size_t) * 8 - shard_bits)];
+  }
+  void publish_id(const entry *e);
+
+  mutable std::array<shard, shard_count> _shards;
+  std::array<std::atomic<std::atomic<const entry *> *>, segment_count> _segments{};
+  std::mutex _segment_mutex;
+  std::atomic<uint32_t> _next_id{1};
+};
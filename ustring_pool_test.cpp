@@ -0,0 +1,99 @@
+#include "ustring_pool.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+TEST(UstringPoolTest, InternDeduplicates)
+{
+  ustring_pool pool;
+  const interned_ustring a = pool.intern(ustring(u8"identifier"));
+  const interned_ustring b = pool.intern(ustring(u8"identifier"));
+  const interned_ustring c = pool.intern(ustring(u8"标识符"));
+  EXPECT_EQ(a, b);
+  EXPECT_NE(a, c);
+  EXPECT_EQ(a.id(), b.id());
+  EXPECT_NE(a.id(), c.id());
+  EXPECT_EQ(a.data(), b.data());
+  EXPECT_EQ(ustring(a.to_view()), ustring(u8"identifier"));
+  EXPECT_EQ(a.hash(), ustring(u8"identifier").hash());
+  EXPECT_EQ(a.data()[a.size()], u8'\0');
+  EXPECT_EQ(pool.size(), 2);
+
+  EXPECT_EQ(pool[a.id()], a);
+  EXPECT_EQ(pool[c.id()], c);
+
+  const ustring missing(u8"missing");
+  EXPECT_FALSE(pool.find(missing).has_value());
+  EXPECT_EQ(pool.find(ustring(u8"标识符")), c);
+}
+
+TEST(UstringPoolTest, EmptyString)
+{
+  ustring_pool pool;
+  const interned_ustring empty = pool.intern(ustring());
+  EXPECT_EQ(empty, interned_ustring());
+  EXPECT_EQ(empty.id(), 0);
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.hash(), ustring().hash());
+  EXPECT_EQ(pool[0], empty);
+  EXPECT_EQ(pool.find(ustring()), empty);
+  EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(UstringPoolTest, ManyStrings)
+{
+  ustring_pool pool;
+  std::vector<interned_ustring> handles;
+  for (int i = 0; i < 50000; ++i) {
+    handles.push_back(pool.intern(ustring("name_" + std::to_string(i))));
+  }
+  EXPECT_EQ(pool.size(), 50000);
+
+  std::unordered_set<uint32_t> ids;
+  std::unordered_set<interned_ustring> set(handles.begin(), handles.end());
+  EXPECT_EQ(set.size(), 50000);
+  for (int i = 0; i < 50000; ++i) {
+    const ustring name("name_" + std::to_string(i));
+    ASSERT_EQ(pool.intern(name), handles[i]);
+    ASSERT_EQ(pool[handles[i].id()], handles[i]);
+    ASSERT_EQ(ustring(handles[i].to_view()), name);
+    ids.insert(handles[i].id());
+  }
+  EXPECT_EQ(ids.size(), 50000);
+  EXPECT_EQ(*std::max_element(ids.begin(), ids.end()), 50000);
+}
+
+TEST(UstringPoolTest, ConcurrentIntern)
+{
+  ustring_pool pool;
+  constexpr int threads = 4;
+  constexpr int names = 20000;
+  std::vector<std::vector<interned_ustring>> results(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&pool, &results, t]() {
+      // every thread interns the same names, in a different order
+      for (int i = 0; i < names; ++i) {
+        const int n = (i * (2 * t + 1)) % names;
+        results[t].push_back(pool.intern(ustring("name_" + std::to_string(n))));
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  EXPECT_EQ(pool.size(), names);
+  for (int t = 0; t < threads; ++t) {
+    for (int i = 0; i < names; ++i) {
+      const int n = (i * (2 * t + 1)) % names;
+      const interned_ustring handle = results[t][i];
+      ASSERT_EQ(handle, results[0][n]);
+      ASSERT_EQ(pool[handle.id()], handle);
+      ASSERT_EQ(ustring(handle.to_view()), ustring("name_" + std::to_string(n)));
+    }
+  }
+}
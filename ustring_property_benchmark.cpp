@@ -114,7 +114,8 @@ BENCHMARK(BM_ToCodepoint_Emoji);
 static void BM_String_Contains_Property(benchmark::State& state) {
     ustring str(reinterpret_cast<const char*>(long_text.c_str()));
     for (auto _ : state) {
-        benchmark::DoNotOptimize(str.contains(CharProperty::IDEOGRAPHIC));
+        benchmark::DoNotOptimize(
+            str.contains([](char32_t c) { return has_property(c, CharProperty::IDEOGRAPHIC); }));
     }
 }
 BENCHMARK(BM_String_Contains_Property);
@@ -200,4 +201,90 @@ static void BM_CodePoint_Conversion_Range(benchmark::State& state) {
 }
 BENCHMARK(BM_CodePoint_Conversion_Range)->Range(8, 8<<10);
 
+// Throughput of the property lookup itself
+static void BM_GetProperty_AllCodePoints(benchmark::State& state) {
+    for (auto _ : state) {
+        uint32_t any = 0;
+        for (char32_t c = 0; c <= 0x10FFFF; ++c) {
+            any |= static_cast<uint32_t>(get_property(c));
+        }
+        benchmark::DoNotOptimize(any);
+    }
+    state.SetItemsProcessed(state.iterations() * 0x110000);
+}
+BENCHMARK(BM_GetProperty_AllCodePoints);
+
+static void BM_HasProperty_LongText(benchmark::State& state) {
+    ustring str(reinterpret_cast<const char*>(long_text.c_str()));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            str.count([](char32_t c) { return has_property(c, CharProperty::ALPHABETIC); }));
+    }
+    state.SetBytesProcessed(state.iterations() * str.size());
+}
+BENCHMARK(BM_HasProperty_LongText);
+
+static void BM_IsAlpha(benchmark::State& state) {
+    ustring str;
+    for (int i = 0; i < 64; ++i) {
+        str.append(u8"abcXYZéñπДжあ漢");
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(str.is_alpha());
+    }
+    state.SetBytesProcessed(state.iterations() * str.size());
+}
+BENCHMARK(BM_IsAlpha);
+
+static void BM_IsSpace(benchmark::State& state) {
+    ustring str;
+    for (int i = 0; i < 256; ++i) {
+        str.append(u8" \t\u3000\n");
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(str.is_space());
+    }
+    state.SetBytesProcessed(state.iterations() * str.size());
+}
+BENCHMARK(BM_IsSpace);
+
+// Whole-buffer validation, which runs a block of ASCII at a time
+static const ustring& large_digits() {
+    static const ustring str(std::string(1 << 20, '7'));
+    return str;
+}
+
+static void BM_IsDigit_Large(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(large_digits().is_digit());
+    }
+    state.SetBytesProcessed(state.iterations() * large_digits().size());
+}
+BENCHMARK(BM_IsDigit_Large);
+
+static void BM_FindFirstNotProperty_Large(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(large_digits().find_first_not_property(CharProperty::DIGIT));
+    }
+    state.SetBytesProcessed(state.iterations() * large_digits().size());
+}
+BENCHMARK(BM_FindFirstNotProperty_Large);
+
+static void BM_CountProperty_Large(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(large_digits().count_property(CharProperty::DIGIT));
+    }
+    state.SetBytesProcessed(state.iterations() * large_digits().size());
+}
+BENCHMARK(BM_CountProperty_Large);
+
+static void BM_CountProperty_LongText(benchmark::State& state) {
+    ustring str(reinterpret_cast<const char*>(long_text.c_str()));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(str.count_property(CharProperty::ALPHABETIC));
+    }
+    state.SetBytesProcessed(state.iterations() * str.size());
+}
+BENCHMARK(BM_CountProperty_LongText);
+
 BENCHMARK_MAIN();
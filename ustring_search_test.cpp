@@ -1,5 +1,7 @@
 #include "ustring.h"
 #include <gtest/gtest.h>
+#include <unordered_map>
+#include <unordered_set>
 
 class UstringSearchTest : public ::testing::Test {
  protected:
@@ -234,3 +236,246 @@ TEST_F(UstringSearchTest, ComplexUnicodeStrings)
   EXPECT_EQ(zwj.find(u8"👨‍👩‍👧‍👦"), 0u);
   EXPECT_EQ(zwj.find(u8"Family"), sizeof("👨‍👩‍👧‍👦 ") - 1);
 }
+
+// Needle lengths crossing every search strategy, on periodic text
+TEST_F(UstringSearchTest, FindNeedleLengths)
+{
+  std::u8string text_u8;
+  for (int i = 0; i < 40; ++i) {
+    text_u8 += u8"abaabaab世界";
+  }
+  text_u8 += u8"abaabaab界世";
+  ustring text(text_u8);
+
+  for (size_t len = 1; len <= 80; ++len) {
+    for (size_t start : {size_t(0), size_t(3), text_u8.size() - len}) {
+      const std::u8string needle_u8 = text_u8.substr(start, len);
+      const ustring needle(needle_u8);
+      EXPECT_EQ(text.find(needle), text_u8.find(needle_u8)) << len;
+      EXPECT_EQ(text.find(needle, 17), text_u8.find(needle_u8, 17)) << len;
+      EXPECT_EQ(text.rfind(needle), text_u8.rfind(needle_u8)) << len;
+      EXPECT_EQ(text.rfind(needle, 100), text_u8.rfind(needle_u8, 100)) << len;
+      EXPECT_TRUE(text.contains(needle));
+    }
+  }
+  EXPECT_EQ(text.find(ustring(u8"abaabaab界世abaab")), ustring::npos);
+  EXPECT_EQ(text.rfind(ustring(u8"世界世界")), ustring::npos);
+  EXPECT_FALSE(text.contains(ustring(u8"世界世界")));
+}
+
+TEST_F(UstringSearchTest, FindOfLongText)
+{
+  std::u8string text_u8;
+  for (int i = 0; i < 20; ++i) {
+    text_u8 += u8"key = value; 世界\t";
+  }
+  text_u8 += u8"(end)";
+  ustring text(text_u8);
+
+  for (const std::u8string set : {u8" \t;", u8"=()", u8"aekuy", u8"世", u8"(\xE7", u8"~"}) {
+    for (size_t pos : {size_t(0), size_t(5), size_t(37), text_u8.size() - 1}) {
+      EXPECT_EQ(text.find_first_of(set.data(), pos, set.size()),
+                text_u8.find_first_of(set, pos));
+      EXPECT_EQ(text.find_first_not_of(set.data(), pos, set.size()),
+                text_u8.find_first_not_of(set, pos));
+      EXPECT_EQ(text.find_last_of(set.data(), pos, set.size()), text_u8.find_last_of(set, pos));
+      EXPECT_EQ(text.find_last_not_of(set.data(), pos, set.size()),
+                text_u8.find_last_not_of(set, pos));
+    }
+  }
+
+  const std::u8string spaces_u8(100, u8' ');
+  ustring spaces(spaces_u8);
+  EXPECT_EQ(spaces.find_first_not_of(u8' '), ustring::npos);
+  EXPECT_EQ(spaces.find_last_not_of(u8' '), ustring::npos);
+  EXPECT_EQ(spaces.find_first_of(u8" ", 99), 99u);
+  EXPECT_EQ(spaces.find_last_of(u8" ", 0), 0u);
+}
+
+TEST_F(UstringSearchTest, CountSubstring)
+{
+  EXPECT_EQ(repeated.count(ustring(u8"hello")), 3);
+  EXPECT_EQ(repeated.count(u8"l"), 6);
+  EXPECT_EQ(repeated.count(u8"xyz"), 0);
+  EXPECT_EQ(hello.count(ustring(u8"Hello, World! and more")), 0);
+  EXPECT_EQ(empty.count(u8"a"), 0);
+  // overlapping occurrences are counted
+  EXPECT_EQ(ustring(u8"aaaa").count(u8"aa"), 3);
+  EXPECT_EQ(ustring(u8"世界世界世界").count(u8"世界", 6), 3);
+}
+
+TEST_F(UstringSearchTest, Searcher)
+{
+  const ustring::searcher hello_searcher(ustring(u8"hello"));
+  EXPECT_EQ(repeated.find(hello_searcher), 0);
+  EXPECT_EQ(repeated.find(hello_searcher, 1), repeated_u8.find(u8"hello", 1));
+  EXPECT_EQ(repeated.rfind(hello_searcher), repeated_u8.rfind(u8"hello"));
+  EXPECT_EQ(repeated.rfind(hello_searcher, 11), repeated_u8.rfind(u8"hello", 11));
+  EXPECT_EQ(hello.find(hello_searcher), ustring::npos);
+  EXPECT_EQ(repeated.to_view().find(hello_searcher, 6), 6);
+  EXPECT_EQ(repeated.count(hello_searcher), 3);
+
+  const ustring::searcher world(ustring(u8"世界"));
+  EXPECT_EQ(mixed.find(world), mixed_u8.find(u8"世界"));
+  EXPECT_EQ(ustring(world.needle()), ustring(u8"世界"));
+
+  // a long needle takes the Two-Way path
+  ustring long_text(u8"xxxx");
+  const ustring long_needle(u8"abcdefghijklmnopqrstuvwxyz世界abcdefghijklmnopqrstuvwxyz");
+  long_text.append(long_needle).append(u8"yy").append(long_needle);
+  const ustring::searcher long_searcher(long_needle);
+  EXPECT_EQ(long_text.find(long_searcher), 4);
+  EXPECT_EQ(long_text.rfind(long_searcher), 4 + long_needle.size() + 2);
+  EXPECT_EQ(long_text.count(long_searcher), 2);
+
+  // std::search
+  EXPECT_EQ(std::search(mixed.begin(), mixed.end(), world) - mixed.begin(), mixed_u8.find(u8"世界"));
+  EXPECT_EQ(std::search(hello.begin(), hello.end(), world), hello.end());
+}
+
+TEST_F(UstringSearchTest, SplitAndReplace)
+{
+  const ustring::searcher comma(ustring(u8", "));
+  auto parts = mixed.split(comma);
+  ASSERT_EQ(parts.size(), 3);
+  EXPECT_EQ(ustring(parts[0]), ustring(u8"Hello"));
+  EXPECT_EQ(ustring(parts[1]), ustring(u8"世界! Hello"));
+  EXPECT_EQ(ustring(parts[2]), ustring(u8"World!"));
+  EXPECT_EQ(mixed.split(ustring(u8", ")).size(), 3);
+  EXPECT_EQ(ustring(ustring(u8"世界x世界").split(ustring(u8"x"))[1]), ustring(u8"世界"));
+
+  ustring text(u8"hello hello hello");
+  text.replace(ustring::searcher(ustring(u8"hello")), ustring(u8"你好"));
+  EXPECT_EQ(text, ustring(u8"你好 你好 你好"));
+  text.replace(ustring(u8"你好 "), ustring());
+  EXPECT_EQ(text, ustring(u8"你好"));
+  text.replace(ustring(u8"absent"), ustring(u8"x"));
+  EXPECT_EQ(text, ustring(u8"你好"));
+  EXPECT_EQ(ustring(u8"aaaa").replace(ustring(u8"aa"), ustring(u8"b")), ustring(u8"bb"));
+}
+
+TEST_F(UstringSearchTest, LazySplit)
+{
+  auto collect = [](const ustring::split_view &range) {
+    std::vector<ustring> pieces;
+    for (const ustring::view &piece : range) {
+      pieces.emplace_back(ustring(piece));
+    }
+    return pieces;
+  };
+  using pieces = std::vector<ustring>;
+
+  ustring csv(u8",a,世界,,b,");
+  EXPECT_EQ(collect(csv.lazy_split(U',')), (pieces{u8"", u8"a", u8"世界", u8"", u8"b"}));
+  EXPECT_EQ(csv.split(U',').size(), 5);
+  EXPECT_EQ(collect(ustring(u8"1世2世3").lazy_split(U'世')), (pieces{u8"1", u8"2", u8"3"}));
+  EXPECT_EQ(collect(csv.lazy_split(U'x')), (pieces{csv}));
+  EXPECT_EQ(collect(csv.lazy_split(char32_t(0x110000))), (pieces{csv}));
+
+  ustring delimiter(u8"::");
+  EXPECT_EQ(collect(ustring(u8"a::b:c::").lazy_split(delimiter.to_view())),
+            (pieces{u8"a", u8"b:c"}));
+  EXPECT_TRUE(collect(csv.lazy_split(ustring::view())).empty());
+  EXPECT_TRUE(collect(empty.lazy_split(U',')).empty());
+
+  ustring text(u8"first\nsecond\r\n\r\nthird\rlast\n");
+  EXPECT_EQ(collect(text.lines()), (pieces{u8"first", u8"second", u8"", u8"third", u8"last"}));
+  EXPECT_EQ(std::ranges::distance(ustring(u8"no break").lines()), 1);
+
+  ustring mixed_text(u8"ab世界c😊");
+  EXPECT_EQ(collect(mixed_text.chunks(2)), (pieces{u8"ab", u8"世界", u8"c😊"}));
+  EXPECT_EQ(collect(mixed_text.chunks(4)), (pieces{u8"ab世界", u8"c😊"}));
+  EXPECT_TRUE(collect(mixed_text.chunks(0)).empty());
+
+  // The set overload cuts at code point boundaries of the UTF-8 data
+  ustring greetings(u8"世界,你好;再见");
+  auto parts = greetings.split(std::unordered_set<char32_t>{U',', U';'});
+  ASSERT_EQ(parts.size(), 3);
+  EXPECT_EQ(ustring(parts[1]), ustring(u8"你好"));
+  EXPECT_EQ(ustring(parts[2]), ustring(u8"再见"));
+
+  static_assert(std::ranges::forward_range<ustring::split_view>);
+  auto first_two = text.lines() | std::views::take(2);
+  EXPECT_EQ(ustring((*std::ranges::next(first_two.begin()))), ustring(u8"second"));
+}
+
+// Test hashing
+TEST_F(UstringSearchTest, Hash)
+{
+  // fixed values, so hashes can be persisted and compared across platforms
+  EXPECT_EQ(empty.hash64(), 0x93228a4de0eec5a2ull);
+  EXPECT_EQ(ustring(u8"hello").hash64(), 0x49a593f92a7c549full);
+  EXPECT_EQ(ustring(u8"hello").hash64(42), 0x70e00a0b3d24ddffull);
+  EXPECT_EQ(ustring(std::string(100, 'x')).hash64(), 0x39d3b1617320fdbfull);
+
+  EXPECT_EQ(mixed.hash(), mixed.to_view().hash());
+  EXPECT_EQ(mixed.hash(), std::hash<ustring>{}(mixed));
+  EXPECT_EQ(mixed.hash(), std::hash<ustring::view>{}(mixed.to_view()));
+  EXPECT_NE(mixed.hash64(1), mixed.hash64(2));
+
+  // every length, including the block boundaries, gives a different hash
+  std::u8string text;
+  std::unordered_set<uint64_t> seen;
+  for (int i = 0; i < 200; ++i) {
+    seen.insert(ustring::view(text.data(), static_cast<ustring::size_type>(text.size())).hash64());
+    text += static_cast<char8_t>(u8'a' + i % 7);
+  }
+  EXPECT_EQ(seen.size(), 200);
+
+  // incremental hashing matches hashing the whole text
+  const ustring::view whole(text.data(), static_cast<ustring::size_type>(text.size()));
+  for (ustring::size_type piece : {1, 5, 16, 47, 48, 49, 100}) {
+    ustring::hasher hasher(7);
+    for (ustring::size_type i = 0; i < whole.size(); i += piece) {
+      hasher.update(whole.substr_view(i, piece));
+    }
+    EXPECT_EQ(hasher.digest(), whole.hash64(7)) << piece;
+  }
+  EXPECT_EQ(ustring::hasher().digest(), empty.hash64());
+}
+
+TEST_F(UstringSearchTest, FoldedHash)
+{
+  auto folded_equal = [](const ustring &a, const ustring &b) {
+    return a.equals_folded(b) && a.hash64_folded() == b.hash64_folded();
+  };
+  EXPECT_TRUE(folded_equal(ustring(u8"Hello, World!"), ustring(u8"hELLO, wORLD!")));
+  EXPECT_TRUE(folded_equal(ustring(u8"Straße"), ustring(u8"STRASSE")));
+  EXPECT_TRUE(folded_equal(ustring(u8"ﬁle"), ustring(u8"FILE")));
+  EXPECT_TRUE(folded_equal(ustring(u8"Ｈｅｌｌｏ"), ustring(u8"hello")));
+  EXPECT_TRUE(folded_equal(ustring(u8"ÉCOLE"), ustring(u8"e\u0301cole")));
+  EXPECT_TRUE(folded_equal(empty, ustring()));
+  EXPECT_FALSE(ustring(u8"hello").equals_folded(ustring(u8"hello!")));
+  EXPECT_FALSE(ustring(u8"Straße").equals_folded(ustring(u8"strase")));
+  EXPECT_NE(ustring(u8"hello").hash64_folded(), ustring(u8"hallo").hash64_folded());
+
+  // long ASCII text that turns non-ASCII late
+  const ustring upper = ustring(std::string(100, 'A')) + ustring(u8"É");
+  const ustring lower = ustring(std::string(100, 'a')) + ustring(u8"é");
+  EXPECT_TRUE(folded_equal(upper, lower));
+}
+
+TEST_F(UstringSearchTest, HeterogeneousLookup)
+{
+  const std::unordered_set<ustring, std::hash<ustring>, std::equal_to<>> keys = {hello, mixed};
+  EXPECT_TRUE(keys.contains(hello.to_view()));
+  EXPECT_TRUE(keys.contains(mixed.substr_view(0)));
+  EXPECT_FALSE(keys.contains(hello.substr_view(1)));
+
+  std::unordered_map<ustring, int, ustring_hash, ustring_equal> map;
+  map.emplace(hello, 1);
+  map.emplace(mixed, 2);
+  EXPECT_EQ(map.find(hello.to_view())->second, 1);
+  EXPECT_EQ(map.find(mixed.to_u8string_view())->second, 2);
+  EXPECT_EQ(map.find(hello.to_string_view())->second, 1);
+  EXPECT_EQ(map.find(std::string(hello.to_string_view()))->second, 1);
+  EXPECT_EQ(map.count(hello.substr_view(1)), 0);
+  EXPECT_EQ(map.count("not a key"), 0);
+  EXPECT_EQ(ustring_hash{}(hello), ustring_hash{}(hello.to_string_view()));
+
+  const std::unordered_set<ustring, ustring_folded_hash, ustring_folded_equal> folded = {
+      ustring(u8"Straße")};
+  EXPECT_TRUE(folded.contains(ustring(u8"STRASSE").to_view()));
+  EXPECT_TRUE(folded.contains(ustring(u8"strasse")));
+  EXPECT_FALSE(folded.contains(ustring(u8"strase")));
+}
@@ -0,0 +1,1524 @@
+#include "ustring_simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "compiler_features.h"
+#include "simd_traits.h"
+
+#if defined(USTRING_X64) || defined(USTRING_X86)
+#  include <immintrin.h>
+#endif
+#if defined(USTRING_MSVC)
+#  include <intrin.h>
+#endif
+
+namespace {
+
+using byte = uint8_t;
+
+FORCEINLINE bool is_ascii_word(const byte *p)
+{
+  uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+  return (word & 0x8080808080808080ull) == 0;
+}
+
+// Length of the well-formed sequence starting at non-ASCII `s[pos]`, or 0 if it is ill-formed
+// or truncated. Unicode 15, table 3-7.
+FORCEINLINE size_t sequence_length(const byte *s, size_t pos, size_t len)
+{
+  const byte lead = s[pos];
+  size_t trail;
+  byte lo = 0x80, hi = 0xBF;
+  if (lead < 0xC2) {
+    return 0;
+  }
+  else if (lead < 0xE0) {
+    trail = 1;
+  }
+  else if (lead < 0xF0) {
+    trail = 2;
+    if (lead == 0xE0)
+      lo = 0xA0;  // overlong
+    else if (lead == 0xED)
+      hi = 0x9F;  // surrogates
+  }
+  else if (lead < 0xF5) {
+    trail = 3;
+    if (lead == 0xF0)
+      lo = 0x90;  // overlong
+    else if (lead == 0xF4)
+      hi = 0x8F;  // > U+10FFFF
+  }
+  else {
+    return 0;
+  }
+
+  if (trail >= len - pos || s[pos + 1] < lo || s[pos + 1] > hi) {
+    return 0;
+  }
+  for (size_t i = 2; i <= trail; ++i) {
+    if ((s[pos + i] & 0xC0) != 0x80) {
+      return 0;
+    }
+  }
+  return trail + 1;
+}
+
+// Validation restarts from `pos`, which must be a sequence boundary.
+[[maybe_unused]] size_t validate_utf8_scalar(const byte *s, size_t pos, size_t len)
+{
+  while (pos < len) {
+    if (pos + 8 <= len && is_ascii_word(s + pos)) {
+      pos += 8;
+    }
+    else if (s[pos] < 0x80) {
+      ++pos;
+    }
+    else {
+      const size_t n = sequence_length(s, pos, len);
+      if (n == 0) {
+        return pos;
+      }
+      pos += n;
+    }
+  }
+  return len;
+}
+
+// After a vector block at `pos` reports an error, the offending sequence may have started in
+// the last three bytes of the previous (valid) block. Step back to its lead byte so the scalar
+// validator restarts on a boundary.
+[[maybe_unused]] size_t rewind_to_boundary(const byte *s, size_t pos)
+{
+  for (size_t k = 1; k <= 3 && k <= pos; ++k) {
+    const byte c = s[pos - k];
+    if (c >= 0xC0)
+      return pos - k;
+    if (c < 0x80)
+      break;
+  }
+  return pos;
+}
+
+#if defined(USTRING_SSSE3)
+
+// Lookup tables of the Keiser-Lemire validator ("Validating UTF-8 In Less Than One Instruction
+// Per Byte"). Each input byte is classified by the high and low nibble of its predecessor and
+// its own high nibble; the AND of the three lookups is non-zero exactly for illegal pairs.
+constexpr byte TOO_SHORT = 1 << 0;
+constexpr byte TOO_LONG = 1 << 1;
+constexpr byte OVERLONG_3 = 1 << 2;
+constexpr byte TOO_LARGE = 1 << 3;
+constexpr byte SURROGATE = 1 << 4;
+constexpr byte OVERLONG_2 = 1 << 5;
+constexpr byte TOO_LARGE_1000 = 1 << 6;
+constexpr byte OVERLONG_4 = 1 << 6;
+constexpr byte TWO_CONTS = 1 << 7;
+constexpr byte CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+FORCEINLINE __m128i byte_1_high_table()
+{
+  return _mm_setr_epi8(TOO_LONG,
+                       TOO_LONG,
+                       TOO_LONG,
+                       TOO_LONG,
+                       TOO_LONG,
+                       TOO_LONG,
+                       TOO_LONG,
+                       TOO_LONG,
+                       static_cast<char>(TWO_CONTS),
+                       static_cast<char>(TWO_CONTS),
+                       static_cast<char>(TWO_CONTS),
+                       static_cast<char>(TWO_CONTS),
+                       TOO_SHORT | OVERLONG_2,
+                       TOO_SHORT,
+                       TOO_SHORT | OVERLONG_3 | SURROGATE,
+                       TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+}
+
+FORCEINLINE __m128i byte_1_low_table()
+{
+  return _mm_setr_epi8(static_cast<char>(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+                       static_cast<char>(CARRY | OVERLONG_2),
+                       static_cast<char>(CARRY),
+                       static_cast<char>(CARRY),
+                       static_cast<char>(CARRY | TOO_LARGE),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000),
+                       static_cast<char>(CARRY | TOO_LARGE | TOO_LARGE_1000));
+}
+
+FORCEINLINE __m128i byte_2_high_table()
+{
+  return _mm_setr_epi8(
+      TOO_SHORT,
+      TOO_SHORT,
+      TOO_SHORT,
+      TOO_SHORT,
+      TOO_SHORT,
+      TOO_SHORT,
+      TOO_SHORT,
+      TOO_SHORT,
+      static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+                        OVERLONG_4),
+      static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+      static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+      static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+      TOO_SHORT,
+      TOO_SHORT,
+      TOO_SHORT,
+      TOO_SHORT);
+}
+
+// Subtracting this from the last block flags lead bytes whose sequence runs past its end.
+FORCEINLINE __m128i incomplete_table()
+{
+  return _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                       static_cast<char>(0xF0 - 1),
+                       static_cast<char>(0xE0 - 1),
+                       static_cast<char>(0xC0 - 1));
+}
+
+#endif  // USTRING_SSSE3
+
+#if defined(USTRING_AVX2)
+
+FORCEINLINE __m256i utf8_block_errors(__m256i input, __m256i prev_input)
+{
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  const __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+  const __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+  const __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+  const __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+  const __m256i byte_1_high = _mm256_shuffle_epi8(
+      _mm256_broadcastsi128_si256(byte_1_high_table()),
+      _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+  const __m256i byte_1_low = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(byte_1_low_table()),
+                                                 _mm256_and_si256(prev1, nibble));
+  const __m256i byte_2_high = _mm256_shuffle_epi8(
+      _mm256_broadcastsi128_si256(byte_2_high_table()),
+      _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+  const __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+  // third and fourth bytes of 3/4-byte sequences must be continuations
+  const __m256i is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80));
+  const __m256i is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xF0 - 0x80));
+  const __m256i must_be_23 = _mm256_and_si256(_mm256_or_si256(is_third, is_fourth),
+                                              _mm256_set1_epi8(static_cast<char>(0x80)));
+  return _mm256_xor_si256(must_be_23, special);
+}
+
+size_t validate_utf8_avx2(const byte *s, size_t len)
+{
+  const __m256i incomplete = _mm256_broadcastsi128_si256(incomplete_table());
+  __m256i prev_input = _mm256_setzero_si256();
+  __m256i prev_incomplete = _mm256_setzero_si256();
+
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+    // ASCII fast path: only an unfinished sequence from the previous block can fail here
+    const __m256i error = _mm256_movemask_epi8(input) == 0 ? prev_incomplete :
+                                                             utf8_block_errors(input, prev_input);
+    if (!_mm256_testz_si256(error, error)) {
+      return validate_utf8_scalar(s, rewind_to_boundary(s, i), len);
+    }
+    prev_incomplete = _mm256_subs_epu8(input, incomplete);
+    prev_input = input;
+  }
+  return validate_utf8_scalar(s, rewind_to_boundary(s, i), len);
+}
+
+#elif defined(USTRING_SSE4_2)
+
+FORCEINLINE __m128i utf8_block_errors(__m128i input, __m128i prev_input)
+{
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+  const __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+  const __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+
+  const __m128i byte_1_high = _mm_shuffle_epi8(byte_1_high_table(),
+                                               _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+  const __m128i byte_1_low = _mm_shuffle_epi8(byte_1_low_table(), _mm_and_si128(prev1, nibble));
+  const __m128i byte_2_high = _mm_shuffle_epi8(byte_2_high_table(),
+                                               _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+  const __m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+  const __m128i is_third = _mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80));
+  const __m128i is_fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80));
+  const __m128i must_be_23 = _mm_and_si128(_mm_or_si128(is_third, is_fourth),
+                                           _mm_set1_epi8(static_cast<char>(0x80)));
+  return _mm_xor_si128(must_be_23, special);
+}
+
+size_t validate_utf8_sse42(const byte *s, size_t len)
+{
+  const __m128i incomplete = incomplete_table();
+  __m128i prev_input = _mm_setzero_si128();
+  __m128i prev_incomplete = _mm_setzero_si128();
+
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+    const __m128i error = _mm_movemask_epi8(input) == 0 ? prev_incomplete :
+                                                          utf8_block_errors(input, prev_input);
+    if (!_mm_testz_si128(error, error)) {
+      return validate_utf8_scalar(s, rewind_to_boundary(s, i), len);
+    }
+    prev_incomplete = _mm_subs_epu8(input, incomplete);
+    prev_input = input;
+  }
+  return validate_utf8_scalar(s, rewind_to_boundary(s, i), len);
+}
+
+#elif defined(USTRING_SSE2)
+
+// No byte shuffles before SSSE3: skip ASCII 16 bytes at a time and check the rest per sequence.
+size_t validate_utf8_sse2(const byte *s, size_t len)
+{
+  size_t pos = 0;
+  while (pos < len) {
+    if (pos + 16 <= len &&
+        _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + pos))) == 0)
+    {
+      pos += 16;
+    }
+    else if (s[pos] < 0x80) {
+      ++pos;
+    }
+    else {
+      const size_t n = sequence_length(s, pos, len);
+      if (n == 0) {
+        return pos;
+      }
+      pos += n;
+    }
+  }
+  return len;
+}
+
+#endif
+
+FORCEINLINE size_t count_continuation_bytes_scalar(const byte *s, size_t len)
+{
+  size_t count = 0, i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, s + i, sizeof(word));
+    // high bit set and the bit below it clear
+    count += std::popcount(word & ~(word << 1) & 0x8080808080808080ull);
+  }
+  for (; i < len; ++i) {
+    count += (s[i] & 0xC0) == 0x80;
+  }
+  return count;
+}
+
+#if defined(USTRING_AVX2)
+
+size_t count_code_points_avx2(const byte *s, size_t len)
+{
+  // a signed compare against 0xBF picks out everything but continuation bytes
+  const __m256i threshold = _mm256_set1_epi8(static_cast<char>(0xBF));
+  size_t count = 0, i = 0;
+  while (i + 32 <= len) {
+    // the per-lane byte counters overflow after 255 iterations
+    const size_t end = std::min(len & ~size_t(31), i + 255 * 32);
+    __m256i counters = _mm256_setzero_si256();
+    for (; i < end; i += 32) {
+      const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+      counters = _mm256_sub_epi8(counters, _mm256_cmpgt_epi8(input, threshold));
+    }
+    const __m256i sums = _mm256_sad_epu8(counters, _mm256_setzero_si256());
+    count += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+             _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+  }
+  return count + (len - i) - count_continuation_bytes_scalar(s + i, len - i);
+}
+
+#elif defined(USTRING_SSE2)
+
+size_t count_code_points_sse2(const byte *s, size_t len)
+{
+  const __m128i threshold = _mm_set1_epi8(static_cast<char>(0xBF));
+  size_t count = 0, i = 0;
+  while (i + 16 <= len) {
+    const size_t end = std::min(len & ~size_t(15), i + 255 * 16);
+    __m128i counters = _mm_setzero_si128();
+    for (; i < end; i += 16) {
+      const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+      counters = _mm_sub_epi8(counters, _mm_cmpgt_epi8(input, threshold));
+    }
+    const __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+    count += static_cast<size_t>(_mm_cvtsi128_si32(sums)) +
+             static_cast<size_t>(_mm_extract_epi16(sums, 4));
+  }
+  return count + (len - i) - count_continuation_bytes_scalar(s + i, len - i);
+}
+
+#endif
+
+// Flips the case of every ASCII letter in [first, first + 26) from `pos` on. Bytes of multi-byte
+// UTF-8 sequences are all above 0x7F, so they are left alone. Returns `non_ascii`, or the offset
+// of the first non-ASCII byte if that is not known yet (`len`) and there is one.
+FORCEINLINE size_t map_ascii_case_scalar(byte *s, size_t pos, size_t len, byte first, size_t non_ascii)
+{
+  constexpr uint64_t ones = 0x0101010101010101ull;
+  constexpr uint64_t high = 0x8080808080808080ull;
+  for (; pos + 8 <= len; pos += 8) {
+    uint64_t word;
+    std::memcpy(&word, s + pos, sizeof(word));
+    if (non_ascii == len && (word & high)) {
+      non_ascii = pos;
+      while (s[non_ascii] < 0x80) {
+        ++non_ascii;
+      }
+    }
+    // with the high bits cleared no lane carries into the next one
+    const uint64_t low = word & ~high;
+    const uint64_t from_first = low + ones * (0x80 - first);
+    const uint64_t past_last = low + ones * (0x80 - first - 26);
+    word ^= (from_first & ~past_last & ~word & high) >> 2;
+    std::memcpy(s + pos, &word, sizeof(word));
+  }
+  for (; pos < len; ++pos) {
+    if (static_cast<byte>(s[pos] - first) < 26) {
+      s[pos] ^= 0x20;
+    }
+    else if (non_ascii == len && s[pos] >= 0x80) {
+      non_ascii = pos;
+    }
+  }
+  return non_ascii;
+}
+
+#if defined(USTRING_AVX2)
+
+size_t map_ascii_case_avx2(byte *s, size_t len, byte first)
+{
+  // signed compares, under which bytes above 0x7F are negative and never letters
+  const __m256i below = _mm256_set1_epi8(static_cast<char>(first - 1));
+  const __m256i above = _mm256_set1_epi8(static_cast<char>(first + 26));
+  const __m256i case_bit = _mm256_set1_epi8(0x20);
+  size_t i = 0, non_ascii = len;
+  for (; i + 32 <= len; i += 32) {
+    const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+    const uint32_t high = static_cast<uint32_t>(_mm256_movemask_epi8(input));
+    if (non_ascii == len && high != 0) {
+      non_ascii = i + std::countr_zero(high);
+    }
+    const __m256i letters =
+        _mm256_and_si256(_mm256_cmpgt_epi8(input, below), _mm256_cmpgt_epi8(above, input));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(s + i),
+                        _mm256_xor_si256(input, _mm256_and_si256(letters, case_bit)));
+  }
+  return map_ascii_case_scalar(s, i, len, first, non_ascii);
+}
+
+#elif defined(USTRING_SSE2)
+
+size_t map_ascii_case_sse2(byte *s, size_t len, byte first)
+{
+  const __m128i below = _mm_set1_epi8(static_cast<char>(first - 1));
+  const __m128i above = _mm_set1_epi8(static_cast<char>(first + 26));
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  size_t i = 0, non_ascii = len;
+  for (; i + 16 <= len; i += 16) {
+    const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+    const uint32_t high = static_cast<uint32_t>(_mm_movemask_epi8(input));
+    if (non_ascii == len && high != 0) {
+      non_ascii = i + std::countr_zero(high);
+    }
+    const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(input, below), _mm_cmplt_epi8(input, above));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(s + i),
+                     _mm_xor_si128(input, _mm_and_si128(letters, case_bit)));
+  }
+  return map_ascii_case_scalar(s, i, len, first, non_ascii);
+}
+
+#endif
+
+#if defined(USTRING_AVX2)
+
+size_t ascii_prefix_avx2(const byte *s, size_t len)
+{
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    const uint32_t high = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i))));
+    if (high != 0) {
+      return i + std::countr_zero(high);
+    }
+  }
+  return i;
+}
+
+#elif defined(USTRING_SSE2)
+
+size_t ascii_prefix_sse2(const byte *s, size_t len)
+{
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    const uint32_t high = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i))));
+    if (high != 0) {
+      return i + std::countr_zero(high);
+    }
+  }
+  return i;
+}
+
+#endif
+
+FORCEINLINE size_t map_ascii_case(char8_t *data, size_t len, byte first)
+{
+  byte *s = reinterpret_cast<byte *>(data);
+#if defined(USTRING_AVX2)
+  return map_ascii_case_avx2(s, len, first);
+#elif defined(USTRING_SSE2)
+  return map_ascii_case_sse2(s, len, first);
+#else
+  return map_ascii_case_scalar(s, 0, len, first, len);
+#endif
+}
+
+// Decodes a sequence already checked by sequence_length().
+FORCEINLINE char32_t decode_sequence(const byte *s, size_t n)
+{
+  switch (n) {
+    case 2:
+      return (char32_t(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+    case 3:
+      return (char32_t(s[0] & 0x0F) << 12) | (char32_t(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+    default:
+      return (char32_t(s[0] & 0x07) << 18) | (char32_t(s[1] & 0x3F) << 12) |
+             (char32_t(s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+  }
+}
+
+FORCEINLINE size_t encode_sequence(char32_t cp, byte *d)
+{
+  if (cp < 0x800) {
+    d[0] = static_cast<byte>(0xC0 | (cp >> 6));
+    d[1] = static_cast<byte>(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    d[0] = static_cast<byte>(0xE0 | (cp >> 12));
+    d[1] = static_cast<byte>(0x80 | ((cp >> 6) & 0x3F));
+    d[2] = static_cast<byte>(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  d[0] = static_cast<byte>(0xF0 | (cp >> 18));
+  d[1] = static_cast<byte>(0x80 | ((cp >> 12) & 0x3F));
+  d[2] = static_cast<byte>(0x80 | ((cp >> 6) & 0x3F));
+  d[3] = static_cast<byte>(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+// Widens the leading ASCII run of `s` into `d` and returns its length.
+template<typename Out> size_t widen_ascii_prefix(const byte *s, size_t len, Out *d)
+{
+  size_t i = 0;
+#if defined(USTRING_AVX2)
+  for (; i + 32 <= len; i += 32) {
+    const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+    if (_mm256_movemask_epi8(input) != 0) {
+      break;
+    }
+    if constexpr (sizeof(Out) == 2) {
+      __m256i *out = reinterpret_cast<__m256i *>(d + i);
+      _mm256_storeu_si256(out, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(input)));
+      _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(input, 1)));
+    }
+    else {
+      for (size_t k = 0; k < 32; k += 8) {
+        const __m128i part = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + i + k));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + i + k), _mm256_cvtepu8_epi32(part));
+      }
+    }
+  }
+#elif defined(USTRING_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= len; i += 16) {
+    const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+    if (_mm_movemask_epi8(input) != 0) {
+      break;
+    }
+    __m128i *out = reinterpret_cast<__m128i *>(d + i);
+    const __m128i lo = _mm_unpacklo_epi8(input, zero);
+    const __m128i hi = _mm_unpackhi_epi8(input, zero);
+    if constexpr (sizeof(Out) == 2) {
+      _mm_storeu_si128(out, lo);
+      _mm_storeu_si128(out + 1, hi);
+    }
+    else {
+      _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+    }
+  }
+#endif
+  for (; i < len && s[i] < 0x80; ++i) {
+    d[i] = s[i];
+  }
+  return i;
+}
+
+// Narrows the leading run of code units below 0x80 into `d` and returns its length.
+template<typename In> size_t narrow_ascii_prefix(const In *s, size_t len, byte *d)
+{
+  size_t i = 0;
+#if defined(USTRING_AVX2)
+  if constexpr (sizeof(In) == 2) {
+    const __m256i non_ascii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    for (; i + 32 <= len; i += 32) {
+      const __m256i *in = reinterpret_cast<const __m256i *>(s + i);
+      const __m256i a = _mm256_loadu_si256(in);
+      const __m256i b = _mm256_loadu_si256(in + 1);
+      if (!_mm256_testz_si256(_mm256_or_si256(a, b), non_ascii)) {
+        break;
+      }
+      // packus works per 128-bit lane, restore the order afterwards
+      const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + i), packed);
+    }
+  }
+  else {
+    const __m256i non_ascii = _mm256_set1_epi32(static_cast<int>(0xFFFFFF80));
+    for (; i + 32 <= len; i += 32) {
+      const __m256i *in = reinterpret_cast<const __m256i *>(s + i);
+      const __m256i a = _mm256_loadu_si256(in);
+      const __m256i b = _mm256_loadu_si256(in + 1);
+      const __m256i c = _mm256_loadu_si256(in + 2);
+      const __m256i e = _mm256_loadu_si256(in + 3);
+      const __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, e));
+      if (!_mm256_testz_si256(any, non_ascii)) {
+        break;
+      }
+      const __m256i ab = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+      const __m256i ce = _mm256_permute4x64_epi64(_mm256_packus_epi32(c, e), 0xD8);
+      const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(ab, ce), 0xD8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + i), packed);
+    }
+  }
+#elif defined(USTRING_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i non_ascii = sizeof(In) == 2 ? _mm_set1_epi16(static_cast<short>(0xFF80)) :
+                                              _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+  for (; i + 16 <= len; i += 16) {
+    const __m128i *in = reinterpret_cast<const __m128i *>(s + i);
+    __m128i packed;
+    __m128i any;
+    if constexpr (sizeof(In) == 2) {
+      const __m128i a = _mm_loadu_si128(in);
+      const __m128i b = _mm_loadu_si128(in + 1);
+      any = _mm_or_si128(a, b);
+      packed = _mm_packus_epi16(a, b);
+    }
+    else {
+      const __m128i a = _mm_loadu_si128(in);
+      const __m128i b = _mm_loadu_si128(in + 1);
+      const __m128i c = _mm_loadu_si128(in + 2);
+      const __m128i e = _mm_loadu_si128(in + 3);
+      any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, e));
+      packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(any, non_ascii), zero)) != 0xFFFF) {
+      break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + i), packed);
+  }
+#endif
+  for (; i < len && s[i] < 0x80; ++i) {
+    d[i] = static_cast<byte>(s[i]);
+  }
+  return i;
+}
+
+template<typename Out> size_t utf8_to_wide(const byte *s, size_t len, Out *d)
+{
+  size_t i = 0, o = 0;
+  while (i < len) {
+    if (s[i] < 0x80) {
+      // only runs long enough to pay for a vector load go through the wide path
+      if (i + 8 <= len && is_ascii_word(s + i)) {
+        const size_t n = widen_ascii_prefix(s + i, len - i, d + o);
+        i += n;
+        o += n;
+      }
+      else {
+        d[o++] = s[i++];
+      }
+      continue;
+    }
+    // three byte sequences dominate CJK text, check them without the generic path
+    if ((s[i] & 0xF0) == 0xE0 && i + 2 < len) {
+      const char32_t cp = (char32_t(s[i] & 0x0F) << 12) | (char32_t(s[i + 1] & 0x3F) << 6) |
+                          (s[i + 2] & 0x3F);
+      if ((s[i + 1] & 0xC0) == 0x80 && (s[i + 2] & 0xC0) == 0x80 && cp >= 0x800 &&
+          (cp < 0xD800 || cp > 0xDFFF))
+      {
+        d[o++] = static_cast<Out>(cp);
+        i += 3;
+        continue;
+      }
+    }
+    const size_t n = sequence_length(s, i, len);
+    if (n == 0) {
+      return ustring_simd::transcode_error;
+    }
+    const char32_t cp = decode_sequence(s + i, n);
+    if (sizeof(Out) == 4 || cp < 0x10000) {
+      d[o++] = static_cast<Out>(cp);
+    }
+    else {
+      d[o++] = static_cast<Out>(0xD7C0 + (cp >> 10));
+      d[o++] = static_cast<Out>(0xDC00 | (cp & 0x3FF));
+    }
+    i += n;
+  }
+  return o;
+}
+
+// Needles up to this length are found with a vector filter on their first and last byte,
+// longer ones with Two-Way, which stays linear for any input.
+constexpr size_t short_needle_max = 32;
+
+// Reads a buffer front to back, or back to front so that a reverse search can reuse the
+// forward algorithm.
+template<bool Reverse> struct byte_reader {
+  const byte *data;
+  ptrdiff_t size;
+
+  FORCEINLINE byte operator[](ptrdiff_t i) const
+  {
+    return Reverse ? data[size - 1 - i] : data[i];
+  }
+};
+
+using ustring_simd::two_way_plan;
+
+template<bool Reverse>
+ptrdiff_t maximal_suffix(byte_reader<Reverse> x, bool inverted, ptrdiff_t &period)
+{
+  ptrdiff_t ms = -1, j = 0, k = 1;
+  period = 1;
+  while (j + k < x.size) {
+    const byte a = x[j + k], b = x[ms + k];
+    if (inverted ? a > b : a < b) {
+      j += k;
+      k = 1;
+      period = j - ms;
+    }
+    else if (a == b) {
+      if (k != period) {
+        ++k;
+      }
+      else {
+        j += period;
+        k = 1;
+      }
+    }
+    else {
+      ms = j++;
+      k = period = 1;
+    }
+  }
+  return ms;
+}
+
+template<bool Reverse> two_way_plan make_two_way_plan(byte_reader<Reverse> x)
+{
+  ptrdiff_t p, q;
+  const ptrdiff_t i = maximal_suffix(x, false, p);
+  const ptrdiff_t j = maximal_suffix(x, true, q);
+  two_way_plan plan{i > j ? i : j, i > j ? p : q, true};
+  for (ptrdiff_t k = 0; k <= plan.split; ++k) {
+    if (k + plan.period >= x.size || x[k] != x[k + plan.period]) {
+      plan.periodic = false;
+      plan.period = std::max(plan.split + 1, x.size - plan.split - 1) + 1;
+      break;
+    }
+  }
+  return plan;
+}
+
+// Offset of the first occurrence of `x` in `y`, or -1.
+template<bool Reverse>
+ptrdiff_t two_way_find(byte_reader<Reverse> y, byte_reader<Reverse> x, const two_way_plan &plan)
+{
+  const ptrdiff_t m = x.size, ell = plan.split;
+  ptrdiff_t memory = -1;
+  for (ptrdiff_t j = 0; j <= y.size - m;) {
+    ptrdiff_t i = std::max(ell, memory) + 1;
+    while (i < m && x[i] == y[i + j]) {
+      ++i;
+    }
+    if (i < m) {
+      j += i - ell;
+      memory = -1;
+      continue;
+    }
+    i = ell;
+    while (i > memory && x[i] == y[i + j]) {
+      --i;
+    }
+    if (i <= memory) {
+      return j;
+    }
+    j += plan.period;
+    // in a periodic needle the prefix that was just matched is known to match again
+    memory = plan.periodic ? m - plan.period - 1 : -1;
+  }
+  return -1;
+}
+
+FORCEINLINE bool tail_matches(const byte *candidate, const byte *needle, size_t m)
+{
+  // first and last byte are already known to match
+  return m <= 2 || std::memcmp(candidate + 1, needle + 1, m - 2) == 0;
+}
+
+size_t find_short(const byte *h, size_t len, const byte *n, size_t m)
+{
+  size_t i = 0;
+#if defined(USTRING_AVX2)
+  const __m256i first = _mm256_set1_epi8(static_cast<char>(n[0]));
+  const __m256i last = _mm256_set1_epi8(static_cast<char>(n[m - 1]));
+  for (; i + m - 1 + 32 <= len; i += 32) {
+    const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(h + i));
+    const __m256i block_last = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(h + i + m - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+    for (; mask != 0; mask &= mask - 1) {
+      const size_t candidate = i + std::countr_zero(mask);
+      if (tail_matches(h + candidate, n, m)) {
+        return candidate;
+      }
+    }
+  }
+#elif defined(USTRING_SSE2)
+  const __m128i first = _mm_set1_epi8(static_cast<char>(n[0]));
+  const __m128i last = _mm_set1_epi8(static_cast<char>(n[m - 1]));
+  for (; i + m - 1 + 16 <= len; i += 16) {
+    const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i));
+    const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i + m - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+    for (; mask != 0; mask &= mask - 1) {
+      const size_t candidate = i + std::countr_zero(mask);
+      if (tail_matches(h + candidate, n, m)) {
+        return candidate;
+      }
+    }
+  }
+#endif
+  while (i + m <= len) {
+    const void *p = std::memchr(h + i, n[0], len - m + 1 - i);
+    if (!p) {
+      break;
+    }
+    i = static_cast<const byte *>(p) - h;
+    if (h[i + m - 1] == n[m - 1] && tail_matches(h + i, n, m)) {
+      return i;
+    }
+    ++i;
+  }
+  return ustring_simd::not_found;
+}
+
+size_t rfind_short(const byte *h, size_t len, const byte *n, size_t m)
+{
+  // candidates are the start offsets below `end`
+  size_t end = len - m + 1;
+#if defined(USTRING_AVX2)
+  const __m256i first = _mm256_set1_epi8(static_cast<char>(n[0]));
+  const __m256i last = _mm256_set1_epi8(static_cast<char>(n[m - 1]));
+  for (; end >= 32; end -= 32) {
+    const byte *block = h + end - 32;
+    const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+    const __m256i block_last = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(block + m - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+    while (mask != 0) {
+      const int bit = 31 - std::countl_zero(mask);
+      if (tail_matches(block + bit, n, m)) {
+        return end - 32 + bit;
+      }
+      mask &= ~(1u << bit);
+    }
+  }
+#elif defined(USTRING_SSE2)
+  const __m128i first = _mm_set1_epi8(static_cast<char>(n[0]));
+  const __m128i last = _mm_set1_epi8(static_cast<char>(n[m - 1]));
+  for (; end >= 16; end -= 16) {
+    const byte *block = h + end - 16;
+    const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+    const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + m - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+    while (mask != 0) {
+      const int bit = 31 - std::countl_zero(mask);
+      if (tail_matches(block + bit, n, m)) {
+        return end - 16 + bit;
+      }
+      mask &= ~(1u << bit);
+    }
+  }
+#endif
+  while (end-- > 0) {
+    if (h[end] == n[0] && h[end + m - 1] == n[m - 1] && tail_matches(h + end, n, m)) {
+      return end;
+    }
+  }
+  return ustring_simd::not_found;
+}
+
+#if defined(USTRING_AVX2)
+// 0xFF in every byte of the block that is not in the ASCII-only set described by `rows`.
+FORCEINLINE __m256i set_misses_avx2(__m256i block, __m256i rows)
+{
+  const __m256i columns = _mm256_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+      1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  const __m256i low = _mm256_and_si256(block, nibble);
+  const __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+  const __m256i hits = _mm256_and_si256(_mm256_shuffle_epi8(rows, low),
+                                        _mm256_shuffle_epi8(columns, high));
+  return _mm256_cmpeq_epi8(hits, _mm256_setzero_si256());
+}
+
+// Bit i is set if byte i of the block is in the set.
+FORCEINLINE uint32_t set_members_avx2(__m256i block, __m256i rows)
+{
+  return ~static_cast<uint32_t>(_mm256_movemask_epi8(set_misses_avx2(block, rows)));
+}
+#elif defined(USTRING_SSSE3)
+FORCEINLINE __m128i set_misses_ssse3(__m128i block, __m128i rows)
+{
+  const __m128i columns = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i low = _mm_and_si128(block, nibble);
+  const __m128i high = _mm_and_si128(_mm_srli_epi16(block, 4), nibble);
+  const __m128i hits = _mm_and_si128(_mm_shuffle_epi8(rows, low), _mm_shuffle_epi8(columns, high));
+  return _mm_cmpeq_epi8(hits, _mm_setzero_si128());
+}
+
+FORCEINLINE uint32_t set_members_ssse3(__m128i block, __m128i rows)
+{
+  return ~static_cast<uint32_t>(_mm_movemask_epi8(set_misses_ssse3(block, rows))) & 0xFFFF;
+}
+#elif defined(USTRING_SSE2)
+// Without a byte shuffle, ASCII-only sets that are a few runs of consecutive bytes (digits,
+// letters, white space) are tested with one range compare per run.
+struct byte_runs {
+  __m128i first[4];
+  __m128i span[4];
+  int count = 0;
+};
+
+// False if the set is made of more runs than byte_runs holds
+FORCEINLINE bool ascii_runs(const ustring_simd::byte_set &set, byte_runs &runs)
+{
+  int last = -2;  // last member of the current run
+  for (int word = 0; word < 2; ++word) {
+    uint64_t bits = set.bits[word];
+    while (bits != 0) {
+      const int start = std::countr_zero(bits);
+      const int length = std::countr_one(bits >> start);
+      const int first = word * 64 + start;
+      if (first == last + 1) {
+        runs.span[runs.count - 1] = _mm_add_epi8(runs.span[runs.count - 1],
+                                                 _mm_set1_epi8(static_cast<char>(length)));
+      }
+      else if (runs.count == 4) {
+        return false;
+      }
+      else {
+        runs.first[runs.count] = _mm_set1_epi8(static_cast<char>(first));
+        runs.span[runs.count] = _mm_set1_epi8(static_cast<char>(length - 1));
+        ++runs.count;
+      }
+      last = first + length - 1;
+      bits = start + length == 64 ? 0 : bits & (~0ull << (start + length));
+    }
+  }
+  return true;
+}
+
+// 0xFF in every byte of the block that is in the set
+FORCEINLINE __m128i set_hits_sse2(__m128i block, const byte_runs &runs)
+{
+  __m128i hits = _mm_setzero_si128();
+  for (int r = 0; r < runs.count; ++r) {
+    // unsigned block - first <= span; bytes from 0x80 up are past every ASCII run
+    const __m128i offset = _mm_sub_epi8(block, runs.first[r]);
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(_mm_min_epu8(offset, runs.span[r]), offset));
+  }
+  return hits;
+}
+
+FORCEINLINE uint32_t set_members_sse2(__m128i block, const byte_runs &runs)
+{
+  return static_cast<uint32_t>(_mm_movemask_epi8(set_hits_sse2(block, runs)));
+}
+#endif
+
+template<bool Member> size_t find_in_set(const byte *s, size_t len, const ustring_simd::byte_set &set)
+{
+  size_t i = 0;
+  if (set.ascii) {
+#if defined(USTRING_AVX2)
+    const __m256i rows = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.low_nibble)));
+    for (; i + 32 <= len; i += 32) {
+      uint32_t mask = set_members_avx2(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i)), rows);
+      mask = Member ? mask : ~mask;
+      if (mask != 0) {
+        return i + std::countr_zero(mask);
+      }
+    }
+#elif defined(USTRING_SSSE3)
+    const __m128i rows = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.low_nibble));
+    for (; i + 16 <= len; i += 16) {
+      uint32_t mask = set_members_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i)),
+                                        rows);
+      mask = Member ? mask : ~mask & 0xFFFF;
+      if (mask != 0) {
+        return i + std::countr_zero(mask);
+      }
+    }
+#elif defined(USTRING_SSE2)
+    byte_runs runs;
+    if (len >= 16 && ascii_runs(set, runs)) {
+      for (; i + 16 <= len; i += 16) {
+        uint32_t mask = set_members_sse2(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i)), runs);
+        mask = Member ? mask : ~mask & 0xFFFF;
+        if (mask != 0) {
+          return i + std::countr_zero(mask);
+        }
+      }
+    }
+#endif
+  }
+  for (; i < len; ++i) {
+    if (set.contains(s[i]) == Member) {
+      return i;
+    }
+  }
+  return ustring_simd::not_found;
+}
+
+template<bool Member>
+size_t rfind_in_set(const byte *s, size_t len, const ustring_simd::byte_set &set)
+{
+  size_t end = len;
+  if (set.ascii) {
+#if defined(USTRING_AVX2)
+    const __m256i rows = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.low_nibble)));
+    for (; end >= 32; end -= 32) {
+      uint32_t mask = set_members_avx2(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + end - 32)), rows);
+      mask = Member ? mask : ~mask;
+      if (mask != 0) {
+        return end - 1 - std::countl_zero(mask);
+      }
+    }
+#elif defined(USTRING_SSSE3)
+    const __m128i rows = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.low_nibble));
+    for (; end >= 16; end -= 16) {
+      uint32_t mask = set_members_ssse3(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + end - 16)), rows);
+      mask = Member ? mask : ~mask & 0xFFFF;
+      if (mask != 0) {
+        return end - 16 + 31 - std::countl_zero(mask);
+      }
+    }
+#elif defined(USTRING_SSE2)
+    byte_runs runs;
+    if (len >= 16 && ascii_runs(set, runs)) {
+      for (; end >= 16; end -= 16) {
+        uint32_t mask = set_members_sse2(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + end - 16)), runs);
+        mask = Member ? mask : ~mask & 0xFFFF;
+        if (mask != 0) {
+          return end - 16 + 31 - std::countl_zero(mask);
+        }
+      }
+    }
+#endif
+  }
+  while (end-- > 0) {
+    if (set.contains(s[end]) == Member) {
+      return end;
+    }
+  }
+  return ustring_simd::not_found;
+}
+
+// Members are counted in per-lane byte counters, which overflow after 255 blocks, as in
+// count_code_points
+size_t count_in_set(const byte *s, size_t len, const ustring_simd::byte_set &set)
+{
+  size_t i = 0, count = 0;
+  if (set.ascii) {
+#if defined(USTRING_AVX2)
+    const __m256i rows = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.low_nibble)));
+    while (i + 32 <= len) {
+      const size_t start = i, end = std::min(len & ~size_t(31), i + 255 * 32);
+      __m256i misses = _mm256_setzero_si256();
+      for (; i < end; i += 32) {
+        misses = _mm256_sub_epi8(
+            misses,
+            set_misses_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i)), rows));
+      }
+      const __m256i sums = _mm256_sad_epu8(misses, _mm256_setzero_si256());
+      count += (end - start) - (_mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+                                _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3));
+    }
+#elif defined(USTRING_SSSE3)
+    const __m128i rows = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.low_nibble));
+    while (i + 16 <= len) {
+      const size_t start = i, end = std::min(len & ~size_t(15), i + 255 * 16);
+      __m128i misses = _mm_setzero_si128();
+      for (; i < end; i += 16) {
+        misses = _mm_sub_epi8(
+            misses,
+            set_misses_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i)), rows));
+      }
+      const __m128i sums = _mm_sad_epu8(misses, _mm_setzero_si128());
+      count += (end - start) - (static_cast<size_t>(_mm_cvtsi128_si32(sums)) +
+                                static_cast<size_t>(_mm_extract_epi16(sums, 4)));
+    }
+#elif defined(USTRING_SSE2)
+    byte_runs runs;
+    if (len >= 16 && ascii_runs(set, runs)) {
+      while (i + 16 <= len) {
+        const size_t end = std::min(len & ~size_t(15), i + 255 * 16);
+        __m128i hits = _mm_setzero_si128();
+        for (; i < end; i += 16) {
+          hits = _mm_sub_epi8(
+              hits,
+              set_hits_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i)), runs));
+        }
+        const __m128i sums = _mm_sad_epu8(hits, _mm_setzero_si128());
+        count += static_cast<size_t>(_mm_cvtsi128_si32(sums)) +
+                 static_cast<size_t>(_mm_extract_epi16(sums, 4));
+      }
+    }
+#endif
+  }
+  for (; i < len; ++i) {
+    count += set.contains(s[i]);
+  }
+  return count;
+}
+
+// Hash primitives, after wyhash (final version 4, public domain)
+constexpr uint64_t hash_secret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+FORCEINLINE void multiply_128(uint64_t &a, uint64_t &b)
+{
+#if defined(__SIZEOF_INT128__)
+  const __uint128_t r = static_cast<__uint128_t>(a) * b;
+  a = static_cast<uint64_t>(r);
+  b = static_cast<uint64_t>(r >> 64);
+#elif defined(USTRING_MSVC) && defined(USTRING_X64)
+  a = _umul128(a, b, &b);
+#else
+  const uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a),
+                 lb = static_cast<uint32_t>(b);
+  const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  const uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  const uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  a = lo;
+  b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+FORCEINLINE uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+  multiply_128(a, b);
+  return a ^ b;
+}
+
+FORCEINLINE uint64_t read64(const byte *p)
+{
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+FORCEINLINE uint64_t read32(const byte *p)
+{
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+FORCEINLINE uint64_t hash_seed(uint64_t seed)
+{
+  return seed ^ hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+}
+
+// One 48 byte block, split over the three lanes
+FORCEINLINE void hash_block(const byte *p, uint64_t &seed, uint64_t &see1, uint64_t &see2)
+{
+  seed = hash_mix(read64(p) ^ hash_secret[1], read64(p + 8) ^ seed);
+  see1 = hash_mix(read64(p + 16) ^ hash_secret[2], read64(p + 24) ^ see1);
+  see2 = hash_mix(read64(p + 32) ^ hash_secret[3], read64(p + 40) ^ see2);
+}
+
+// Everything after the 48 byte blocks: `p` holds the last 1..48 bytes of an input of `total`
+// bytes (more than 16), and the 16 bytes before `p` are readable
+FORCEINLINE uint64_t hash_tail(const byte *p, size_t i, uint64_t seed, uint64_t total)
+{
+  while (i > 16) {
+    seed = hash_mix(read64(p) ^ hash_secret[1], read64(p + 8) ^ seed);
+    p += 16;
+    i -= 16;
+  }
+  uint64_t a = read64(p + i - 16) ^ hash_secret[1];
+  uint64_t b = read64(p + i - 8) ^ seed;
+  multiply_128(a, b);
+  return hash_mix(a ^ hash_secret[0] ^ total, b ^ hash_secret[1]);
+}
+
+// Inputs of at most 16 bytes
+FORCEINLINE uint64_t hash_short(const byte *p, size_t len, uint64_t seed)
+{
+  uint64_t a = 0, b = 0;
+  if (len >= 4) {
+    const size_t shift = (len >> 3) << 2;
+    a = read32(p) << 32 | read32(p + shift);
+    b = read32(p + len - 4) << 32 | read32(p + len - 4 - shift);
+  }
+  else if (len > 0) {
+    a = uint64_t{p[0]} << 16 | uint64_t{p[len >> 1]} << 8 | p[len - 1];
+  }
+  a ^= hash_secret[1];
+  b ^= seed;
+  multiply_128(a, b);
+  return hash_mix(a ^ hash_secret[0] ^ len, b ^ hash_secret[1]);
+}
+
+}  // namespace
+
+namespace ustring_simd {
+
+  size_t validate_utf8(const char8_t *data, size_t len) noexcept
+  {
+    const byte *s = reinterpret_cast<const byte *>(data);
+#if defined(USTRING_AVX2)
+    return validate_utf8_avx2(s, len);
+#elif defined(USTRING_SSE4_2)
+    return validate_utf8_sse42(s, len);
+#elif defined(USTRING_SSE2)
+    return validate_utf8_sse2(s, len);
+#else
+    return validate_utf8_scalar(s, 0, len);
+#endif
+  }
+
+  size_t count_code_points(const char8_t *data, size_t len) noexcept
+  {
+    const byte *s = reinterpret_cast<const byte *>(data);
+#if defined(USTRING_AVX2)
+    return count_code_points_avx2(s, len);
+#elif defined(USTRING_SSE2)
+    return count_code_points_sse2(s, len);
+#else
+    return len - count_continuation_bytes_scalar(s, len);
+#endif
+  }
+
+  size_t ascii_prefix(const char8_t *data, size_t len) noexcept
+  {
+    const byte *s = reinterpret_cast<const byte *>(data);
+#if defined(USTRING_AVX2)
+    size_t i = ascii_prefix_avx2(s, len);
+#elif defined(USTRING_SSE2)
+    size_t i = ascii_prefix_sse2(s, len);
+#else
+    size_t i = 0;
+#endif
+    while (i + 8 <= len && is_ascii_word(s + i)) {
+      i += 8;
+    }
+    while (i < len && s[i] < 0x80) {
+      ++i;
+    }
+    return i;
+  }
+
+  size_t ascii_to_lower(char8_t *data, size_t len) noexcept
+  {
+    return map_ascii_case(data, len, 'A');
+  }
+
+  size_t ascii_to_upper(char8_t *data, size_t len) noexcept
+  {
+    return map_ascii_case(data, len, 'a');
+  }
+
+  size_t utf8_to_utf16(const char8_t *src, size_t len, char16_t *dst) noexcept
+  {
+    return utf8_to_wide(reinterpret_cast<const byte *>(src), len, dst);
+  }
+
+  size_t utf8_to_utf32(const char8_t *src, size_t len, char32_t *dst) noexcept
+  {
+    return utf8_to_wide(reinterpret_cast<const byte *>(src), len, dst);
+  }
+
+  size_t utf16_to_utf8(const char16_t *src, size_t len, char8_t *dst) noexcept
+  {
+    byte *d = reinterpret_cast<byte *>(dst);
+    size_t i = 0, o = 0;
+    while (i < len) {
+      const char32_t c = src[i];
+      if (c < 0x80) {
+        const size_t n = narrow_ascii_prefix(src + i, len - i, d + o);
+        i += n;
+        o += n;
+        continue;
+      }
+      if (c < 0xD800 || c > 0xDFFF) {
+        o += encode_sequence(c, d + o);
+        ++i;
+        continue;
+      }
+      // a high surrogate followed by a low one
+      if (c > 0xDBFF || i + 1 == len || src[i + 1] < 0xDC00 || src[i + 1] > 0xDFFF) {
+        return transcode_error;
+      }
+      o += encode_sequence(0x10000 + ((c - 0xD800) << 10) + (src[i + 1] - 0xDC00), d + o);
+      i += 2;
+    }
+    return o;
+  }
+
+  size_t utf32_to_utf8(const char32_t *src, size_t len, char8_t *dst) noexcept
+  {
+    byte *d = reinterpret_cast<byte *>(dst);
+    size_t i = 0, o = 0;
+    while (i < len) {
+      char32_t c = src[i];
+      if (c < 0x80) {
+        const size_t n = narrow_ascii_prefix(src + i, len - i, d + o);
+        i += n;
+        o += n;
+        continue;
+      }
+      if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+        c = 0xFFFD;
+      }
+      o += encode_sequence(c, d + o);
+      ++i;
+    }
+    return o;
+  }
+
+  needle_plan make_needle_plan(const char8_t *needle, size_t len) noexcept
+  {
+    const byte *n = reinterpret_cast<const byte *>(needle);
+    if (len <= short_needle_max) {
+      return {};
+    }
+    return {make_two_way_plan(byte_reader<false>{n, static_cast<ptrdiff_t>(len)}),
+            make_two_way_plan(byte_reader<true>{n, static_cast<ptrdiff_t>(len)})};
+  }
+
+  size_t find(const char8_t *haystack, size_t len, const char8_t *needle, size_t needle_len) noexcept
+  {
+    if (needle_len <= short_needle_max) {
+      return find(haystack, len, needle, needle_len, needle_plan{});
+    }
+    needle_plan plan;
+    plan.forward = make_two_way_plan(
+        byte_reader<false>{reinterpret_cast<const byte *>(needle), static_cast<ptrdiff_t>(needle_len)});
+    return find(haystack, len, needle, needle_len, plan);
+  }
+
+  size_t find(const char8_t *haystack,
+              size_t len,
+              const char8_t *needle,
+              size_t needle_len,
+              const needle_plan &plan) noexcept
+  {
+    const byte *h = reinterpret_cast<const byte *>(haystack);
+    const byte *n = reinterpret_cast<const byte *>(needle);
+    if (needle_len == 0) {
+      return 0;
+    }
+    if (needle_len > len) {
+      return not_found;
+    }
+    if (needle_len == 1) {
+      const void *p = std::memchr(h, n[0], len);
+      return p ? static_cast<const byte *>(p) - h : not_found;
+    }
+    if (needle_len <= short_needle_max) {
+      return find_short(h, len, n, needle_len);
+    }
+    const ptrdiff_t offset = two_way_find(byte_reader<false>{h, static_cast<ptrdiff_t>(len)},
+                                          byte_reader<false>{n, static_cast<ptrdiff_t>(needle_len)},
+                                          plan.forward);
+    return offset < 0 ? not_found : static_cast<size_t>(offset);
+  }
+
+  size_t rfind(const char8_t *haystack, size_t len, const char8_t *needle, size_t needle_len) noexcept
+  {
+    if (needle_len <= short_needle_max) {
+      return rfind(haystack, len, needle, needle_len, needle_plan{});
+    }
+    needle_plan plan;
+    plan.backward = make_two_way_plan(
+        byte_reader<true>{reinterpret_cast<const byte *>(needle), static_cast<ptrdiff_t>(needle_len)});
+    return rfind(haystack, len, needle, needle_len, plan);
+  }
+
+  size_t rfind(const char8_t *haystack,
+               size_t len,
+               const char8_t *needle,
+               size_t needle_len,
+               const needle_plan &plan) noexcept
+  {
+    const byte *h = reinterpret_cast<const byte *>(haystack);
+    const byte *n = reinterpret_cast<const byte *>(needle);
+    if (needle_len == 0) {
+      return len;
+    }
+    if (needle_len > len) {
+      return not_found;
+    }
+    if (needle_len <= short_needle_max) {
+      return rfind_short(h, len, n, needle_len);
+    }
+    // the first match of the reversed needle in the reversed haystack
+    const ptrdiff_t offset = two_way_find(byte_reader<true>{h, static_cast<ptrdiff_t>(len)},
+                                          byte_reader<true>{n, static_cast<ptrdiff_t>(needle_len)},
+                                          plan.backward);
+    return offset < 0 ? not_found : len - needle_len - static_cast<size_t>(offset);
+  }
+
+  size_t find_first_of(const char8_t *data, size_t len, const byte_set &set) noexcept
+  {
+    return find_in_set<true>(reinterpret_cast<const byte *>(data), len, set);
+  }
+
+  size_t find_first_not_of(const char8_t *data, size_t len, const byte_set &set) noexcept
+  {
+    return find_in_set<false>(reinterpret_cast<const byte *>(data), len, set);
+  }
+
+  size_t find_last_of(const char8_t *data, size_t len, const byte_set &set) noexcept
+  {
+    return rfind_in_set<true>(reinterpret_cast<const byte *>(data), len, set);
+  }
+
+  size_t find_last_not_of(const char8_t *data, size_t len, const byte_set &set) noexcept
+  {
+    return rfind_in_set<false>(reinterpret_cast<const byte *>(data), len, set);
+  }
+
+  size_t count_of(const char8_t *data, size_t len, const byte_set &set) noexcept
+  {
+    return count_in_set(reinterpret_cast<const byte *>(data), len, set);
+  }
+
+  uint64_t hash(const char8_t *data, size_t len, uint64_t seed) noexcept
+  {
+    const byte *p = reinterpret_cast<const byte *>(data);
+    seed = hash_seed(seed);
+    if (len <= 16) {
+      return hash_short(p, len, seed);
+    }
+
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        hash_block(p, seed, see1, see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    return hash_tail(p, i, seed, len);
+  }
+
+  void hash_init(hash_state &state, uint64_t seed) noexcept
+  {
+    state = {};
+    state.seed = state.see1 = state.see2 = hash_seed(seed);
+  }
+
+  void hash_update(hash_state &state, const char8_t *data, size_t len) noexcept
+  {
+    const byte *p = reinterpret_cast<const byte *>(data);
+    byte *buffer = reinterpret_cast<byte *>(state.buffer);
+    state.total += len;
+
+    // A block is only consumed once more input follows it, so the tail always keeps 1..48 bytes
+    if (state.pending + len <= 48) {
+      std::memcpy(buffer + 16 + state.pending, p, len);
+      state.pending += static_cast<uint32_t>(len);
+      return;
+    }
+    if (state.pending > 0) {
+      const size_t fill = 48 - state.pending;
+      std::memcpy(buffer + 16 + state.pending, p, fill);
+      p += fill;
+      len -= fill;
+      hash_block(buffer + 16, state.seed, state.see1, state.see2);
+      std::memcpy(buffer, buffer + 48, 16);
+      state.pending = 0;
+    }
+    while (len > 48) {
+      hash_block(p, state.seed, state.see1, state.see2);
+      std::memcpy(buffer, p + 32, 16);
+      p += 48;
+      len -= 48;
+    }
+    std::memcpy(buffer + 16, p, len);
+    state.pending = static_cast<uint32_t>(len);
+  }
+
+  uint64_t hash_digest(const hash_state &state) noexcept
+  {
+    const byte *pending = reinterpret_cast<const byte *>(state.buffer) + 16;
+    if (state.total <= 16) {
+      return hash_short(pending, state.total, state.seed);
+    }
+    // Only inputs longer than 48 bytes consumed blocks, and only they fold in the other lanes
+    const uint64_t seed = state.total > 48 ? state.seed ^ state.see1 ^ state.see2 : state.seed;
+    return hash_tail(pending, state.pending, seed, state.total);
+  }
+
+}  // namespace ustring_simd
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ustring_simd_types.h"
+
+// Byte-level kernels behind ustring. Every entry point picks the widest implementation enabled
+// in simd_traits.h at compile time and falls back to portable scalar code.
+namespace ustring_simd {
+
+  // Offset of the first byte that does not start a well-formed UTF-8 sequence, or `len` if the
+  // whole buffer is valid.
+  size_t validate_utf8(const char8_t *data, size_t len) noexcept;
+
+  // Number of bytes that are not UTF-8 continuation bytes (10xxxxxx), which is the code point
+  // count of well-formed input.
+  size_t count_code_points(const char8_t *data, size_t len) noexcept;
+
+  // Length of the leading run of ASCII bytes.
+  size_t ascii_prefix(const char8_t *data, size_t len) noexcept;
+
+  // Lower- or upper-case every ASCII letter of `data` in place. No byte of a multi-byte UTF-8
+  // sequence is an ASCII letter, so this is safe on any UTF-8. Return the offset of the first
+  // non-ASCII byte, or `len` if the whole buffer was ASCII.
+  size_t ascii_to_lower(char8_t *data, size_t len) noexcept;
+  size_t ascii_to_upper(char8_t *data, size_t len) noexcept;
+
+  // Transcoders return the number of code units written, or transcode_error on ill-formed
+  // input. Each takes an output buffer sized for the worst case: `len` units when decoding
+  // UTF-8, 3 bytes per UTF-16 unit and 4 bytes per UTF-32 unit when encoding it.
+  inline constexpr size_t transcode_error = static_cast<size_t>(-1);
+
+  size_t utf8_to_utf16(const char8_t *src, size_t len, char16_t *dst) noexcept;
+  size_t utf8_to_utf32(const char8_t *src, size_t len, char32_t *dst) noexcept;
+  size_t utf16_to_utf8(const char16_t *src, size_t len, char8_t *dst) noexcept;
+  // Surrogates and values above U+10FFFF are replaced with U+FFFD.
+  size_t utf32_to_utf8(const char32_t *src, size_t len, char8_t *dst) noexcept;
+
+  inline constexpr size_t not_found = static_cast<size_t>(-1);
+
+  // Offset of the first (find) or last (rfind) occurrence of `needle` in `haystack`, or
+  // not_found. An empty needle matches at 0 and at `len` respectively. Single bytes go through
+  // memchr, short needles through a vector filter on their first and last byte and long ones
+  // through Two-Way, so the search time is linear in the haystack for any needle.
+  size_t find(const char8_t *haystack, size_t len, const char8_t *needle, size_t needle_len) noexcept;
+  size_t rfind(const char8_t *haystack, size_t len, const char8_t *needle, size_t needle_len) noexcept;
+
+  // The same searches with a needle_plan made once for the needle
+  needle_plan make_needle_plan(const char8_t *needle, size_t len) noexcept;
+  size_t find(const char8_t *haystack,
+              size_t len,
+              const char8_t *needle,
+              size_t needle_len,
+              const needle_plan &plan) noexcept;
+  size_t rfind(const char8_t *haystack,
+               size_t len,
+               const char8_t *needle,
+               size_t needle_len,
+               const needle_plan &plan) noexcept;
+
+  // A set of byte values. The low-nibble rows let the vector kernels test membership with two
+  // table lookups per block, which covers sets whose members are all ASCII.
+  struct byte_set {
+    uint64_t bits[4] = {};
+    uint8_t low_nibble[16] = {};  // bit h of row l is set if (h << 4 | l) is a member, h < 8
+    bool ascii = true;
+
+    byte_set() = default;
+    byte_set(const char8_t *members, size_t len) noexcept
+    {
+      for (size_t i = 0; i < len; ++i) {
+        insert(static_cast<uint8_t>(members[i]));
+      }
+    }
+
+    void insert(uint8_t b) noexcept
+    {
+      bits[b >> 6] |= 1ull << (b & 63);
+      if (b < 0x80) {
+        low_nibble[b & 0x0F] |= static_cast<uint8_t>(1u << (b >> 4));
+      }
+      else {
+        ascii = false;
+      }
+    }
+    bool contains(uint8_t b) const noexcept
+    {
+      return (bits[b >> 6] >> (b & 63)) & 1;
+    }
+  };
+
+  // Offset of the first or last byte that is, or is not, a member of `set`, or not_found.
+  size_t find_first_of(const char8_t *data, size_t len, const byte_set &set) noexcept;
+  size_t find_first_not_of(const char8_t *data, size_t len, const byte_set &set) noexcept;
+  size_t find_last_of(const char8_t *data, size_t len, const byte_set &set) noexcept;
+  size_t find_last_not_of(const char8_t *data, size_t len, const byte_set &set) noexcept;
+  // Number of bytes that are members of `set`.
+  size_t count_of(const char8_t *data, size_t len, const byte_set &set) noexcept;
+
+  // 64-bit hash of the wyhash family. Long inputs run through three independent multiply lanes
+  // of 16 bytes each, so the 64x64->128 bit multiplies of one 48 byte block overlap.
+  uint64_t hash(const char8_t *data, size_t len, uint64_t seed) noexcept;
+
+  // Incremental hash. Feeding bytes in pieces of any size gives the same value as hash() of
+  // their concatenation.
+  void hash_init(hash_state &state, uint64_t seed) noexcept;
+  void hash_update(hash_state &state, const char8_t *data, size_t len) noexcept;
+  uint64_t hash_digest(const hash_state &state) noexcept;
+
+}  // namespace ustring_simd
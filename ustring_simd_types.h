@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The parts of ustring_simd that ustring.h itself needs: the state its members hold and the
+// single code point helpers its templates inline. The kernels are declared in ustring_simd.h,
+// which stays private to the .cpp files.
+namespace ustring_simd {
+
+  // Single code points, inline so loops that call back per code point can be compiled as one.
+  // next_code_point reads the code point at `pos` and moves past it. An ill-formed sequence reads
+  // as U+FFFD and is skipped up to the first byte that cannot continue it, as ICU's U8_NEXT does.
+  inline char32_t next_code_point(const char8_t *data, size_t &pos, size_t len) noexcept
+  {
+    const uint8_t lead = data[pos++];
+    if (lead < 0x80) {
+      return lead;
+    }
+    size_t trail;
+    char32_t c;
+    uint8_t lo = 0x80, hi = 0xBF;
+    if (lead < 0xC2 || lead > 0xF4) {
+      return 0xFFFD;
+    }
+    else if (lead < 0xE0) {
+      trail = 1;
+      c = lead & 0x1F;
+    }
+    else if (lead < 0xF0) {
+      trail = 2;
+      c = lead & 0x0F;
+      lo = lead == 0xE0 ? 0xA0 : 0x80;  // overlong
+      hi = lead == 0xED ? 0x9F : 0xBF;  // surrogates
+    }
+    else {
+      trail = 3;
+      c = lead & 0x07;
+      lo = lead == 0xF0 ? 0x90 : 0x80;  // overlong
+      hi = lead == 0xF4 ? 0x8F : 0xBF;  // > U+10FFFF
+    }
+    for (; trail > 0; --trail, lo = 0x80, hi = 0xBF) {
+      if (pos == len || data[pos] < lo || data[pos] > hi) {
+        return 0xFFFD;
+      }
+      c = c << 6 | (data[pos++] & 0x3F);
+    }
+    return c;
+  }
+
+  // Bytes put_code_point() writes for `c`. Like utf32_to_utf8, both treat surrogates and values
+  // above U+10FFFF as U+FFFD.
+  constexpr size_t code_point_size(char32_t c) noexcept
+  {
+    return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : c <= 0x10FFFF ? 4 : 3;
+  }
+
+  inline size_t put_code_point(char32_t c, char8_t *dst) noexcept
+  {
+    if (c < 0x80) {
+      dst[0] = static_cast<char8_t>(c);
+      return 1;
+    }
+    if (c < 0x800) {
+      dst[0] = static_cast<char8_t>(0xC0 | (c >> 6));
+      dst[1] = static_cast<char8_t>(0x80 | (c & 0x3F));
+      return 2;
+    }
+    if ((c >= 0xD800 && c < 0xE000) || c > 0x10FFFF) {
+      c = 0xFFFD;
+    }
+    if (c < 0x10000) {
+      dst[0] = static_cast<char8_t>(0xE0 | (c >> 12));
+      dst[1] = static_cast<char8_t>(0x80 | ((c >> 6) & 0x3F));
+      dst[2] = static_cast<char8_t>(0x80 | (c & 0x3F));
+      return 3;
+    }
+    dst[0] = static_cast<char8_t>(0xF0 | (c >> 18));
+    dst[1] = static_cast<char8_t>(0x80 | ((c >> 12) & 0x3F));
+    dst[2] = static_cast<char8_t>(0x80 | ((c >> 6) & 0x3F));
+    dst[3] = static_cast<char8_t>(0x80 | (c & 0x3F));
+    return 4;
+  }
+
+  // Critical factorization of a needle for Two-Way (Crochemore & Perrin).
+  struct two_way_plan {
+    ptrdiff_t split = 0;
+    ptrdiff_t period = 1;
+    bool periodic = false;
+  };
+
+  // Everything find and rfind derive from the needle alone, for callers that search for the
+  // same needle many times. Only needles too long for the vector filter need one.
+  struct needle_plan {
+    two_way_plan forward;
+    two_way_plan backward;
+  };
+
+  // State of the incremental hash, see hash_init.
+  struct hash_state {
+    uint64_t seed = 0;
+    uint64_t see1 = 0;
+    uint64_t see2 = 0;
+    uint64_t total = 0;
+    // 16 bytes of history (the end of the last consumed block) followed by up to 48 pending
+    // bytes, which the tail of the hash may read back into
+    char8_t buffer[64] = {};
+    uint32_t pending = 0;
+  };
+
+}  // namespace ustring_simd
@@ -1,4 +1,5 @@
 #include "ustring.h"
+#include "shared_ustring.h"
 #include <benchmark/benchmark.h>
 #include <random>
 #include <thread>
@@ -292,4 +293,69 @@ BENCHMARK(BM_StressTest_MixedOperations)
     ->RangeMultiplier(4)
     ->Range(1<<8, 1<<16);
 
+// Copy Stress Tests
+// A catalog of large values copied around by value: every ustring copy is an allocation and a
+// memcpy, a shared_ustring copy is an atomic increment.
+static void BM_StressTest_CopyByValue(benchmark::State& state) {
+    const size_t size = state.range(0);
+    ustring value(test_data::generate_mixed_unicode(size).c_str());
+    std::vector<ustring> copies(64);
+
+    for (auto _ : state) {
+        for (auto& copy : copies) {
+            copy = ustring(value);
+        }
+        benchmark::DoNotOptimize(copies.data());
+    }
+    state.SetItemsProcessed(state.iterations() * copies.size());
+}
+BENCHMARK(BM_StressTest_CopyByValue)
+    ->RangeMultiplier(8)
+    ->Range(1<<6, 1<<18);
+
+static void BM_StressTest_CopyShared(benchmark::State& state) {
+    const size_t size = state.range(0);
+    const shared_ustring value = ustring(test_data::generate_mixed_unicode(size).c_str()).shared();
+    std::vector<shared_ustring> copies(64);
+
+    for (auto _ : state) {
+        for (auto& copy : copies) {
+            copy = shared_ustring(value);
+        }
+        benchmark::DoNotOptimize(copies.data());
+    }
+    state.SetItemsProcessed(state.iterations() * copies.size());
+}
+BENCHMARK(BM_StressTest_CopyShared)
+    ->RangeMultiplier(8)
+    ->Range(1<<6, 1<<18);
+
+// Threads taking and dropping copies of one shared value, the worst case for the counter
+static void BM_StressTest_CopySharedConcurrent(benchmark::State& state) {
+    const int num_threads = state.range(0);
+    const shared_ustring value = ustring(test_data::generate_mixed_unicode(4096).c_str()).shared();
+
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads);
+
+        for (int i = 0; i < num_threads; ++i) {
+            threads.emplace_back([&value]() {
+                for (int j = 0; j < 10000; ++j) {
+                    shared_ustring copy = value;
+                    benchmark::DoNotOptimize(copy.size());
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_threads * 10000);
+}
+BENCHMARK(BM_StressTest_CopySharedConcurrent)
+    ->RangeMultiplier(2)
+    ->Range(1, 8);
+
 BENCHMARK_MAIN();
@@ -2,6 +2,9 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+#include <vector>
+
 #include <unicode/brkiter.h>
 #include <unicode/localpointer.h>
 #include <unicode/locid.h>
@@ -160,6 +163,54 @@ TEST_F(UstringTransformTest, Transform)
   EXPECT_EQ(empty.transformed(double_char), u8"");
 }
 
+// The template overloads take any callable; std::function arguments still work
+TEST_F(UstringTransformTest, CallableOverloads)
+{
+  size_t calls = 0;
+  auto vowel = [&calls](char32_t c) {
+    ++calls;
+    return c == U'a' || c == U'e' || c == U'i' || c == U'o' || c == U'u';
+  };
+  EXPECT_EQ(ascii.count(vowel), 3u);
+  EXPECT_EQ(calls, static_cast<size_t>(ascii.length()));
+  EXPECT_TRUE(ascii.to_view().contains(vowel));
+  EXPECT_FALSE(chinese.contains(vowel));
+  EXPECT_EQ(chinese.count([](auto c) { return c >= 0x4E00 && c <= 0x9FFF; }), 4u);
+  const std::function<bool(char32_t)> wrapped = vowel;
+  EXPECT_EQ(ascii.count(wrapped), 3u);
+  EXPECT_TRUE(ascii.contains(wrapped));
+
+  // the index counts code points
+  EXPECT_EQ(chinese.filtered([](char32_t, ustring::size_type i) { return i % 2 == 0; }), u8"你，界");
+  EXPECT_EQ(ustring(u8"a中b").transformed([](char32_t c, ustring::size_type i) {
+    return i == 1 ? U'x' : c;
+  }),
+            u8"axb");
+
+  // results longer than their input leave the buffer
+  EXPECT_EQ(ustring(u8"abc").transformed([](char32_t c, ustring::size_type) {
+    return c == U'b' ? U'🌍' : c;
+  }),
+            u8"a🌍c");
+  ustring text(std::string(40, 'a'));
+  text.transform([](char32_t, ustring::size_type) { return U'é'; });
+  EXPECT_EQ(text.size(), 80);
+  EXPECT_EQ(text.length(), 40);
+
+  // ill-formed bytes come through as U+FFFD, and unpaired surrogates are written as it
+  EXPECT_EQ(ustring(u8"a\xFF" "b").transformed([](char32_t c, ustring::size_type) { return c; }),
+            u8"a�b");
+  EXPECT_EQ(ustring(u8"a").transformed([](char32_t, ustring::size_type) { return char32_t(0xD800); }),
+            u8"�");
+  EXPECT_EQ(ustring(u8"a\xFF" "b").filtered([](char32_t c, ustring::size_type) { return c != 0xFFFD; }),
+            u8"ab");
+
+  std::function<char32_t(char32_t, ustring::size_type)> upper = [](char32_t c, ustring::size_type) {
+    return static_cast<char32_t>(u_toupper(c));
+  };
+  EXPECT_EQ(russian.transformed(std::move(upper)), u8"ПРИВЕТ, МИР!");
+}
+
 // Test case conversion functions
 TEST_F(UstringTransformTest, CaseConversion)
 {
@@ -212,6 +263,9 @@ TEST_F(UstringTransformTest, TrimAndStrip)
   // Test strip with custom characters
   EXPECT_EQ(ascii.stripped(u8"H!"), u8"ello, World");
   EXPECT_EQ(chinese.stripped(u8"你！"), u8"好，世界");
+  EXPECT_EQ(chinese.stripped(u8"！a你世"), u8"好，世界");
+  EXPECT_EQ(ustring(u8"\t  padded \n").strip(ustring(u8" \t\n")), u8"padded");
+  EXPECT_EQ(ustring(u8"世界你好世界").strip(ustring(u8"界世")), u8"你好");
 
   // Test with empty string
   EXPECT_EQ(empty.trimmed(), u8"");
@@ -243,6 +297,36 @@ TEST_F(UstringTransformTest, Normalization)
   EXPECT_EQ(ascii.normalized({}), ascii);
 }
 
+TEST_F(UstringTransformTest, NormalizationFastPaths)
+{
+  // already normalized text is left where it is
+  ustring text(std::string(64, 'x') + "Grüße, 世界");
+  const auto *buffer = text.data();
+  EXPECT_TRUE(text.is_normalized({}));
+  text.normalize({});
+  EXPECT_EQ(text.data(), buffer);
+  EXPECT_EQ(text, ustring(std::string(64, 'x') + "Grüße, 世界"));
+
+  // the last ASCII character before the first non-ASCII one can still compose
+  ustring cafe(u8"Cafe\u0301 au lait");
+  EXPECT_FALSE(cafe.is_normalized({}));
+  EXPECT_EQ(cafe.normalized({}), u8"Café au lait");
+  EXPECT_TRUE(cafe.normalized({}).is_normalized({}));
+  EXPECT_TRUE(ustring(u8"e\u0301").is_normalized({.mode = Normalization2Mode::DECOMPOSE}));
+  EXPECT_EQ(ustring(u8"xxé").normalized({.mode = Normalization2Mode::DECOMPOSE}), u8"xxe\u0301");
+  EXPECT_EQ(ustring(u8"abﬁ").normalized({.data_file = NormalizationDataFile::NFKC}), u8"abfi");
+
+  // case folding changes ASCII, so it is never skipped
+  const NormalizationConfig casefold{.data_file = NormalizationDataFile::NFKC_CF};
+  EXPECT_FALSE(ustring(u8"ABC").is_normalized(casefold));
+  EXPECT_EQ(ustring(u8"ABC").normalized(casefold), u8"abc");
+  EXPECT_TRUE(ustring(u8"abc").is_normalized(casefold));
+
+  // FCD has no UTF-8 implementation in ICU and goes through its UTF-16 fallback
+  EXPECT_TRUE(ustring(u8"a\u0301b").is_normalized({.mode = Normalization2Mode::FCD}));
+  EXPECT_FALSE(ustring(u8"a\u0301\u0327").is_normalized({.mode = Normalization2Mode::FCD}));
+}
+
 // Test complex string manipulations
 TEST_F(UstringTransformTest, ComplexManipulations)
 {
@@ -324,6 +408,39 @@ TEST_F(UstringTransformTest, UnicodeScripts)
   EXPECT_EQ(mixed_scripts.lowered(), u8"hello नमस्ते こんにちは");
 }
 
+TEST_F(UstringTransformTest, CaseConversionInPlace)
+{
+  // ASCII and same length mappings keep the buffer
+  ustring text(std::string(100, 'a') + "ÀÉÎ Straße ПРИВЕТ " + std::string(50, 'Z'));
+  const auto *buffer = text.data();
+  text.to_upper();
+  EXPECT_EQ(text, ustring(std::string(100, 'A') + "ÀÉÎ STRAßE ПРИВЕТ " + std::string(50, 'Z')));
+  EXPECT_EQ(text.data(), buffer);
+  text.to_lower();
+  EXPECT_EQ(text, ustring(std::string(100, 'a') + "àéî straße привет " + std::string(50, 'z')));
+  EXPECT_EQ(text.data(), buffer);
+
+  // mappings that change the UTF-8 length: ı (2) -> I (1), K (3, Kelvin) -> k (1),
+  // Ⱥ (2) -> ⱥ (3), ɐ (2) -> Ɐ (3)
+  EXPECT_EQ(ustring(u8"ıx ıy").uppered(), u8"IX IY");
+  EXPECT_EQ(ustring(u8"K elvin K").lowered(), u8"k elvin k");
+  EXPECT_EQ(ustring(u8"ȺȺ and Ⱥ").lowered(), u8"ⱥⱥ and ⱥ");
+  EXPECT_EQ(ustring(u8"ɐɐɐ").uppered(), u8"ⱯⱯⱯ");
+  ustring long_growth(std::string(40, 'b') + "ɐ" + std::string(40, 'c'));
+  EXPECT_EQ(long_growth.uppered(), ustring(std::string(40, 'B') + "Ɐ" + std::string(40, 'C')));
+
+  // full mappings, including one to many and final sigma
+  EXPECT_EQ(ustring(u8"straße").uppered(true), u8"STRASSE");
+  EXPECT_EQ(ustring(u8"ΟΔΟΣ ΟΔΟΣ").lowered(true), u8"οδο\u03C2 οδο\u03C2");
+  EXPECT_EQ(ustring(u8"İstanbul").lowered(true), u8"i̇stanbul");
+  EXPECT_EQ(ustring(u8"ABC ПРИВЕТ").lowered(true), u8"abc привет");
+  ustring many(std::string(300, 'x') + "ß" + std::string(300, 'y') + "ß");
+  EXPECT_EQ(many.uppered(true), ustring(std::string(300, 'X') + "SS" + std::string(300, 'Y') + "SS"));
+
+  // ill-formed bytes are kept
+  EXPECT_TRUE(ustring(u8"ab\xFF\xC3" "cd").uppered() == std::u8string_view(u8"AB\xFF\xC3" "CD"));
+}
+
 // Test edge cases and error handling
 TEST_F(UstringTransformTest, EdgeCases)
 {
@@ -667,6 +784,40 @@ TEST_F(UstringTransformTest, TextSimplification)
   EXPECT_EQ(empty.traditionalize(), empty);
 }
 
+// ICU services are cached per thread; every thread and every call must see the same results
+TEST_F(UstringTransformTest, CachedServices)
+{
+  auto check = [] {
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_EQ(ustring(u8"漢字 國際").simplify(), u8"汉字 国际");
+      EXPECT_EQ(ustring(u8"Ｈｅｌｌｏ").to_halfwidth(), u8"Hello");
+      EXPECT_EQ(ustring(u8"hello world").titled(), u8"Hello World");
+      EXPECT_EQ(ustring(u8"hello world").titled(nullptr, ToTitleOptions::WHOLE_STRING),
+                u8"Hello world");
+      EXPECT_EQ(ustring(u8"hELLO! wORLD.").capitalize("en_US"), u8"Hello! World.");
+      EXPECT_TRUE(ustring(u8"Hello World").is_title());
+    }
+  };
+  check();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back(check);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // word boundaries are byte offsets into the UTF-8 text
+  const ustring text(u8"héllo wörld");
+  const auto words = text.split_words("en_US");
+  ASSERT_EQ(words.size(), 3u);
+  EXPECT_EQ(words[0], u8"héllo");
+  EXPECT_EQ(words[1], u8" ");
+  EXPECT_EQ(words[2], u8"wörld");
+  const ustring chinese_text(u8"你好 world");
+  EXPECT_EQ(chinese_text.split_words("zh").back(), u8"world");
+}
+
 // Test combined transformations
 TEST_F(UstringTransformTest, CombinedTransformations)
 {